@@ -56,9 +56,16 @@ extern const char *_ll_log_level_name[LL_LEVEL_INHERIT];
 /// or off dynamically.
 #define LL_STATIC_MAX_LEVEL LL_LEVEL_DEBUG
 
+/// Threshold of a log which has no parent but is set to LL_LEVEL_INHERIT.
+#define LL_DEFAULT_LEVEL    LL_LEVEL_INFO
+
 /// Maximum size of message buffer, in bytes.  Must be greater than or equal to 8.
 #define LL_MAX_MESSAGE_SIZE 1024
 
+/// Size of the buffer in each log which caches its dotted path, in bytes, including the terminator.
+/// Paths which do not fit are rebuilt for every message.  Set to 0 to disable the cache.
+#define LL_PATH_CACHE_SIZE  32
+
 /**
  * Allocate message buffer.  In this case, allocate on the stack.  The character buffer "name" must
  * be created by this macro.
@@ -82,18 +89,90 @@ extern const char *_ll_log_level_name[LL_LEVEL_INHERIT];
 /// Enable time stamps in standard log messages.
 #define LL_TIMESTAMP     1
 
+/// Number of fractional second digits in time stamps: 3 for milliseconds, 6 for microseconds, or 9
+/// for nanoseconds.
+#define LL_TIMESTAMP_DIGITS 3
+
+/// Clock to read time stamps from.  One of LL_CLOCK_PRECISE, LL_CLOCK_COARSE, or LL_CLOCK_TSC.
+#define LL_CLOCK         LL_CLOCK_PRECISE
+
 /// Use local time rather than UTC for time stamps.
 #define LL_LOCALTIME     0
 
-/// Enable support for customised log messages (TBD).
+/// Lay out messages according to a pattern set with ll_set_layout, rather than the standard
+/// layout.
 #define LL_CUSTOM_FORMAT 0
 
+/// Size of the longest layout pattern accepted by ll_set_layout, in bytes, including the
+/// terminator.
+#define LL_LAYOUT_SIZE   64
+
+/// Layout pattern used until ll_set_layout is called.  This matches the standard layout.
+#if LL_TIMESTAMP && LL_LOCATION
+#   define LL_DEFAULT_LAYOUT    "%t %5L %f:%l %n: %m"
+#elif LL_TIMESTAMP
+#   define LL_DEFAULT_LAYOUT    "%t %5L %n: %m"
+#elif LL_LOCATION
+#   define LL_DEFAULT_LAYOUT    "%5L %f:%l %n: %m"
+#else
+#   define LL_DEFAULT_LAYOUT    "%5L %n: %m"
+#endif
+
+/// Write each message as a single line JSON object, with the time stamp, level, log path, location
+/// and message text as its members, instead of in the standard layout.
+#define LL_JSON_FORMAT   0
+
 /// Enable compact binary log messages.
 #define LL_COMPACT       0
 
+/// Layout of the fields of structured log messages.  One of LL_KV_LOGFMT, LL_KV_JSON, or
+/// LL_KV_BINARY.  Structured messages are not available with LL_COMPACT.
+#define LL_KV_FORMAT     LL_KV_LOGFMT
+
 /// Enable threading support.
 #define LL_THREADING     1
 
+/// Emit a descriptor for each log statement, which can be used to enable or disable it at run time.
+/// Requires GCC or Clang and an ELF target.
+#define LL_CALLSITES     0
+
+/// Size of a processor cache line, in bytes.  Used to keep data written by different threads apart.
+#define LL_CACHE_LINE_SIZE      64
+
+/// Enable asynchronous logging.  Messages are formatted by the caller and queued, and a background
+/// thread delivers them to the log targets.  Requires threading support.
+#define LL_ASYNC         0
+
+/// Size of the asynchronous message queue, in bytes.  Must be a power of two, and large enough to
+/// hold at least two maximum size messages.
+#define LL_ASYNC_QUEUE_SIZE     65536
+
+/// Action to take when a message is logged while the asynchronous queue is full.  One of
+/// LL_OVERFLOW_BLOCK, LL_OVERFLOW_DROP_NEWEST, or LL_OVERFLOW_DROP_OLDEST.
+#define LL_ASYNC_OVERFLOW       LL_OVERFLOW_BLOCK
+
+/// Most messages handed to a target in one call of its batch function, when the asynchronous queue
+/// or a flight recorder dump has several waiting.
+#define LL_BATCH_SIZE           64
+
+/// Size of the alternate signal stack used by the crash handler of ll_emergency_install, in bytes.
+#define LL_EMERGENCY_STACK_SIZE 65536
+
+/// Alignment of the buffers, lengths and file offsets of the direct I/O target, in bytes.
+#define LL_DIRECT_ALIGN         4096
+
+/// Size of the buffers holding the names of files rotated by the rotating file target, in bytes,
+/// including the terminator.
+#define LL_ROTATE_PATH_SIZE     256
+
+/// Number of messages the socket target gathers before sending a batch, and the most it sends with
+/// one system call.
+#define LL_SOCKET_BATCH         32
+
+/// Number of segments the buffer of the io_uring target is divided into.  Up to this many writes
+/// can be in flight, and there may be at most 8.
+#define LL_URING_SEGMENTS       4
+
 /**
  * @section mutex   Mutex Definitions
  *                  When threading support is enabled, the mutex type must be publically defined for
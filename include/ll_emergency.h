@@ -0,0 +1,99 @@
+/**
+ * @file        ll_emergency.h
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       Emergency output for a process which is about to die.
+ *              Messages still held in the asynchronous queue and in target buffers are written out
+ *              with raw system calls, without taking any lock or calling stdio, so that this may be
+ *              done from a signal handler after a crash.
+ */
+#ifndef LL_EMERGENCY_H
+#define LL_EMERGENCY_H
+
+#include "ll_log.h"
+
+#include <stdarg.h>
+
+/**
+ * Format text into a buffer like snprintf(), but without calling the C library, as is safe in a
+ * signal handler.  Only the %%, %c, %s, %d, %i, %u, %x, %X, and %p conversions are supported, with
+ * the '-' and '0' flags, a field width, a precision for strings, and the h, l, ll, and z length
+ * modifiers.  Other conversions are copied to the output as they are.
+ *
+ * @return  The number of characters that would have been written given enough space, excluding
+ *          the terminator.  The output is truncated to fit, and terminated if size is non-zero.
+ */
+int ll_safe_format
+(
+    char        *buffer,    ///< [out] Buffer to write into.
+    size_t       size,      ///< [in]  Size of the buffer, in bytes.
+    const char  *format,    ///< [in]  Format string.
+    ...                     ///< [in]  Positional parameters for format string.
+);
+
+/**
+ * Format text into a buffer using a variable argument list, as is safe in a signal handler.
+ *
+ * @return  The number of characters that would have been written given enough space, excluding
+ *          the terminator.
+ */
+int ll_safe_vformat
+(
+    char        *buffer,    ///< [out] Buffer to write into.
+    size_t       size,      ///< [in]  Size of the buffer, in bytes.
+    const char  *format,    ///< [in]  Format string.
+    va_list      args       ///< [in]  Positional parameters for format string.
+);
+
+/**
+ * Write out the messages waiting in the asynchronous queue, then the messages held buffered by a
+ * list of targets, as is safe in a signal handler.  Queued messages go to the targets of the logs
+ * they were written to, whether or not those are in the list.  Targets without an emergency
+ * function are skipped.
+ *
+ * Nothing is locked, so other threads must not be logging at the same time, or their messages may
+ * be mixed up with those written out.  This is meant for a process which is about to die; the
+ * targets should not be used normally afterwards.
+ */
+void ll_emergency_flush
+(
+    struct ll_target    *targets    ///< [in] List of targets.  May be NULL.
+);
+
+#if !LL_COMPACT
+/**
+ * Write a message to the targets of a log, as is safe in a signal handler.  The message is
+ * formatted with ll_safe_format in the standard layout, without the source location, and is passed
+ * to the emergency function of each target.  The log level threshold is not applied.  Time stamps
+ * are in UTC, unless the message falls in the same second as the last one formatted normally.
+ */
+void ll_emergency_log
+(
+    struct ll_log   *log,       ///< [in] Log handle.
+    enum ll_level    level,     ///< [in] Message level.
+    const char      *format,    ///< [in] Format string, as for ll_safe_format.
+    ...                         ///< [in] Positional parameters for format string.
+);
+#endif /* end !LL_COMPACT */
+
+/**
+ * Install a handler for SIGSEGV, SIGBUS, SIGFPE, SIGILL, and SIGABRT which writes out buffered
+ * messages before the process dies.  In text mode, a FATAL message naming the signal is passed to
+ * the targets first.  The handler then calls ll_emergency_flush on the list of targets, restores
+ * the previous handler, and raises the signal again.  In the thread which installs it, the handler
+ * runs on an alternate stack of LL_EMERGENCY_STACK_SIZE bytes where supported, so that a stack
+ * overflow there is caught too.
+ *
+ * Calling this again replaces the list of targets.  Requires sigaction().
+ *
+ * @retval  0   The handler was installed.
+ * @retval  -1  Signal handlers are not supported, or one could not be installed.
+ */
+int ll_emergency_install
+(
+    struct ll_target    *targets    ///< [in] List of targets to flush.  Must remain valid.
+);
+
+#endif /* end LL_EMERGENCY_H */
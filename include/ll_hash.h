@@ -0,0 +1,132 @@
+/**
+ * @file        ll_hash.h
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       Compile-time string literal hash used to identify compact log message formats.
+ *
+ * The hash is a polynomial over the length of the string and every one of its bytes, modulo 2^32:
+ * @code{.unparsed}
+ *  hash = len + sum(s[i] * K^(i + 1), i = 0..len - 1)
+ * @endcode
+ * where K is 16777619.  The bytes are hashed in chunks of 64, each scaled by the power of K for its
+ * offset, so that one table of multipliers serves them all.  Every term is independent, so the
+ * expansion grows linearly with the number of bytes hashed, and any optimizing compiler reduces it
+ * to a constant.  Longer strings than LL_HASH_MAX_LENGTH are rejected at compile time, rather than
+ * being hashed in part.  The log extractor tool implements the same function.
+ */
+#ifndef LL_HASH_H
+#define LL_HASH_H
+
+#include <stdint.h>
+
+/// Longest string literal that can be hashed, in bytes, excluding the terminator.
+#define LL_HASH_MAX_LENGTH 256
+
+/**
+ * Get a byte of a string literal, or zero if the index is past the end of the string.
+ *
+ * @param   s   String literal.
+ * @param   i   Index from the start of the string.
+ */
+#define _LL_HASH_BYTE(s, i) \
+    ((uint32_t) ((i) < sizeof(s) - 1 ? (unsigned char) (s)[(i) < sizeof(s) - 1 ? (i) : 0] : 0))
+
+/**
+ * Hash a chunk of 64 bytes of a string literal, as if the chunk started the string.
+ *
+ * @param   s   String literal.
+ * @param   o   Offset of the chunk in the string.
+ */
+#define _LL_HASH_CHUNK(s, o) ( \
+    _LL_HASH_BYTE(s, (o) +  0) * UINT32_C(0x01000193) + \
+    _LL_HASH_BYTE(s, (o) +  1) * UINT32_C(0x26027A69) + \
+    _LL_HASH_BYTE(s, (o) +  2) * UINT32_C(0x3EE6B34B) + \
+    _LL_HASH_BYTE(s, (o) +  3) * UINT32_C(0x502C3F11) + \
+    _LL_HASH_BYTE(s, (o) +  4) * UINT32_C(0x46A747C3) + \
+    _LL_HASH_BYTE(s, (o) +  5) * UINT32_C(0xFC55F7F9) + \
+    _LL_HASH_BYTE(s, (o) +  6) * UINT32_C(0x34555CFB) + \
+    _LL_HASH_BYTE(s, (o) +  7) * UINT32_C(0x5D615F21) + \
+    _LL_HASH_BYTE(s, (o) +  8) * UINT32_C(0x2148C0F3) + \
+    _LL_HASH_BYTE(s, (o) +  9) * UINT32_C(0x5887BE89) + \
+    _LL_HASH_BYTE(s, (o) + 10) * UINT32_C(0xE6B0F1AB) + \
+    _LL_HASH_BYTE(s, (o) + 11) * UINT32_C(0xD38C7031) + \
+    _LL_HASH_BYTE(s, (o) + 12) * UINT32_C(0x37149D23) + \
+    _LL_HASH_BYTE(s, (o) + 13) * UINT32_C(0xD8735E19) + \
+    _LL_HASH_BYTE(s, (o) + 14) * UINT32_C(0xD69D215B) + \
+    _LL_HASH_BYTE(s, (o) + 15) * UINT32_C(0x345B8241) + \
+    _LL_HASH_BYTE(s, (o) + 16) * UINT32_C(0xAD0E0C53) + \
+    _LL_HASH_BYTE(s, (o) + 17) * UINT32_C(0xC01D66A9) + \
+    _LL_HASH_BYTE(s, (o) + 18) * UINT32_C(0x17489C0B) + \
+    _LL_HASH_BYTE(s, (o) + 19) * UINT32_C(0xB24DA551) + \
+    _LL_HASH_BYTE(s, (o) + 20) * UINT32_C(0x013B3E83) + \
+    _LL_HASH_BYTE(s, (o) + 21) * UINT32_C(0x73436839) + \
+    _LL_HASH_BYTE(s, (o) + 22) * UINT32_C(0xAC1D11BB) + \
+    _LL_HASH_BYTE(s, (o) + 23) * UINT32_C(0xACC2E961) + \
+    _LL_HASH_BYTE(s, (o) + 24) * UINT32_C(0x57D563B3) + \
+    _LL_HASH_BYTE(s, (o) + 25) * UINT32_C(0xF7EBF2C9) + \
+    _LL_HASH_BYTE(s, (o) + 26) * UINT32_C(0x116F326B) + \
+    _LL_HASH_BYTE(s, (o) + 27) * UINT32_C(0xDD0C5E71) + \
+    _LL_HASH_BYTE(s, (o) + 28) * UINT32_C(0x6B78ABE3) + \
+    _LL_HASH_BYTE(s, (o) + 29) * UINT32_C(0x11F69659) + \
+    _LL_HASH_BYTE(s, (o) + 30) * UINT32_C(0xA02EAE1B) + \
+    _LL_HASH_BYTE(s, (o) + 31) * UINT32_C(0x447C1481) + \
+    _LL_HASH_BYTE(s, (o) + 32) * UINT32_C(0x50544713) + \
+    _LL_HASH_BYTE(s, (o) + 33) * UINT32_C(0x87ABE2E9) + \
+    _LL_HASH_BYTE(s, (o) + 34) * UINT32_C(0x7C9634CB) + \
+    _LL_HASH_BYTE(s, (o) + 35) * UINT32_C(0xEB751B91) + \
+    _LL_HASH_BYTE(s, (o) + 36) * UINT32_C(0x3A5A6543) + \
+    _LL_HASH_BYTE(s, (o) + 37) * UINT32_C(0x1F4D6879) + \
+    _LL_HASH_BYTE(s, (o) + 38) * UINT32_C(0xBFDB767B) + \
+    _LL_HASH_BYTE(s, (o) + 39) * UINT32_C(0x817B83A1) + \
+    _LL_HASH_BYTE(s, (o) + 40) * UINT32_C(0x76703673) + \
+    _LL_HASH_BYTE(s, (o) + 41) * UINT32_C(0xE5A5B709) + \
+    _LL_HASH_BYTE(s, (o) + 42) * UINT32_C(0x8CDF232B) + \
+    _LL_HASH_BYTE(s, (o) + 43) * UINT32_C(0xEE445CB1) + \
+    _LL_HASH_BYTE(s, (o) + 44) * UINT32_C(0xC69DEAA3) + \
+    _LL_HASH_BYTE(s, (o) + 45) * UINT32_C(0x4D985E99) + \
+    _LL_HASH_BYTE(s, (o) + 46) * UINT32_C(0xBFDCEADB) + \
+    _LL_HASH_BYTE(s, (o) + 47) * UINT32_C(0xE3C5B6C1) + \
+    _LL_HASH_BYTE(s, (o) + 48) * UINT32_C(0x513EB1D3) + \
+    _LL_HASH_BYTE(s, (o) + 49) * UINT32_C(0xB8B1EF29) + \
+    _LL_HASH_BYTE(s, (o) + 50) * UINT32_C(0xE91B7D8B) + \
+    _LL_HASH_BYTE(s, (o) + 51) * UINT32_C(0x8146A1D1) + \
+    _LL_HASH_BYTE(s, (o) + 52) * UINT32_C(0x5330BC03) + \
+    _LL_HASH_BYTE(s, (o) + 53) * UINT32_C(0xF8B7F8B9) + \
+    _LL_HASH_BYTE(s, (o) + 54) * UINT32_C(0x429C8B3B) + \
+    _LL_HASH_BYTE(s, (o) + 55) * UINT32_C(0x176F2DE1) + \
+    _LL_HASH_BYTE(s, (o) + 56) * UINT32_C(0xC5053933) + \
+    _LL_HASH_BYTE(s, (o) + 57) * UINT32_C(0x5A390B49) + \
+    _LL_HASH_BYTE(s, (o) + 58) * UINT32_C(0x50CCC3EB) + \
+    _LL_HASH_BYTE(s, (o) + 59) * UINT32_C(0x1D586AF1) + \
+    _LL_HASH_BYTE(s, (o) + 60) * UINT32_C(0x23305963) + \
+    _LL_HASH_BYTE(s, (o) + 61) * UINT32_C(0xC81CB6D9) + \
+    _LL_HASH_BYTE(s, (o) + 62) * UINT32_C(0xDE33D79B) + \
+    _LL_HASH_BYTE(s, (o) + 63) * UINT32_C(0x669C6901))
+
+/**
+ * Fail to compile if a string literal is too long to be hashed.
+ *
+ * @param   s   String literal.
+ *
+ * @return  Zero.
+ */
+#define _LL_HASH_CHECK_LENGTH(s) \
+    ((uint32_t) 0 * (uint32_t) sizeof(char [(sizeof(s) - 1 <= LL_HASH_MAX_LENGTH) ? 1 : -1]))
+
+/**
+ * Compute the hash of a string literal at compile time.
+ *
+ * @param   s   String literal, of at most LL_HASH_MAX_LENGTH bytes.
+ *
+ * @return  The hash, as an ll_hash_t.
+ */
+#define LL_HASH(s)                                                                  \
+    ((ll_hash_t) ((uint32_t) (sizeof(s) - 1) + _LL_HASH_CHECK_LENGTH(s)         +   \
+                  _LL_HASH_CHUNK(s,   0)                                        +   \
+                  _LL_HASH_CHUNK(s,  64) * UINT32_C(0x669C6901)                 +   \
+                  _LL_HASH_CHUNK(s, 128) * UINT32_C(0xF049D201)                 +   \
+                  _LL_HASH_CHUNK(s, 192) * UINT32_C(0x96083B01)))
+
+#endif /* end LL_HASH_H */
@@ -18,12 +18,57 @@
 #   include "ll_config.h"
 #endif
 
+#include "ll_hash.h"
+
 #include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <time.h>
 
 /// Mark a parameter as unused.
 #define LL_UNUSED(x) ((void) (x))
 
+/**
+ * @section overflow    Asynchronous Queue Overflow Policies
+ *                      Permitted values for LL_ASYNC_OVERFLOW.
+ */
+/// Wait for the background thread to make space in the queue.
+#define LL_OVERFLOW_BLOCK       0
+/// Discard the message being logged.
+#define LL_OVERFLOW_DROP_NEWEST 1
+/// Discard the oldest queued message to make space for the message being logged.
+#define LL_OVERFLOW_DROP_OLDEST 2
+
+/**
+ * @section clock   Clock Sources
+ *                  Permitted values for LL_CLOCK.
+ */
+/// Wall clock time at the best resolution the platform offers.
+#define LL_CLOCK_PRECISE        0
+/// Wall clock time updated once per scheduler tick, which is cheaper to read.  Where no such clock
+/// exists, the precise clock is used instead.
+#define LL_CLOCK_COARSE         1
+/// Processor time stamp counter, calibrated against the wall clock and converted to wall clock time
+/// only when the time stamp is formatted.  Where no such counter exists, the precise clock is used
+/// instead.
+#define LL_CLOCK_TSC            2
+
+/**
+ * @section kv  Key-Value Field Formats
+ *              Permitted values for LL_KV_FORMAT.
+ */
+/// Fields follow the message text as logfmt pairs, such as: user=42 path="/a b".
+#define LL_KV_LOGFMT            0
+/// Fields follow the message text as a JSON object, such as: {"user":42,"path":"/a b"}.
+#define LL_KV_JSON              1
+/// Fields follow the message text and a space in their binary encoding, base64 encoded, to pass
+/// through text targets to a downstream decoder.
+#define LL_KV_BINARY            2
+
+#if LL_ASYNC && !LL_THREADING
+#   error Asynchronous logging requires threading support!
+#endif
+
 /**
  * @def LL_DECLARE_INLINE
  *
@@ -56,6 +101,24 @@
 #endif /* end !defined(LL_DEFINE_INLINE) */
 
 
+/// Time stamp, in nanoseconds since the Epoch.
+typedef uint64_t ll_timestamp_t;
+/**
+ * @def LL_UNLIKELY(x)
+ *
+ * Hint to the compiler that a condition is usually false, so that the code it guards is moved out
+ * of the straight-line path.
+ *
+ * @param   x   Condition.
+ */
+#ifndef LL_UNLIKELY
+#   if __GNUC__ || __clang__
+#       define LL_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#   else
+#       define LL_UNLIKELY(x) (x)
+#   endif
+#endif /* end !defined(LL_UNLIKELY) */
+
 // Forward reference.
 struct ll_target;
 
@@ -66,9 +129,83 @@ typedef void (*ll_send_func)
 (
     struct ll_target    *target,        ///< Target instance.
     enum ll_level        level,         ///< Message level.
-    time_t               seconds,       ///< Time stamp in seconds.
-    unsigned long        microseconds,  ///< Time stamp fraction of a second in microseconds.
-    const char          *message        ///< Message text.
+    ll_timestamp_t       timestamp,     ///< Time stamp, or zero if time stamps are disabled.
+    const char          *message,       ///< Message text.  When compact logging is enabled this is
+                                        ///< a binary record which may contain zero bytes.
+    size_t               length         ///< Message length in bytes, excluding the terminator.
+);
+
+/**
+ * Reserve space in a log target for a message to be formatted into directly, avoiding a copy.  This
+ * is only used when the target is the only one of its log.  The log is not locked while the message
+ * is formatted, so the target must hold its own lock until the commit function is called.
+ *
+ * @return A buffer of at least the requested size, or NULL if none is available, in which case the
+ *         message is formatted elsewhere and passed to the send function instead.
+ */
+typedef char *(*ll_reserve_func)
+(
+    struct ll_target    *target,        ///< Target instance.
+    size_t               size           ///< Number of bytes required.
+);
+
+/**
+ * Deliver a message which was formatted into space obtained from the reserve function.
+ */
+typedef void (*ll_commit_func)
+(
+    struct ll_target    *target,        ///< Target instance.
+    enum ll_level        level,         ///< Message level.
+    ll_timestamp_t       timestamp,     ///< Time stamp, or zero if time stamps are disabled.
+    char                *message,       ///< Message text, as returned by the reserve function.
+    size_t               length         ///< Message length in bytes, excluding the terminator.
+                                        ///< Zero if the message could not be formatted, in which
+                                        ///< case the reserved space must be discarded.
+);
+
+/**
+ * Write out any messages a log target holds buffered.
+ */
+typedef void (*ll_flush_func)
+(
+    struct ll_target    *target         ///< Target instance.
+);
+
+/**
+ * Write out any messages a log target holds buffered, followed by a message if one is given, from
+ * a signal handler when the process is about to die.  This must not take any lock or call any
+ * function which is not async-signal-safe.  Messages which cannot be written out that way may be
+ * dropped.
+ */
+typedef void (*ll_emergency_func)
+(
+    struct ll_target    *target,        ///< Target instance.
+    const char          *message,       ///< Message text, or NULL to only write out buffered
+                                        ///< messages.
+    size_t               length         ///< Message length in bytes, excluding the terminator.
+);
+
+/**
+ * A message in a batch passed to a log target.
+ */
+struct ll_record
+{
+    enum ll_level        level;     ///< Message level.
+    ll_timestamp_t       timestamp; ///< Time stamp, or zero if time stamps are disabled.
+    const char          *message;   ///< Message text.  When compact logging is enabled this is a
+                                    ///< binary record which may contain zero bytes.
+    size_t               length;    ///< Message length in bytes, excluding the terminator.
+};
+
+/**
+ * Send a batch of log messages to a log target, oldest first, with the same effect as passing each
+ * of them to the send function in turn.
+ */
+typedef void (*ll_send_batch_func)
+(
+    struct ll_target        *target,    ///< Target instance.
+    const struct ll_record  *records,   ///< Messages to send.
+    size_t                   count      ///< Number of messages, at least one.
 );
 
 /**
@@ -76,8 +213,19 @@ typedef void (*ll_send_func)
  */
 struct ll_target
 {
-    struct ll_target    *next;  ///< Next target instance.
-    ll_send_func         send;  ///< Function to write out log message.
+    struct ll_target    *next;          ///< Next target instance.
+    ll_send_func         send;          ///< Function to write out log message.
+    ll_reserve_func      reserve;       ///< Function to reserve space for a message, or NULL.
+    ll_commit_func       commit;        ///< Function to write out a message in reserved space, or
+                                        ///< NULL if reserve is NULL.
+    ll_flush_func        flush;         ///< Function to write out buffered messages, or NULL if the
+                                        ///< target does not buffer.
+    ll_emergency_func    emergency;     ///< Function to write out messages from a signal handler,
+                                        ///< or NULL if the target cannot do so safely.
+    ll_send_batch_func   send_batch;    ///< Function to write out several messages at once, or NULL
+                                        ///< to pass them to the send function one at a time.
+    volatile uint32_t    level;         ///< Messages above this level are not passed to the target,
+                                        ///< or LL_LEVEL_INHERIT to pass every message the log does.
 };
 
 /**
@@ -93,13 +241,173 @@ struct ll_log
     const char          *prefix;    ///< Prefix to prepend to each log message.  Not currently
                                     ///< implemented.
     enum ll_level        level;     ///< Threshold below which to pass log messages.
+    volatile uint32_t    effective; ///< Threshold in effect, taking inheritance into account, or
+                                    ///< LL_LEVEL_INHERIT if it has not been resolved yet.
+    volatile uint32_t    wanted;    ///< Highest level any target of the log takes, in the low 8
+                                    ///< bits, and the target level epoch it was worked out in, in
+                                    ///< the rest.  Zero if it has not been worked out yet.
     struct ll_target    *targets;   ///< Target(s) to write log messages to.
 
+#if LL_PATH_CACHE_SIZE > 0
+    volatile uint32_t    path_epoch;                ///< Path epoch when the path was cached,
+                                                    ///< zero if no path is cached, or all ones
+                                                    ///< while it is being written.
+    size_t               path_length;               ///< Length of the cached path.
+    char                 path[LL_PATH_CACHE_SIZE];  ///< Cached dotted path of this log.
+#endif /* end LL_PATH_CACHE_SIZE > 0 */
+
 #if LL_THREADING
     ll_mutex             mutex;     ///< Mutex used to serialize log accesses.
 #endif
 };
 
+/**
+ * Resolve the effective level of a log which inherits its level, on first use.
+ *
+ * @return The effective level of the log.
+ */
+enum ll_level _ll_resolve_level
+(
+    struct ll_log   *log    ///< Log handle.
+);
+
+/// Target level epoch, which changes whenever the level of a target does.  Never zero.
+extern volatile uint32_t _ll_target_epoch;
+
+/**
+ * Work out the highest level any of the targets of a log takes, and cache it in the log.
+ *
+ * @return The new value of the wanted field of the log.
+ */
+uint32_t _ll_resolve_wanted
+(
+    struct ll_log   *log    ///< Log handle.
+);
+
+/**
+ * Check a message level against the effective level of a log, and against the levels of its
+ * targets, so that a message none of them would take is not formatted.
+ *
+ * @return Non-zero if the message should be logged.
+ */
+LL_DECLARE_INLINE int _ll_enabled
+(
+    struct ll_log   *log,   ///< Log handle.
+    enum ll_level    level  ///< Level of log message.
+)
+{
+    uint32_t effective = log->effective;
+    uint32_t wanted;
+
+    if (effective == LL_LEVEL_INHERIT)
+    {
+        effective = (uint32_t) _ll_resolve_level(log);
+    }
+    if ((uint32_t) level > effective)
+    {
+        return 0;
+    }
+
+    wanted = log->wanted;
+    if ((wanted >> 8) != _ll_target_epoch)
+    {
+        wanted = _ll_resolve_wanted(log);
+    }
+    return (uint32_t) level <= (wanted & 0xFFU);
+}
+
+/**
+ * Check a message level against the effective level of a log.
+ *
+ * @param   log     Log handle.
+ * @param   level   Level of log message.
+ */
+#define _LL_ENABLED(log, level) LL_UNLIKELY(_ll_enabled((log), (level)))
+
+/// Run time state of a log statement.
+enum ll_callsite_state
+{
+    LL_CALLSITE_DEFAULT,    ///< Messages are subject to the threshold of the log.
+    LL_CALLSITE_ENABLED,    ///< Messages are always logged.
+    LL_CALLSITE_DISABLED    ///< Messages are never logged.
+};
+
+/**
+ * Call site descriptor.  When LL_CALLSITES is enabled each log statement defines one of these in
+ * the "ll_callsites" linker section, so that all the statements of a program can be found.
+ */
+struct ll_callsite
+{
+    const char          *file;      ///< Source file of the log statement.
+    const char          *function;  ///< Function containing the log statement.
+    const char          *format;    ///< Message format string.
+    unsigned int         line;      ///< Source line number of the log statement.
+    enum ll_level        level;     ///< Level of the log statement, or LL_LEVEL_INHERIT if the
+                                    ///< level is not a constant.
+    volatile uint32_t    state;     ///< Run time state, from enum ll_callsite_state.
+    volatile uint32_t    hits;      ///< Number of messages logged by the statement.
+};
+
+#if LL_CALLSITES
+#   if !(__GNUC__ || __clang__)
+#       error Call site descriptors require GCC or Clang!
+#   endif
+
+/**
+ * Attributes which keep a call site descriptor from being discarded.  Linkers do not always count
+ * the references made through __start_ll_callsites and __stop_ll_callsites when collecting unused
+ * sections, as with --gc-sections and -z start-stop-gc, so the descriptors are marked to be
+ * retained where the compiler supports that.  With older compilers, link with -z nostart-stop-gc.
+ */
+#   if defined(__has_attribute)
+#       if __has_attribute(retain)
+#           define _LL_CALLSITE_KEEP used, retain
+#       endif
+#   endif
+#   ifndef _LL_CALLSITE_KEEP
+#       define _LL_CALLSITE_KEEP used
+#   endif
+
+/**
+ * Define the call site descriptor of a log statement.
+ *
+ * @param   site    Descriptor variable name.
+ * @param   level   Level of log message.
+ * @param   format  Message format string.  This must be a string literal.
+ */
+#   define _LL_CALLSITE(site, level, format)                                                \
+    static struct ll_callsite site                                                          \
+        __attribute__((section("ll_callsites"), _LL_CALLSITE_KEEP, aligned(sizeof(void *)))) = \
+    {                                                                                       \
+        __FILE__,                                                                           \
+        __func__,                                                                           \
+        (format),                                                                           \
+        __LINE__,                                                                           \
+        __builtin_choose_expr(__builtin_constant_p(level), (level), LL_LEVEL_INHERIT),      \
+        LL_CALLSITE_DEFAULT,                                                                \
+        0                                                                                   \
+    }
+
+/**
+ * Check whether a log statement should log its message, taking its call site state into account.
+ *
+ * @param   site    Pointer to call site descriptor.
+ * @param   log     Log handle.
+ * @param   level   Level of log message.
+ */
+#   define _LL_CALLSITE_ENABLED(site, log, level)                  \
+    (((site)->state == LL_CALLSITE_DEFAULT)                     ?   \
+        _LL_ENABLED((log), (level))                             :   \
+        LL_UNLIKELY((site)->state == LL_CALLSITE_ENABLED))
+
+/**
+ * Count a message logged by a log statement.
+ *
+ * @param   site    Pointer to call site descriptor.
+ */
+#   define _LL_CALLSITE_HIT(site) ((void) __atomic_fetch_add(&(site)->hits, 1, __ATOMIC_RELAXED))
+#endif /* end LL_CALLSITES */
+
 /**
  * Unconditionally log a message using a variable argument list.
  */
@@ -146,8 +454,10 @@ LL_DECLARE_INLINE void _ll_log
 /**
  * Unconditionally log a compact message using a variable argument list.
  *
- * The file and line information is omitted, as it is collected by the log extractor tool during
- * preprocessing.
+ * The message is not formatted.  Instead a binary record holding the format string hash, level,
+ * time stamp, and raw argument values is passed to the targets, to be turned back into text later
+ * by the log extractor tool.  The file and line information is omitted from the record, as it is
+ * collected by the extractor tool from the source code.
  */
 void _ll_clogv
 (
@@ -158,14 +468,18 @@ void _ll_clogv
     unsigned int     line,      ///< Source line number of log statement.
 #endif /* end LL_LOCATION */
     ll_hash_t        hash,      ///< Compile-time hash of format string.
+    const char      *format,    ///< Message format string.  Only used to determine the types of
+                                ///< the positional parameters.
     va_list          args       ///< Positional parameters of format string.
 );
 
 /**
  * Unconditionally log a compact message using positional parameters.
  *
- * The file and line information is omitted, as it is collected by the log extractor tool during
- * preprocessing.
+ * The message is not formatted.  Instead a binary record holding the format string hash, level,
+ * time stamp, and raw argument values is passed to the targets, to be turned back into text later
+ * by the log extractor tool.  The file and line information is omitted from the record, as it is
+ * collected by the extractor tool from the source code.
  */
 LL_DECLARE_INLINE void _ll_clog
 (
@@ -176,11 +490,13 @@ LL_DECLARE_INLINE void _ll_clog
     unsigned int     line,      ///< Source line number of log statement.
 #endif /* end LL_LOCATION */
     ll_hash_t        hash,      ///< Compile-time hash of format string.
+    const char      *format,    ///< Message format string.  Only used to determine the types of
+                                ///< the positional parameters.
     ...                         ///< Positional parameters of format string.
 )
 {
     va_list args;
-    va_start(args, hash);
+    va_start(args, format);
     _ll_clogv(  log,
                 level,
 #if LL_LOCATION
@@ -188,10 +504,75 @@ LL_DECLARE_INLINE void _ll_clog
                 line,
 #endif /* end LL_LOCATION */
                 hash,
+                format,
                 args);
     va_end(args);
 }
 
+#if !LL_COMPACT
+/// Types of key-value fields.
+enum ll_kv_type
+{
+    LL_KV_TYPE_INT,     ///< Signed integer, held in value.i.
+    LL_KV_TYPE_UINT,    ///< Unsigned integer, held in value.u.
+    LL_KV_TYPE_FLOAT,   ///< Floating point number, held in value.f.
+    LL_KV_TYPE_BOOL,    ///< Boolean, held in value.u as zero or one.
+    LL_KV_TYPE_STR      ///< String, held in value.s.  NULL is written as a null value.
+};
+
+/// Key-value field of a structured log message.  Built with the LL_KV_* macros.
+struct ll_kv
+{
+    const char          *key;   ///< Field name.
+    enum ll_kv_type      type;  ///< Type of the value.
+    union
+    {
+        int64_t          i;     ///< Signed integer value.
+        uint64_t         u;     ///< Unsigned integer or boolean value.
+        double           f;     ///< Floating point value.
+        const char      *s;     ///< String value.
+    }                    value; ///< Field value.
+};
+
+/**
+ * Unconditionally log a structured message made up of a plain message text and typed fields.
+ */
+void _ll_log_kv
+(
+    struct ll_log       *log,       ///< Log handle.
+    enum ll_level        level,     ///< Level of log message.
+#   if LL_LOCATION
+    const char          *source,    ///< Source file of log statement.
+    unsigned int         line,      ///< Source line number of log statement.
+#   endif /* end LL_LOCATION */
+    const char          *message,   ///< Message text, which is not a format string.
+    const struct ll_kv  *fields,    ///< Fields of the message.
+    size_t               count      ///< Number of fields.
+);
+
+/**
+ * @def __LL_LOG_KV(log, level, message, ...)
+ * Unconditionally log a structured message.  The fields are gathered into an array, whose size is
+ * taken without evaluating them a second time.
+ *
+ * @param  log      Log handle.
+ * @param  level    Level of log message.
+ * @param  message  Message text.
+ * @param  ...      Fields, built with the LL_KV_* macros.
+ */
+#   if LL_LOCATION
+#       define __LL_LOG_KV(log, level, message, ...)                                         \
+        _ll_log_kv((log), (level), __FILE__, __LINE__, (message),                           \
+                   (const struct ll_kv[]) { __VA_ARGS__ },                                  \
+                   sizeof((const struct ll_kv[]) { __VA_ARGS__ }) / sizeof(struct ll_kv))
+#   else /* !LL_LOCATION */
+#       define __LL_LOG_KV(log, level, message, ...)                                         \
+        _ll_log_kv((log), (level), (message),                                               \
+                   (const struct ll_kv[]) { __VA_ARGS__ },                                  \
+                   sizeof((const struct ll_kv[]) { __VA_ARGS__ }) / sizeof(struct ll_kv))
+#   endif /* end !LL_LOCATION */
+#endif /* end !LL_COMPACT */
+
 /**
  * @def _LL_LOG(log, level, format, ...)
  * Unconditionally log a message using a variable argument list.
@@ -227,12 +608,13 @@ LL_DECLARE_INLINE void _ll_clog
 
 #if LL_LOCATION
 #   if LL_COMPACT
-#      define __LL_LOG(log, level, format, ...)                                    \
-           ((#__VA_ARGS__[0] == '\0')                                          ?   \
-               _ll_clog((log), (level), __FILE__, __LINE__, LL_HASH(format))   :   \
-               _ll_clog((log), (level), __FILE__, __LINE__, LL_HASH(format), __VA_ARGS__))
+#      define __LL_LOG(log, level, format, ...)                                            \
+           ((#__VA_ARGS__[0] == '\0')                                                  ?   \
+               _ll_clog((log), (level), __FILE__, __LINE__, LL_HASH(format), (format))  :   \
+               _ll_clog((log), (level), __FILE__, __LINE__, LL_HASH(format), (format),      \
+                        __VA_ARGS__))
 #      define __LL_LOGV(log, level, format, args) \
-           _ll_clogv((log), (level), __FILE__, __LINE__, LL_HASH(format), (args))
+           _ll_clogv((log), (level), __FILE__, __LINE__, LL_HASH(format), (format), (args))
 #   else /* !LL_COMPACT */
 #      define __LL_LOG(log, level, format, ...)                            \
            ((#__VA_ARGS__[0] == '\0')                                  ?   \
@@ -243,12 +625,12 @@ LL_DECLARE_INLINE void _ll_clog
 #   endif /* end !LL_COMPACT */
 #else /* !LL_LOCATION */
 #   if LL_COMPACT
-#      define __LL_LOG(log, level, format, ...)                 \
-           ((#__VA_ARGS__[0] == '\0')                       ?   \
-               _ll_clog((log), (level), LL_HASH(format))    :   \
-               _ll_clog((log), (level), LL_HASH(format), __VA_ARGS__))
+#      define __LL_LOG(log, level, format, ...)                             \
+           ((#__VA_ARGS__[0] == '\0')                                   ?   \
+               _ll_clog((log), (level), LL_HASH(format), (format))      :   \
+               _ll_clog((log), (level), LL_HASH(format), (format), __VA_ARGS__))
 #      define __LL_LOGV(log, level, format, args) \
-           _ll_clogv((log), (level), LL_HASH(format), (args))
+           _ll_clogv((log), (level), LL_HASH(format), (format), (args))
 #   else /* !LL_COMPACT */
 #      define __LL_LOG(log, level, format, ...)         \
            ((#__VA_ARGS__[0] == '\0')               ?   \
@@ -28,6 +28,38 @@
 /// Write to parent log's target.
 #define LL_INHERIT_TARGET NULL
 
+/**
+ * Initialiser for a log target structure.
+ *
+ * @param   next    Next target instance, or NULL if this is the last target of a log.
+ * @param   send    Function to write out log messages.
+ */
+#define LL_TARGET_INIT(next, send) \
+    { (next), (send), NULL, NULL, NULL, NULL, NULL, LL_LEVEL_INHERIT }
+
+/**
+ * Initialiser for a log target structure which can also take several messages in one call, as
+ * delivered by the asynchronous queue and by flight recorder dumps.
+ *
+ * @param   next        Next target instance, or NULL if this is the last target of a log.
+ * @param   send        Function to write out log messages.
+ * @param   send_batch  Function to write out a batch of log messages.
+ */
+#define LL_TARGET_INIT_BATCH(next, send, send_batch) \
+    { (next), (send), NULL, NULL, NULL, NULL, (send_batch), LL_LEVEL_INHERIT }
+
+/**
+ * Initialiser for a log target structure whose messages can be formatted directly into its own
+ * buffer, rather than being formatted on the stack and copied.
+ *
+ * @param   next    Next target instance, or NULL if this is the last target of a log.
+ * @param   send    Function to write out log messages which were not written into reserved space.
+ * @param   reserve Function to reserve space for a message.
+ * @param   commit  Function to write out a message in reserved space.
+ */
+#define LL_TARGET_INIT_DIRECT(next, send, reserve, commit) \
+    { (next), (send), (reserve), (commit), NULL, NULL, NULL, LL_LEVEL_INHERIT }
+
 /**
  * Initialiser for a log structure.
  *
@@ -44,33 +76,319 @@
  * static struct ll_log MyLog = LL_LOG_INIT("mylog", NULL, LL_LEVEL_INFO, NULL, &PrintfTarget);
  * @endcode
  */
-#define LL_LOG_INIT(name, prefix, level, parent, targets) \
-    { (parent), NULL, NULL, (name), (prefix), (level), (targets) }
+#if LL_PATH_CACHE_SIZE > 0
+#   define LL_LOG_INIT(name, prefix, level, parent, targets) \
+    { (parent), NULL, NULL, (name), (prefix), (level), (level), 0, (targets), 0, 0, "" }
+#else /* !(LL_PATH_CACHE_SIZE > 0) */
+#   define LL_LOG_INIT(name, prefix, level, parent, targets) \
+    { (parent), NULL, NULL, (name), (prefix), (level), (level), 0, (targets) }
+#endif /* end !(LL_PATH_CACHE_SIZE > 0) */
+
+/**
+ * Initialiser for a log structure, with its dotted path given up front so that it need not be
+ * built when the first message is logged.
+ *
+ * @param   name    Log name string.
+ * @param   path    Dotted path of the log, that is the names of its ancestors and itself joined by
+ *                  '.'.  This must be a string literal which fits in LL_PATH_CACHE_SIZE bytes.
+ * @param   prefix  Prefix to prepend to each log message.  Not currently implemented.  Set to NULL
+ *                  for the default.
+ * @param   level   Default log threshold.
+ * @param   parent  Parent log instance.  Set to NULL if there is no parent.
+ * @param   targets Linked list of log targets to write messages to.  Set to LL_INHERIT_TARGET to
+ *                  use the parent's targets.
+ *
+ * Example:
+ * @code
+ * static struct ll_log PoolLog = LL_LOG_INIT_PATH("pool", "svc.db.pool", NULL, LL_LEVEL_INHERIT,
+ *                                                 &DbLog, LL_INHERIT_TARGET);
+ * @endcode
+ */
+#if LL_PATH_CACHE_SIZE > 0
+#   define LL_LOG_INIT_PATH(name, path, prefix, level, parent, targets) \
+    { (parent), NULL, NULL, (name), (prefix), (level), (level), 0, (targets), 1, \
+      sizeof(path) - 1, path }
+#else /* !(LL_PATH_CACHE_SIZE > 0) */
+#   define LL_LOG_INIT_PATH(name, path, prefix, level, parent, targets) \
+    LL_LOG_INIT(name, prefix, level, parent, targets)
+#endif /* end !(LL_PATH_CACHE_SIZE > 0) */
+
+/**
+ * Determine whether a message at the specified level would currently be written to a log.  This
+ * can be used to skip preparing expensive arguments for a message which would be discarded.
+ *
+ * @param   log     Pointer to log instance.  This is evaluated once.
+ * @param   level   Level of the message.
+ */
+#define LL_LOG_ENABLED(log, level) \
+    (((level) <= LL_STATIC_MAX_LEVEL) && _LL_ENABLED((log), (level)))
 
 /**
  * Write a message to a log at the specified level, using positional parameters.
  * If the log level is greater than the configured static maximum then no function call will be
- * emitted in the code.
+ * emitted in the code.  Otherwise the level is checked against the log's current threshold inline,
+ * and neither the log function is called nor the positional parameters evaluated unless the message
+ * is enabled.
+ *
+ * When LL_CALLSITES is enabled this expands to a statement rather than an expression, and the
+ * statement can also be enabled or disabled individually at run time.
  *
- * @param   log     Pointer to log instance.
+ * @param   log     Pointer to log instance.  This is evaluated twice if the message is enabled.
  * @param   level   Level at which to log the message.
  * @param   format  Message format string.
  * @param   ...     Positional parameters of format string.
  */
-#define LL_LOG(log, level, format, ...) \
-    (((level) <= LL_STATIC_MAX_LEVEL) ? __LL_LOG((log), (level), (format), __VA_ARGS__) : (void) 0)
+#if LL_CALLSITES
+#   define LL_LOG(log, level, format, ...)                                  \
+    do                                                                      \
+    {                                                                       \
+        if ((level) <= LL_STATIC_MAX_LEVEL)                                 \
+        {                                                                   \
+            _LL_CALLSITE(_ll_callsite, (level), (format));                  \
+            if (_LL_CALLSITE_ENABLED(&_ll_callsite, (log), (level)))        \
+            {                                                               \
+                _LL_CALLSITE_HIT(&_ll_callsite);                            \
+                __LL_LOG((log), (level), (format), __VA_ARGS__);            \
+            }                                                               \
+        }                                                                   \
+    } while (0)
+#else /* !LL_CALLSITES */
+#   define LL_LOG(log, level, format, ...)                                  \
+    (LL_LOG_ENABLED((log), (level))                                     ?   \
+        __LL_LOG((log), (level), (format), __VA_ARGS__) : (void) 0)
+#endif /* end !LL_CALLSITES */
 
 /**
  * Write a message to a log at the specified level, using a variable argument list.
  * If the log level is greater than the configured static maximum then no function call will be
- * emitted in the code.
+ * emitted in the code.  Otherwise the level is checked against the log's current threshold inline,
+ * and the log function is only called if the message is enabled.
  *
- * @param   log     Pointer to log instance.
+ * When LL_CALLSITES is enabled this expands to a statement rather than an expression, and the
+ * statement can also be enabled or disabled individually at run time.
+ *
+ * @param   log     Pointer to log instance.  This is evaluated twice if the message is enabled.
  * @param   level   Level at which to log the message.
  * @param   format  Message format string.
  * @param   args    Positional parameters of format string.
  */
-#define LL_LOGV(log, level, format, args) \
-    (((level) <= LL_STATIC_MAX_LEVEL) ? __LL_LOGV((log), (level), (format), (args)) : (void) 0)
+#if LL_CALLSITES
+#   define LL_LOGV(log, level, format, args)                                \
+    do                                                                      \
+    {                                                                       \
+        if ((level) <= LL_STATIC_MAX_LEVEL)                                 \
+        {                                                                   \
+            _LL_CALLSITE(_ll_callsite, (level), (format));                  \
+            if (_LL_CALLSITE_ENABLED(&_ll_callsite, (log), (level)))        \
+            {                                                               \
+                _LL_CALLSITE_HIT(&_ll_callsite);                            \
+                __LL_LOGV((log), (level), (format), (args));                \
+            }                                                               \
+        }                                                                   \
+    } while (0)
+#else /* !LL_CALLSITES */
+#   define LL_LOGV(log, level, format, args)                                \
+    (LL_LOG_ENABLED((log), (level))                                     ?   \
+        __LL_LOGV((log), (level), (format), (args)) : (void) 0)
+#endif /* end !LL_CALLSITES */
+
+#if !LL_COMPACT
+/**
+ * Build a signed integer field of a structured log message, for LL_LOG_KV.  The key must remain
+ * valid until the message is logged.
+ *
+ * @param   key     Field name.
+ * @param   value   Field value.
+ */
+#define LL_KV_INT(key, value)   { (key), LL_KV_TYPE_INT,   { .i = (int64_t) (value) } }
+
+/// Build an unsigned integer field of a structured log message, as LL_KV_INT.
+#define LL_KV_UINT(key, value)  { (key), LL_KV_TYPE_UINT,  { .u = (uint64_t) (value) } }
+
+/// Build a floating point field of a structured log message, as LL_KV_INT.
+#define LL_KV_FLOAT(key, value) { (key), LL_KV_TYPE_FLOAT, { .f = (double) (value) } }
+
+/// Build a boolean field of a structured log message, as LL_KV_INT.
+#define LL_KV_BOOL(key, value)  { (key), LL_KV_TYPE_BOOL,  { .u = (value) ? 1U : 0U } }
+
+/// Build a string field of a structured log message, as LL_KV_INT.  The string is copied when the
+/// message is logged.
+#define LL_KV_STR(key, value)   { (key), LL_KV_TYPE_STR,   { .s = (value) } }
+
+/**
+ * Write a structured message to a log at the specified level.  The message text is written as it
+ * is, rather than used as a format string, and is followed by the fields in the layout selected by
+ * LL_KV_FORMAT.  Integers, booleans and strings are copied or converted without printf.  Messages
+ * are checked against the thresholds of the log and its targets as with LL_LOG, and the fields are
+ * not evaluated unless the message is enabled.  Not available with LL_COMPACT, as compact records
+ * only hold the arguments of a format string.
+ *
+ * Example:
+ * @code
+ * LL_LOG_KV(&HttpLog, LL_LEVEL_INFO, "request served", LL_KV_UINT("status", 200),
+ *           LL_KV_STR("path", path), LL_KV_FLOAT("seconds", elapsed));
+ * @endcode
+ *
+ * @param   log     Pointer to log instance.  This is evaluated twice if the message is enabled.
+ * @param   level   Level at which to log the message.
+ * @param   message Message text.
+ * @param   ...     One or more fields, built with the LL_KV_* macros.
+ */
+#   if LL_CALLSITES
+#       define LL_LOG_KV(log, level, message, ...)                          \
+    do                                                                      \
+    {                                                                       \
+        if ((level) <= LL_STATIC_MAX_LEVEL)                                 \
+        {                                                                   \
+            _LL_CALLSITE(_ll_callsite, (level), (message));                 \
+            if (_LL_CALLSITE_ENABLED(&_ll_callsite, (log), (level)))        \
+            {                                                               \
+                _LL_CALLSITE_HIT(&_ll_callsite);                            \
+                __LL_LOG_KV((log), (level), (message), __VA_ARGS__);        \
+            }                                                               \
+        }                                                                   \
+    } while (0)
+#   else /* !LL_CALLSITES */
+#       define LL_LOG_KV(log, level, message, ...)                          \
+    (LL_LOG_ENABLED((log), (level))                                     ?   \
+        __LL_LOG_KV((log), (level), (message), __VA_ARGS__) : (void) 0)
+#   endif /* end !LL_CALLSITES */
+#endif /* end !LL_COMPACT */
+
+#if LL_CALLSITES
+/**
+ * Iterate over the call site descriptors of every log statement in the program.  Statements above
+ * LL_STATIC_MAX_LEVEL are skipped, as they were compiled out.
+ *
+ * Example:
+ * @code
+ * struct ll_callsite *site = NULL;
+ * while ((site = ll_callsite_next(site)) != NULL)
+ * {
+ *     printf("%s:%u %s() hits=%u\n", site->file, site->line, site->function, site->hits);
+ * }
+ * @endcode
+ *
+ * @return The next call site descriptor, or NULL if there are no more.
+ */
+struct ll_callsite *ll_callsite_next
+(
+    struct ll_callsite *site ///< [in] Previous call site descriptor, or NULL to get the first.
+);
+
+/**
+ * Set the run time state of every log statement matching the given criteria.
+ *
+ * @return The number of log statements changed.
+ */
+size_t ll_callsite_control
+(
+    const char              *file,      ///< [in] Source file name, matching either the whole path
+                                        ///<      or its trailing components.  NULL matches any.
+    const char              *function,  ///< [in] Function name, or NULL to match any.
+    unsigned int             line,      ///< [in] Line number, or zero to match any.
+    enum ll_callsite_state   state      ///< [in] New state.
+);
+#endif /* end LL_CALLSITES */
+
+/**
+ * Set the threshold level of a log.  The change is pushed down to every descendant which inherits
+ * its level, so that checking whether a message is enabled never has to consult the ancestors.
+ */
+void ll_set_level
+(
+    struct ll_log   *log,   ///< [in] Log handle.
+    enum ll_level    level  ///< [in] New threshold, or LL_LEVEL_INHERIT to use the parent's.
+);
+
+/**
+ * Change the parent of a log.  If the log inherits its level, the new parent's level is pushed down
+ * to it and its descendants.  The cached paths of the log and its descendants are rebuilt when they
+ * next log a message.
+ *
+ * @retval  0   The parent was changed.
+ * @retval  -1  The new parent is the log itself or one of its descendants, so the parent was not
+ *              changed.
+ */
+int ll_set_parent
+(
+    struct ll_log   *log,   ///< [in] Log handle.
+    struct ll_log   *parent ///< [in] New parent log handle.  May be NULL.
+);
+
+/**
+ * Wait until all messages logged before this call have been delivered to their targets.  This has
+ * no effect unless asynchronous logging is enabled.
+ */
+void ll_flush(void);
+
+#if LL_CUSTOM_FORMAT
+/**
+ * Set the layout of log messages.  The pattern is compiled once into a short program, which is then
+ * run for each message, and need not remain valid afterwards.  Text is copied as it is, except for
+ * the following specifiers.
+ *
+ * Specifier | Field
+ * --------- | ------------------------------------------------------------------------------------
+ * %t        | Time stamp, if LL_TIMESTAMP is enabled.  At most once per pattern.
+ * %L        | Level name.
+ * %f        | Source file name, if LL_LOCATION is enabled.
+ * %l        | Source line number, if LL_LOCATION is enabled.
+ * %n        | Log path.
+ * %m        | Message body.
+ * %%        | A single '%'.
+ *
+ * A field may be given a minimum width, such as %5L, and is then padded with spaces on the left, or
+ * on the right if the width is preceded by '-'.  Messages whose pattern has no %t carry no time
+ * stamp.  The layout should be set while configuring the program; a message being formatted while
+ * it changes may be laid out either way, but may be garbled if it changes twice in that time.
+ *
+ * Example:
+ * @code
+ * ll_set_layout("[%-5L] %t %n (%f:%l): %m");
+ * @endcode
+ *
+ * @retval  0   The layout was changed.
+ * @retval  -1  The pattern is too long, has an unknown specifier, or has more than one %t.  The
+ *              layout is unchanged.
+ */
+int ll_set_layout
+(
+    const char  *pattern    ///< [in] Layout pattern, of at most LL_LAYOUT_SIZE - 1 characters.
+);
+#endif /* end LL_CUSTOM_FORMAT */
+
+/**
+ * Set the threshold level of a target.  Messages above it are not passed to the target, and are
+ * not formatted at all when no other target of the log takes them.  Targets start out at
+ * LL_LEVEL_INHERIT, which passes on every message the log does.
+ */
+void ll_set_target_level
+(
+    struct ll_target    *target,    ///< [in] Target.
+    enum ll_level        level      ///< [in] New threshold, or LL_LEVEL_INHERIT for no threshold.
+);
+
+/**
+ * Write out the messages held buffered by a list of targets.  Targets which do not buffer are
+ * skipped.  With asynchronous logging, call ll_flush first so that queued messages have reached the
+ * targets.
+ */
+void ll_target_flush
+(
+    struct ll_target    *targets    ///< [in] First target of the list.  May be NULL.
+);
+
+/**
+ * Pass a batch of messages to each of a list of targets, oldest first.  Targets without a batch
+ * function are given the messages one at a time, as are targets with a level some of the messages
+ * are above, which skip those messages.
+ */
+void ll_target_send_batch
+(
+    struct ll_target        *targets,   ///< [in] First target of the list.  May be NULL.
+    const struct ll_record  *records,   ///< [in] Messages to send.
+    size_t                   count      ///< [in] Number of messages.
+);
 
 #endif /* end LL_LOG_H */
@@ -0,0 +1,185 @@
+/**
+ * @file        ll_ring.h
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       Bounded lock-free multi-producer, single-consumer ring buffer.
+ *              Producers reserve space for a variable-length record, fill it in, and commit it.
+ *              The consumer peeks at the oldest committed record and releases it when finished.
+ *              Records become visible to the consumer in reservation order.  The ring contains no
+ *              pointers, so it may be placed in memory shared between processes.
+ */
+#ifndef LL_RING_H
+#define LL_RING_H
+
+#include "ll_internal.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Ring buffer control block.  The data area immediately follows the control block in memory; use
+ * LL_RING_DEFINE to allocate both together.
+ */
+struct ll_ring
+{
+    volatile uint32_t    head;                                      ///< Position of the next
+                                                                    ///< reservation.  Shared by
+                                                                    ///< all producers.
+    unsigned char        head_pad[LL_CACHE_LINE_SIZE - sizeof(uint32_t)];
+    volatile uint32_t    tail;                                      ///< Position of the oldest
+                                                                    ///< unreleased record.  Only
+                                                                    ///< written by the consumer.
+    unsigned char        tail_pad[LL_CACHE_LINE_SIZE - sizeof(uint32_t)];
+    uint32_t             size;                                      ///< Size of the data area in
+                                                                    ///< bytes.  Power of two.
+    uint32_t             reserved;                                  ///< Keeps the data area
+                                                                    ///< 8-byte aligned.
+};
+
+/**
+ * Define a ring buffer along with its data area.
+ *
+ * @param   name    Variable name.  The ring control block is name.ring.
+ * @param   size    Data area size in bytes.  Must be a power of two.
+ *
+ * Example:
+ * @code
+ * static LL_RING_DEFINE(MyRing, 4096) = LL_RING_INIT(4096);
+ * @endcode
+ */
+#define LL_RING_DEFINE(name, size) \
+    struct { struct ll_ring ring; unsigned char data[(size)]; } name
+
+/**
+ * Static initializer for a ring buffer defined with LL_RING_DEFINE.
+ *
+ * @param   size    Data area size in bytes.  Must match the size given to LL_RING_DEFINE.
+ */
+#define LL_RING_INIT(size) { { 0, { 0 }, 0, { 0 }, (size), 0 }, { 0 } }
+
+/**
+ * Initialize a ring buffer at run time, for example when it is placed in shared memory.  The data
+ * area must immediately follow the control block.
+ *
+ * @retval  0   Success.
+ * @retval  <0  The size is not a power of two or is out of range.
+ */
+int ll_ring_init
+(
+    struct ll_ring  *ring,  ///< [out] Ring buffer.
+    size_t           size   ///< [in]  Size of the data area following the control block, in bytes.
+);
+
+/**
+ * Reserve space for a record.  Safe to call from any number of threads concurrently.  Every
+ * successful reservation must be followed by a call to ll_ring_commit().
+ *
+ * @return  Pointer to 8-byte aligned space for the record, or NULL if the ring does not currently
+ *          have enough free space.  Records larger than half the ring size are never accepted.
+ */
+void *ll_ring_reserve
+(
+    struct ll_ring  *ring,  ///< Ring buffer.
+    size_t           length ///< Number of bytes to reserve.
+);
+
+/**
+ * Publish a reserved record to the consumer.
+ */
+void ll_ring_commit
+(
+    struct ll_ring  *ring,      ///< Ring buffer.
+    void            *record,    ///< Record returned by ll_ring_reserve().
+    size_t           length     ///< Number of bytes actually used.  Must not exceed the reserved
+                                ///< length.  Zero abandons the reservation; the consumer will
+                                ///< never see it.
+);
+
+/**
+ * Get the oldest record without removing it from the ring.  Only the consumer may call this.
+ *
+ * @return  Pointer to the record, or NULL if the oldest record has not yet been committed or the
+ *          ring is empty.
+ */
+void *ll_ring_peek
+(
+    struct ll_ring  *ring,  ///< [in]  Ring buffer.
+    size_t          *length ///< [out] Length of the record, as given to ll_ring_commit().
+);
+
+/**
+ * Remove the record most recently returned by ll_ring_peek(), making its space available to
+ * producers.  Only the consumer may call this.
+ */
+void ll_ring_release
+(
+    struct ll_ring  *ring   ///< Ring buffer.
+);
+
+/**
+ * Get the next committed record without removing anything from the ring, so that the records can be
+ * inspected by a thread other than the consumer, for example from a signal handler when the process
+ * is about to die.  No lock is taken.  A record may be overwritten while it is inspected if the
+ * consumer releases it meanwhile.  The consumer itself may scan ahead to handle several records at
+ * once, and then remove them with ll_ring_release_to().
+ *
+ * @return  Pointer to the record, or NULL if the next record has not yet been committed or there
+ *          are no more records.
+ */
+void *ll_ring_scan
+(
+    struct ll_ring  *ring,      ///< [in]     Ring buffer.
+    uint32_t        *position,  ///< [in,out] Position to scan from, which is advanced past the
+                                ///<          record returned.  Start with the tail of the ring.
+    size_t          *length     ///< [out]    Length of the record, as given to ll_ring_commit().
+);
+
+/**
+ * Remove every record before a position reached with ll_ring_scan(), making their space available
+ * to producers.  Only the consumer may call this.
+ */
+void ll_ring_release_to
+(
+    struct ll_ring  *ring,      ///< Ring buffer.
+    uint32_t         position   ///< Position returned by ll_ring_scan() after the last record to
+                                ///< remove.
+);
+
+/**
+ * Get the oldest record if it has been reserved but not committed, so that the consumer can find
+ * out whether its producer is still able to commit it.  Padding records before it are removed.
+ * Only the consumer may call this.
+ *
+ * @return  Pointer to the record, or NULL if the ring is empty, the oldest record has been
+ *          committed, or its producer has not yet written the record's header.
+ */
+void *ll_ring_uncommitted
+(
+    struct ll_ring  *ring   ///< Ring buffer.
+);
+
+/**
+ * Abandon a record returned by ll_ring_uncommitted(), so that the consumer can move past a producer
+ * which stopped for good before committing it, for instance because its process died.  The record
+ * is then skipped as if committed with length zero.  Only the consumer may call this, and only once
+ * the producer can no longer touch the record, as its space is handed to other producers.
+ */
+void ll_ring_abandon
+(
+    struct ll_ring  *ring,      ///< Ring buffer.
+    void            *record     ///< Record returned by ll_ring_uncommitted().
+);
+
+/**
+ * Determine whether any records are reserved or waiting in the ring.
+ *
+ * @return  Non-zero if the ring is empty.
+ */
+int ll_ring_empty
+(
+    struct ll_ring  *ring   ///< Ring buffer.
+);
+
+#endif /* end LL_RING_H */
@@ -0,0 +1,146 @@
+/**
+ * @file        ll_target_direct.h
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       Direct I/O log file target.
+ *              A buffered file target which writes aligned blocks with O_DIRECT, bypassing the page
+ *              cache, so that high volume logging does not evict more useful cached data.
+ */
+#ifndef LL_TARGET_DIRECT_H
+#define LL_TARGET_DIRECT_H
+
+#include "ll_target_file.h"
+
+/**
+ * Size of the buffer needed for a direct I/O target with blocks of a given size.
+ *
+ * @param   block   Size of each block, in bytes.  Must be a multiple of LL_DIRECT_ALIGN.
+ */
+#define LL_DIRECT_BUFFER_SIZE(block) (2 * (block) + LL_DIRECT_ALIGN)
+
+/**
+ * Direct I/O log file target.  The buffer is divided into two aligned blocks.  Messages are
+ * gathered in one block, and when it fills it is handed to a helper thread to write out, while the
+ * next block is filled.  Without threading support, full blocks are written out by the logging
+ * thread.
+ *
+ * Messages at or below the flush level, messages which have waited for the flush delay, and
+ * ll_target_flush write out the partial block synchronously, padded with zero bytes to the
+ * alignment.  The padding is overwritten by the messages which follow, and is cut off the end of
+ * the file by ll_direct_target_close.  In text mode the zero bytes at the end of a file which was
+ * not closed are skipped when the target next starts appending to it; compact records are left
+ * alone, and the extractor skips such padding.
+ *
+ * The file descriptor is switched to O_DIRECT the first time a message is written.  Where that is
+ * not supported, as on some file systems, the aligned blocks are written through the page cache
+ * instead.  To append to an existing file, the descriptor must be open for reading as well, as the
+ * last partial block of the file is read back.  This target requires writev() and pwrite().
+ */
+struct ll_direct_target
+{
+    struct ll_file_target        file;          ///< Buffered file target, used as is if the buffer
+                                                ///< is too small for two blocks.  Must be the first
+                                                ///< member.  The used count applies to the current
+                                                ///< block.
+
+    int                          state;         ///< Set up state of the target.
+    char                        *blocks;        ///< Aligned start of the first block.
+    size_t                       block_size;    ///< Size of each block, in bytes.
+    unsigned int                 current;       ///< Index of the block being filled.
+    uint64_t                     offset;        ///< File offset of the block being filled.
+    size_t                       flushed;       ///< Number of bytes of the block being filled which
+                                                ///< have been written out.
+    uint64_t                     offsets[2];    ///< File offset of the write pending from each
+                                                ///< block.
+    size_t                       starts[2];     ///< Start of the write pending from each block.
+    size_t                       lengths[2];    ///< Length of the write pending from each block, or
+                                                ///< zero.  Protected by the helper thread mutex.
+    struct ll_direct_target     *link;          ///< Next target known to the helper thread.
+};
+
+/**
+ * Initialiser for a direct I/O log file target.
+ *
+ * @param   next        Next target instance, or NULL if this is the last target of a log.
+ * @param   fd          File descriptor to write to.
+ * @param   buffer      Buffer for the blocks, of LL_DIRECT_BUFFER_SIZE(block size) bytes.  This
+ *                      must remain valid as long as the target is in use.
+ * @param   size        Size of the buffer, in bytes.
+ * @param   delay       Longest time a message may wait in the buffer, in nanoseconds, or
+ *                      LL_FILE_NO_DELAY.
+ * @param   flush_level Messages at or below this level are written out immediately.
+ *
+ * Example:
+ * @code
+ * static char DirectBuffer[LL_DIRECT_BUFFER_SIZE(1 << 20)];
+ * static struct ll_direct_target DirectTarget = LL_DIRECT_TARGET_INIT(NULL, -1, DirectBuffer,
+ *                                                                     sizeof(DirectBuffer),
+ *                                                                     LL_FILE_NO_DELAY,
+ *                                                                     LL_LEVEL_ERROR);
+ *
+ * DirectTarget.file.fd = open("debug.log", O_RDWR | O_CREAT, 0644);
+ * @endcode
+ */
+#define LL_DIRECT_TARGET_INIT(next, fd, buffer, size, delay, flush_level)                   \
+    {                                                                                       \
+        {                                                                                   \
+            { (next), &_ll_direct_send, &_ll_direct_reserve, &_ll_direct_commit,            \
+              &_ll_direct_flush, &_ll_direct_emergency, NULL, LL_LEVEL_INHERIT },           \
+            (fd), (buffer), (size), 0, (delay), 0, (flush_level)                            \
+        },                                                                                  \
+        0                                                                                   \
+    }
+
+/**
+ * Stop writing to the file of a direct I/O target.  The last partial block is written out, and the
+ * padding after it is cut off the end of the file.
+ */
+void ll_direct_target_close
+(
+    struct ll_direct_target *target     ///< [in] Direct I/O target.
+);
+
+/// Send function of the direct I/O target.
+void _ll_direct_send
+(
+    struct ll_target    *target,
+    enum ll_level        level,
+    ll_timestamp_t       timestamp,
+    const char          *message,
+    size_t               length
+);
+
+/// Reserve function of the direct I/O target.
+char *_ll_direct_reserve
+(
+    struct ll_target    *target,
+    size_t               size
+);
+
+/// Commit function of the direct I/O target.
+void _ll_direct_commit
+(
+    struct ll_target    *target,
+    enum ll_level        level,
+    ll_timestamp_t       timestamp,
+    char                *message,
+    size_t               length
+);
+
+/// Flush function of the direct I/O target, which writes out the partial block and waits for it.
+void _ll_direct_flush
+(
+    struct ll_target    *target
+);
+
+/// Emergency function of the direct I/O target.
+void _ll_direct_emergency
+(
+    struct ll_target    *target,
+    const char          *message,
+    size_t               length
+);
+
+#endif /* end LL_TARGET_DIRECT_H */
@@ -0,0 +1,130 @@
+/**
+ * @file        ll_target_file.h
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       Buffered file log target.
+ *              Messages are gathered in a caller supplied buffer and written to a file descriptor
+ *              in batches, so that a single system call writes out many messages.
+ */
+#ifndef LL_TARGET_FILE_H
+#define LL_TARGET_FILE_H
+
+#include "ll_log.h"
+
+/// Never write out buffered messages on account of their age.
+#define LL_FILE_NO_DELAY UINT64_MAX
+
+/**
+ * Buffered file target.  Messages are written out when the buffer fills, when a message is at or
+ * below the flush level, when the oldest buffered message has waited for the flush delay as of the
+ * next message, and when the target is flushed with ll_target_flush.  In text mode each message is
+ * followed by a newline; compact records are written as they are.
+ *
+ * Buffered messages are only written out when another message arrives or the target is flushed,
+ * so a program should flush its targets before exiting.  This target requires writev().
+ */
+struct ll_file_target
+{
+    struct ll_target     target;        ///< Target interface.  Must be the first member.
+
+    int                  fd;            ///< File descriptor to write to.
+    char                *buffer;        ///< Buffer to gather messages in.
+    size_t               size;          ///< Size of the buffer, in bytes.  Messages are formatted
+                                        ///< directly into the buffer if this is at least
+                                        ///< LL_MAX_MESSAGE_SIZE.
+    size_t               used;          ///< Number of bytes in the buffer.
+    ll_timestamp_t       delay;         ///< Longest time a message may wait in the buffer, in
+                                        ///< nanoseconds, or LL_FILE_NO_DELAY.  Time stamps must be
+                                        ///< enabled for this to have an effect.
+    ll_timestamp_t       oldest;        ///< Time stamp of the oldest message in the buffer.
+    enum ll_level        flush_level;   ///< Messages at or below this level are written out
+                                        ///< immediately, along with everything buffered before
+                                        ///< them.
+
+#if LL_THREADING
+    ll_mutex             mutex;         ///< Mutex used to serialize buffer accesses.
+#endif
+};
+
+/**
+ * Initialiser for a buffered file target.
+ *
+ * @param   next        Next target instance, or NULL if this is the last target of a log.
+ * @param   fd          File descriptor to write to.
+ * @param   buffer      Buffer to gather messages in.  This must remain valid as long as the target
+ *                      is in use.
+ * @param   size        Size of the buffer, in bytes.
+ * @param   delay       Longest time a message may wait in the buffer, in nanoseconds, or
+ *                      LL_FILE_NO_DELAY.
+ * @param   flush_level Messages at or below this level are written out immediately.
+ *
+ * Example:
+ * @code
+ * static char FileBuffer[65536];
+ * static struct ll_file_target FileTarget = LL_FILE_TARGET_INIT(NULL, STDERR_FILENO, FileBuffer,
+ *                                                               sizeof(FileBuffer), 100000000,
+ *                                                               LL_LEVEL_ERROR);
+ * static struct ll_log MyLog = LL_LOG_INIT("mylog", NULL, LL_LEVEL_INFO, NULL,
+ *                                          &FileTarget.target);
+ * @endcode
+ */
+#define LL_FILE_TARGET_INIT(next, fd, buffer, size, delay, flush_level)                     \
+    {                                                                                       \
+        { (next), &_ll_file_send, &_ll_file_reserve, &_ll_file_commit, &_ll_file_flush,     \
+          &_ll_file_emergency, &_ll_file_send_batch, LL_LEVEL_INHERIT },                    \
+        (fd), (buffer), (size), 0, (delay), 0, (flush_level)                                \
+    }
+
+/// Send function of the buffered file target.
+void _ll_file_send
+(
+    struct ll_target    *target,
+    enum ll_level        level,
+    ll_timestamp_t       timestamp,
+    const char          *message,
+    size_t               length
+);
+
+/// Batch send function of the buffered file target, which writes out the buffer and whatever does
+/// not fit in it with a single system call.
+void _ll_file_send_batch
+(
+    struct ll_target        *target,
+    const struct ll_record  *records,
+    size_t                   count
+);
+
+/// Reserve function of the buffered file target.
+char *_ll_file_reserve
+(
+    struct ll_target    *target,
+    size_t               size
+);
+
+/// Commit function of the buffered file target.
+void _ll_file_commit
+(
+    struct ll_target    *target,
+    enum ll_level        level,
+    ll_timestamp_t       timestamp,
+    char                *message,
+    size_t               length
+);
+
+/// Flush function of the buffered file target.
+void _ll_file_flush
+(
+    struct ll_target    *target
+);
+
+/// Emergency function of the buffered file target.
+void _ll_file_emergency
+(
+    struct ll_target    *target,
+    const char          *message,
+    size_t               length
+);
+
+#endif /* end LL_TARGET_FILE_H */
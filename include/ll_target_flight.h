@@ -0,0 +1,124 @@
+/**
+ * @file        ll_target_flight.h
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       Flight recorder log target.
+ *              Messages of every level are kept in a fixed size circular buffer in memory, and only
+ *              passed on to other targets when an error occurs or a dump is requested, so that the
+ *              context leading up to a problem is available without writing it all out.
+ */
+#ifndef LL_TARGET_FLIGHT_H
+#define LL_TARGET_FLIGHT_H
+
+#include "ll_log.h"
+
+/// Never dump the buffer on account of a message level, only when ll_dump is called.
+#define LL_FLIGHT_NO_TRIGGER (-1)
+
+/**
+ * Define a buffer for a flight recorder target.
+ *
+ * @param   name    Variable name.
+ * @param   size    Buffer size in bytes.  Must be a power of two, at least 64.
+ *
+ * Example:
+ * @code
+ * static LL_FLIGHT_BUFFER(FlightBuffer, 65536);
+ * @endcode
+ */
+#define LL_FLIGHT_BUFFER(name, size) uint64_t name[(size) / sizeof(uint64_t)]
+
+/**
+ * Flight recorder target.  Each message is copied into the buffer as it arrives, overwriting the
+ * oldest messages once the buffer is full.  Logging threads do not take any lock to add a message;
+ * they claim space with an atomic increment and publish the message when it is complete.
+ *
+ * When a message at or below the trigger level arrives, and when ll_dump is called, the messages in
+ * the buffer which have not been dumped before are passed, oldest first, to the downstream targets.
+ * Messages which were being overwritten or were not yet complete at the time are left out.
+ * Messages longer than half the buffer are not kept.
+ */
+struct ll_flight_target
+{
+    struct ll_target     target;        ///< Target interface.  Must be the first member.
+
+    struct ll_target    *downstream;    ///< Linked list of targets to dump the buffer to.
+    void                *buffer;        ///< Buffer, aligned to 8 bytes, as defined with
+                                        ///< LL_FLIGHT_BUFFER.
+    uint32_t             size;          ///< Size of the buffer, in bytes.  Power of two.
+    int                  trigger_level; ///< Messages at or below this level cause the buffer to be
+                                        ///< dumped, or LL_FLIGHT_NO_TRIGGER.
+
+    volatile uint32_t    head;          ///< Position of the next message.  Positions are free
+                                        ///< running, and wrap around the buffer.
+    uint32_t             dumped;        ///< Position up to which messages have been dumped.
+
+#if LL_THREADING
+    ll_mutex             mutex;         ///< Mutex used to serialize dumps.
+#endif
+};
+
+/**
+ * Initialiser for a flight recorder target.
+ *
+ * @param   next            Next target instance, or NULL if this is the last target of a log.
+ * @param   downstream      Linked list of targets to dump the buffer to.
+ * @param   buffer          Buffer defined with LL_FLIGHT_BUFFER.
+ * @param   size            Size of the buffer, in bytes.  Must be a power of two.
+ * @param   trigger_level   Messages at or below this level cause the buffer to be dumped.  Set to
+ *                          LL_FLIGHT_NO_TRIGGER to only dump the buffer when ll_dump is called.
+ *
+ * Example:
+ * @code
+ * static LL_FLIGHT_BUFFER(FlightBuffer, 65536);
+ * static struct ll_flight_target FlightTarget = LL_FLIGHT_TARGET_INIT(NULL, &FileTarget.target,
+ *                                                                     FlightBuffer,
+ *                                                                     sizeof(FlightBuffer),
+ *                                                                     LL_LEVEL_ERROR);
+ * static struct ll_log MyLog = LL_LOG_INIT("mylog", NULL, LL_LEVEL_TRACE, NULL,
+ *                                          &FlightTarget.target);
+ * @endcode
+ */
+#define LL_FLIGHT_TARGET_INIT(next, downstream, buffer, size, trigger_level)               \
+    {                                                                                       \
+        { (next), &_ll_flight_send, NULL, NULL, &_ll_flight_flush, &_ll_flight_emergency,   \
+          NULL, LL_LEVEL_INHERIT },                                                         \
+        (downstream), (buffer), (size), (trigger_level), 0, 0                               \
+    }
+
+/**
+ * Pass the messages in the buffer of a flight recorder target which have not been dumped before to
+ * its downstream targets, and flush them.
+ */
+void ll_dump
+(
+    struct ll_flight_target *target     ///< [in] Flight recorder target.
+);
+
+/// Send function of the flight recorder target.
+void _ll_flight_send
+(
+    struct ll_target    *target,
+    enum ll_level        level,
+    ll_timestamp_t       timestamp,
+    const char          *message,
+    size_t               length
+);
+
+/// Flush function of the flight recorder target, which flushes the downstream targets.
+void _ll_flight_flush
+(
+    struct ll_target    *target
+);
+
+/// Emergency function of the flight recorder target.
+void _ll_flight_emergency
+(
+    struct ll_target    *target,
+    const char          *message,
+    size_t               length
+);
+
+#endif /* end LL_TARGET_FLIGHT_H */
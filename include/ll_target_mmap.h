@@ -0,0 +1,136 @@
+/**
+ * @file        ll_target_mmap.h
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       Memory mapped log file target.
+ *              Messages are appended to a file by copying them into a shared mapping of it, so that
+ *              writing a message takes no system calls, and messages already written survive a
+ *              crash of the process.
+ */
+#ifndef LL_TARGET_MMAP_H
+#define LL_TARGET_MMAP_H
+
+#include "ll_log.h"
+
+/// Never synchronize the file with storage explicitly, leaving it to the operating system.
+#define LL_MMAP_NO_SYNC (-1)
+
+/// Append to the file from its current end, rather than from a given offset.
+#define LL_MMAP_APPEND UINT64_MAX
+
+/**
+ * Memory mapped log file target.  A window of the file, one chunk long, is mapped at a time.  The
+ * space for each window is allocated in the file before it is mapped, and when a window fills it
+ * is unmapped and the next one mapped after it, so the file grows a chunk at a time.
+ *
+ * Until the target is closed with ll_mmap_target_close, the file extends to the end of the current
+ * window, with zero bytes after the last message.  In text mode the zero bytes are trimmed off when
+ * the target next starts appending to the file.  Compact records are left alone, as they may end in
+ * zero bytes; the extractor skips such padding.
+ *
+ * Messages at or below the synchronization level are synchronized with storage before the target
+ * returns, along with everything written before them.  This target requires mmap().
+ */
+struct ll_mmap_target
+{
+    struct ll_target     target;        ///< Target interface.  Must be the first member.
+
+    int                  fd;            ///< File descriptor to write to, opened for reading and
+                                        ///< writing.
+    size_t               chunk;         ///< Size of each mapped window, in bytes.  Rounded up to a
+                                        ///< multiple of the page size.
+    int                  sync_level;    ///< Messages at or below this level are synchronized with
+                                        ///< storage, or LL_MMAP_NO_SYNC.
+
+    uint64_t             end;           ///< File offset of the end of the last message, or
+                                        ///< LL_MMAP_APPEND before the target is first used.
+    uint64_t             base;          ///< File offset of the current window.
+    char                *map;           ///< Current window, or NULL if none is mapped.
+    size_t               size;          ///< Size of the current window, in bytes.
+    size_t               used;          ///< Number of bytes written to the current window.
+    size_t               synced;        ///< Number of bytes of the current window which have been
+                                        ///< synchronized with storage.
+
+#if LL_THREADING
+    ll_mutex             mutex;         ///< Mutex used to serialize accesses.
+#endif
+};
+
+/**
+ * Initialiser for a memory mapped log file target.
+ *
+ * @param   next        Next target instance, or NULL if this is the last target of a log.
+ * @param   fd          File descriptor to write to, opened for reading and writing.
+ * @param   chunk       Size of each mapped window, in bytes.
+ * @param   sync_level  Messages at or below this level are synchronized with storage.  Set to
+ *                      LL_MMAP_NO_SYNC to leave that to the operating system.
+ *
+ * Example:
+ * @code
+ * static struct ll_mmap_target MapTarget = LL_MMAP_TARGET_INIT(NULL, -1, 4 << 20, LL_LEVEL_FATAL);
+ * static struct ll_log MyLog = LL_LOG_INIT("mylog", NULL, LL_LEVEL_INFO, NULL, &MapTarget.target);
+ *
+ * MapTarget.fd = open("my.log", O_RDWR | O_CREAT, 0644);
+ * @endcode
+ */
+#define LL_MMAP_TARGET_INIT(next, fd, chunk, sync_level)                                    \
+    {                                                                                       \
+        { (next), &_ll_mmap_send, &_ll_mmap_reserve, &_ll_mmap_commit, &_ll_mmap_flush,     \
+          &_ll_mmap_emergency, NULL, LL_LEVEL_INHERIT },                                    \
+        (fd), (chunk), (sync_level), LL_MMAP_APPEND, 0, NULL, 0, 0, 0                       \
+    }
+
+/**
+ * Stop writing to the file of a memory mapped target.  The current window is unmapped and the file
+ * is truncated to the end of the last message.  The file descriptor is not closed.  If another
+ * message is written afterwards, the target carries on from where it left off.
+ */
+void ll_mmap_target_close
+(
+    struct ll_mmap_target   *target ///< [in] Memory mapped target.
+);
+
+/// Send function of the memory mapped target.
+void _ll_mmap_send
+(
+    struct ll_target    *target,
+    enum ll_level        level,
+    ll_timestamp_t       timestamp,
+    const char          *message,
+    size_t               length
+);
+
+/// Reserve function of the memory mapped target.
+char *_ll_mmap_reserve
+(
+    struct ll_target    *target,
+    size_t               size
+);
+
+/// Commit function of the memory mapped target.
+void _ll_mmap_commit
+(
+    struct ll_target    *target,
+    enum ll_level        level,
+    ll_timestamp_t       timestamp,
+    char                *message,
+    size_t               length
+);
+
+/// Flush function of the memory mapped target, which synchronizes the file with storage.
+void _ll_mmap_flush
+(
+    struct ll_target    *target
+);
+
+/// Emergency function of the memory mapped target.
+void _ll_mmap_emergency
+(
+    struct ll_target    *target,
+    const char          *message,
+    size_t               length
+);
+
+#endif /* end LL_TARGET_MMAP_H */
@@ -0,0 +1,125 @@
+/**
+ * @file        ll_target_rotate.h
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       Rotating log file target.
+ *              A buffered file target which starts a new file when the current one grows too large
+ *              or gets too old, leaving old files to be compressed and removed by a helper thread.
+ */
+#ifndef LL_TARGET_ROTATE_H
+#define LL_TARGET_ROTATE_H
+
+#include "ll_target_file.h"
+
+/**
+ * Process a file which has been rotated out, typically by compressing it.  This is called on the
+ * helper thread, if threading is supported, and otherwise by the logging thread as it rotates.
+ */
+typedef void (*ll_rotate_func)
+(
+    const char  *path   ///< Name of the rotated file.
+);
+
+/**
+ * Rotating log file target.  Messages are written to the named file, through the buffer of a file
+ * target.  When a message is about to be added after the file has reached the size limit, or after
+ * the interval in which the file was started has passed, the file is renamed to its name followed
+ * by "." and a sequence number, and a new file is started.  The logging thread only flushes,
+ * renames and reopens the file.  Processing the rotated file, and removing the oldest rotated files
+ * so that at most the configured number are kept, is left to a helper thread.
+ *
+ * Sequence numbers continue from the highest found next to the file when it is first opened.  The
+ * interval is judged from message time stamps, so time stamps must be enabled for it to have an
+ * effect.  This target requires writev() and opendir().
+ */
+struct ll_rotate_target
+{
+    struct ll_file_target    file;          ///< Buffered file target.  Must be the first member.
+
+    const char              *path;          ///< Name of the file to write to.
+    uint64_t                 max_size;      ///< Size at which to start a new file, in bytes, or
+                                            ///< zero for no limit.
+    ll_timestamp_t           interval;      ///< Interval at which to start a new file, in
+                                            ///< nanoseconds, or zero for none.  Intervals are
+                                            ///< aligned to the Epoch, so a day starts at midnight
+                                            ///< UTC.
+    unsigned int             max_files;     ///< Number of rotated files to keep, or zero to keep
+                                            ///< them all.
+    ll_rotate_func           process;       ///< Function to process rotated files, or NULL.
+    const char              *suffix;        ///< Suffix which the process function adds to the name
+                                            ///< of a file, such as ".gz", or NULL.
+
+    uint64_t                 written;       ///< Number of bytes in the current file.
+    ll_timestamp_t           deadline;      ///< Time stamp at which the current interval ends.
+    unsigned long            sequence;      ///< Sequence number of the last rotated file.
+    unsigned long            processed;     ///< Sequence number of the last rotated file which has
+                                            ///< been processed.  Owned by the helper thread.
+    struct ll_rotate_target *link;          ///< Next target known to the helper thread.
+    int                      opened;        ///< Non-zero once the file has been opened.
+};
+
+/**
+ * Initialiser for a rotating log file target.
+ *
+ * @param   next        Next target instance, or NULL if this is the last target of a log.
+ * @param   path        Name of the file to write to.
+ * @param   buffer      Buffer to gather messages in.  This must remain valid as long as the target
+ *                      is in use.
+ * @param   size        Size of the buffer, in bytes.
+ * @param   delay       Longest time a message may wait in the buffer, in nanoseconds, or
+ *                      LL_FILE_NO_DELAY.
+ * @param   flush_level Messages at or below this level are written out immediately.
+ * @param   max_size    Size at which to start a new file, in bytes, or zero for no limit.
+ * @param   interval    Interval at which to start a new file, in nanoseconds, or zero for none.
+ * @param   max_files   Number of rotated files to keep, or zero to keep them all.
+ * @param   process     Function to process rotated files, such as ll_rotate_gzip, or NULL.
+ * @param   suffix      Suffix which the process function adds to file names, or NULL.
+ *
+ * Example:
+ * @code
+ * static char FileBuffer[65536];
+ * static struct ll_rotate_target RotateTarget = LL_ROTATE_TARGET_INIT(NULL, "my.log", FileBuffer,
+ *     sizeof(FileBuffer), 100000000, LL_LEVEL_ERROR, 64 << 20, 86400000000000, 7, &ll_rotate_gzip,
+ *     ".gz");
+ * @endcode
+ */
+#define LL_ROTATE_TARGET_INIT(next, path, buffer, size, delay, flush_level, max_size,    \
+                              interval, max_files, process, suffix)                     \
+    {                                                                                   \
+        {                                                                               \
+            { (next), &_ll_rotate_send, NULL, NULL, &_ll_rotate_flush,                  \
+              &_ll_file_emergency, NULL, LL_LEVEL_INHERIT },                            \
+            -1, (buffer), (size), 0, (delay), 0, (flush_level)                          \
+        },                                                                              \
+        (path), (max_size), (interval), (max_files), (process), (suffix),               \
+        0, 0, 0, 0, NULL, 0                                                             \
+    }
+
+/**
+ * Compress a file with gzip, which replaces it with a file of the same name followed by ".gz".
+ * Only available where posix_spawn() is.
+ */
+void ll_rotate_gzip
+(
+    const char  *path   ///< [in] Name of the file.
+);
+
+/// Send function of the rotating target.
+void _ll_rotate_send
+(
+    struct ll_target    *target,
+    enum ll_level        level,
+    ll_timestamp_t       timestamp,
+    const char          *message,
+    size_t               length
+);
+
+/// Flush function of the rotating target.
+void _ll_rotate_flush
+(
+    struct ll_target    *target
+);
+
+#endif /* end LL_TARGET_ROTATE_H */
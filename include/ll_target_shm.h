@@ -0,0 +1,181 @@
+/**
+ * @file        ll_target_shm.h
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       Shared memory log target and collector.
+ *              Messages from any number of processes are passed through a ring buffer in a POSIX
+ *              shared memory object to a single collector process, which writes them out.  Logging
+ *              a message takes no system calls and no lock.
+ */
+#ifndef LL_TARGET_SHM_H
+#define LL_TARGET_SHM_H
+
+#include "ll_log.h"
+#include "ll_ring.h"
+
+/// Value of the magic number of a shared memory object once its ring is ready.  Text and compact
+/// messages are told apart, so that processes built with different configurations do not mix.
+#define LL_SHM_MAGIC (UINT32_C(0x4C4C5300) | LL_COMPACT)
+
+/**
+ * Layout of the shared memory object.  The data area of the ring follows.
+ */
+struct ll_shm
+{
+    volatile uint32_t    magic;     ///< LL_SHM_MAGIC once the ring has been initialized, and zero
+                                    ///< again once the collector has closed the object.
+    volatile uint32_t    dropped;   ///< Number of messages dropped because the ring was full.
+    unsigned char        pad[LL_CACHE_LINE_SIZE - 2 * sizeof(uint32_t)];
+    struct ll_ring       ring;      ///< Ring buffer.  Must be the last member.
+};
+
+/**
+ * Shared memory log target.  Each message is copied into the ring along with its level and time
+ * stamp, for the collector to pass on to its own targets.  Messages from all processes are
+ * collected in the order they were added to the ring; the time stamps give the order in which they
+ * were logged.  If the ring is full, the message is dropped and counted, and the collector reports
+ * the loss.
+ *
+ * The shared memory object is created by the collector, with ll_shm_collector_open, and is attached
+ * the first time a message is logged.  A pre-forking server can call ll_shm_target_attach before
+ * forking, so that every worker inherits the mapping.  If the object does not exist yet, attaching
+ * is retried with a growing delay, and messages are dropped meanwhile.  A target attached to the
+ * object of a collector which has since been restarted attaches to the new object.
+ *
+ * Each message records the process which added it, so that if the process dies between reserving
+ * space in the ring and filling it in, the collector can skip the message.  The process must be
+ * reaped by its parent first.  A process which dies within the few instructions between claiming
+ * the space and writing the record's header still stalls the collector.  This target requires
+ * shm_open() and mmap().
+ */
+struct ll_shm_target
+{
+    struct ll_target     target;    ///< Target interface.  Must be the first member.
+
+    const char          *name;      ///< Name of the shared memory object, starting with '/'.
+
+    volatile uint32_t    state;     ///< Attach state of the target.
+    struct ll_shm       *shm;       ///< Shared memory object, once attached.
+    uint64_t             retry;     ///< Monotonic time before which attaching is not retried, in
+                                    ///< nanoseconds.
+    uint64_t             backoff;   ///< Time to wait after the next failure to attach, in
+                                    ///< nanoseconds.
+
+#if LL_THREADING
+    ll_mutex             mutex;     ///< Mutex used to serialize attaching.
+#endif
+};
+
+/**
+ * Initialiser for a shared memory log target.
+ *
+ * @param   next    Next target instance, or NULL if this is the last target of a log.
+ * @param   name    Name of the shared memory object created by the collector.
+ *
+ * Example:
+ * @code
+ * static struct ll_shm_target ShmTarget = LL_SHM_TARGET_INIT(NULL, "/myapp-log");
+ * static struct ll_log MyLog = LL_LOG_INIT("mylog", NULL, LL_LEVEL_INFO, NULL, &ShmTarget.target);
+ * @endcode
+ */
+#define LL_SHM_TARGET_INIT(next, name)                                                      \
+    {                                                                                       \
+        { (next), &_ll_shm_send, NULL, NULL, NULL, &_ll_shm_emergency, NULL,                \
+          LL_LEVEL_INHERIT },                                                               \
+        (name), 0, NULL                                                                     \
+    }
+
+/**
+ * Attach a shared memory target to the object created by the collector, if that has not already
+ * been done.  This is otherwise done when the first message is logged.  After a failure, attaching
+ * is not tried again until a delay has passed, which doubles after each failure up to five seconds.
+ *
+ * @retval  0   The target is attached.
+ * @retval  -1  The object does not exist or was not set up by a collector.  Messages sent to the
+ *              target are dropped until attaching succeeds.
+ */
+int ll_shm_target_attach
+(
+    struct ll_shm_target    *target     ///< [in] Shared memory target.
+);
+
+/// Send function of the shared memory target.
+void _ll_shm_send
+(
+    struct ll_target    *target,
+    enum ll_level        level,
+    ll_timestamp_t       timestamp,
+    const char          *message,
+    size_t               length
+);
+
+/// Emergency function of the shared memory target, which adds the message to the ring.
+void _ll_shm_emergency
+(
+    struct ll_target    *target,
+    const char          *message,
+    size_t               length
+);
+
+/**
+ * Collector for the messages of shared memory targets.  Only one collector may drain a given
+ * shared memory object.
+ */
+struct ll_shm_collector
+{
+    const char          *name;      ///< Name of the shared memory object.
+    struct ll_shm       *shm;       ///< Shared memory object, or NULL if not open.
+    size_t               size;      ///< Size of the mapping, in bytes.
+    uint32_t             stalled;   ///< Ring position of the uncommitted record holding up the
+                                    ///< collector.
+    uint64_t             since;     ///< Monotonic time at which the collector was first held up at
+                                    ///< that record, in nanoseconds, or zero if it is not.
+};
+
+/**
+ * Create the shared memory object for a collector, with a ring of a given size.  Any existing
+ * object of the same name is marked as closed and unlinked first, so that processes still attached
+ * to it move to the fresh one, which is created readable and writable by the owner only.
+ *
+ * @retval  0   The object was created.
+ * @retval  -1  The object could not be created or mapped, or the size is not a power of two.
+ */
+int ll_shm_collector_open
+(
+    struct ll_shm_collector *collector, ///< [out] Collector.
+    const char              *name,      ///< [in]  Name of the shared memory object, starting with
+                                        ///<       '/'.  Must remain valid.
+    size_t                   size       ///< [in]  Size of the ring data area, in bytes.  Must be a
+                                        ///<       power of two, large enough for two maximum size
+                                        ///<       messages.
+);
+
+/**
+ * Pass the messages waiting in the ring to a list of targets, oldest first, in batches of up to
+ * LL_BATCH_SIZE.  Messages dropped by the shared memory targets since the last call are reported.
+ * A message which holds up the collector, reserved but not filled in, is skipped and reported once
+ * the process which reserved it is found to have exited.  The targets are not flushed.
+ *
+ * @return The number of messages passed on.  Zero if the ring is empty, in which case the caller
+ *         should wait a little before trying again, as producers do not signal the collector.
+ */
+size_t ll_shm_collect
+(
+    struct ll_shm_collector *collector, ///< [in] Collector.
+    struct ll_target        *targets,   ///< [in] List of targets to pass the messages to.
+    size_t                   limit      ///< [in] Most messages to pass on in this call.
+);
+
+/**
+ * Unmap and unlink the shared memory object of a collector.  Messages still in the ring are lost,
+ * so they should be collected first.  The object is marked as closed, so that attached targets
+ * attach again to the object of the next collector.
+ */
+void ll_shm_collector_close
+(
+    struct ll_shm_collector *collector  ///< [in] Collector.
+);
+
+#endif /* end LL_TARGET_SHM_H */
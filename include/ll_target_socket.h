@@ -0,0 +1,136 @@
+/**
+ * @file        ll_target_socket.h
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       UNIX domain socket log target.
+ *              Messages are gathered into batches and sent to a local collector agent, without ever
+ *              blocking the logging thread on the socket.
+ */
+#ifndef LL_TARGET_SOCKET_H
+#define LL_TARGET_SOCKET_H
+
+#include "ll_target_file.h"
+
+/**
+ * UNIX domain socket log target.  Messages are kept in the buffer, which acts as a bounded spill
+ * area, and are sent in batches with sendmmsg() where available.  A batch is sent when
+ * LL_SOCKET_BATCH messages have gathered, when a message is at or below the flush level, when the
+ * oldest message has waited for the flush delay as of the next message, and when the target is
+ * flushed with ll_target_flush.
+ *
+ * The socket is non-blocking.  Messages the collector is not ready for stay in the buffer until the
+ * next attempt, and if the buffer fills up, new messages are dropped and counted, and the loss is
+ * reported once the collector catches up.  If the socket cannot be connected, or the connection
+ * fails, it is reconnected on a later attempt, waiting twice as long after each failure, up to a
+ * limit.
+ *
+ * With a datagram socket each message is sent as one datagram.  With a stream socket each text
+ * message is followed by a newline.  Compact records are sent as they are, so that the collector
+ * receives the same bytes as a compact log file.  This target requires sendmsg().
+ */
+struct ll_socket_target
+{
+    struct ll_target     target;        ///< Target interface.  Must be the first member.
+
+    const char          *path;          ///< Path of the collector's socket.
+    int                  type;          ///< Socket type, SOCK_DGRAM or SOCK_STREAM.
+    char                *buffer;        ///< Buffer to keep messages in.
+    size_t               size;          ///< Size of the buffer, in bytes.
+    ll_timestamp_t       delay;         ///< Longest time a message may wait in the buffer, in
+                                        ///< nanoseconds, or LL_FILE_NO_DELAY.  Time stamps must be
+                                        ///< enabled for this to have an effect.
+    enum ll_level        flush_level;   ///< Messages at or below this level are sent immediately,
+                                        ///< along with everything buffered before them.
+
+    int                  fd;            ///< Connected socket, or -1.
+    size_t               first;         ///< Offset of the first message in the buffer.
+    size_t               used;          ///< Offset of the end of the last message in the buffer.
+    size_t               count;         ///< Number of messages in the buffer.
+    size_t               sent;          ///< Number of bytes of the first message already sent on a
+                                        ///< stream socket.
+    ll_timestamp_t       oldest;        ///< Time stamp of the oldest message in the buffer.
+    uint64_t             retry;         ///< Monotonic time before which no connection is attempted,
+                                        ///< in nanoseconds.
+    uint64_t             backoff;       ///< Time to wait after the next connection failure, in
+                                        ///< nanoseconds, or zero after a success.
+    uint32_t             dropped;       ///< Number of messages dropped since the last report.
+
+#if LL_THREADING
+    ll_mutex             mutex;         ///< Mutex used to serialize buffer accesses.
+#endif
+};
+
+/**
+ * Initialiser for a UNIX domain socket log target.
+ *
+ * @param   next        Next target instance, or NULL if this is the last target of a log.
+ * @param   path        Path of the collector's socket.
+ * @param   type        Socket type, SOCK_DGRAM or SOCK_STREAM.
+ * @param   buffer      Buffer to keep messages in.  This must remain valid as long as the target
+ *                      is in use.
+ * @param   size        Size of the buffer, in bytes.
+ * @param   delay       Longest time a message may wait in the buffer, in nanoseconds, or
+ *                      LL_FILE_NO_DELAY.
+ * @param   flush_level Messages at or below this level are sent immediately.
+ *
+ * Example:
+ * @code
+ * static char SocketBuffer[65536];
+ * static struct ll_socket_target SocketTarget = LL_SOCKET_TARGET_INIT(NULL, "/run/agent.sock",
+ *                                                                     SOCK_DGRAM, SocketBuffer,
+ *                                                                     sizeof(SocketBuffer),
+ *                                                                     100000000, LL_LEVEL_ERROR);
+ * @endcode
+ */
+#define LL_SOCKET_TARGET_INIT(next, path, type, buffer, size, delay, flush_level)          \
+    {                                                                                       \
+        { (next), &_ll_socket_send, NULL, NULL, &_ll_socket_flush, &_ll_socket_emergency,   \
+          &_ll_socket_send_batch, LL_LEVEL_INHERIT },                                       \
+        (path), (type), (buffer), (size), (delay), (flush_level), -1                        \
+    }
+
+/**
+ * Try to send everything in the buffer of a socket target and close its socket.  Messages which
+ * cannot be sent without blocking are discarded.
+ */
+void ll_socket_target_close
+(
+    struct ll_socket_target *target     ///< [in] Socket target.
+);
+
+/// Send function of the UNIX domain socket target.
+void _ll_socket_send
+(
+    struct ll_target    *target,
+    enum ll_level        level,
+    ll_timestamp_t       timestamp,
+    const char          *message,
+    size_t               length
+);
+
+/// Batch send function of the UNIX domain socket target, which buffers the whole batch before
+/// sending.
+void _ll_socket_send_batch
+(
+    struct ll_target        *target,
+    const struct ll_record  *records,
+    size_t                   count
+);
+
+/// Flush function of the UNIX domain socket target, which tries to send the whole buffer.
+void _ll_socket_flush
+(
+    struct ll_target    *target
+);
+
+/// Emergency function of the UNIX domain socket target.
+void _ll_socket_emergency
+(
+    struct ll_target    *target,
+    const char          *message,
+    size_t               length
+);
+
+#endif /* end LL_TARGET_SOCKET_H */
@@ -0,0 +1,126 @@
+/**
+ * @file        ll_target_syslog.h
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       System log target.
+ *              Messages are sent straight to the system log daemon, either as structured journald
+ *              entries or as RFC 5424 syslog messages, with one system call per message.
+ */
+#ifndef LL_TARGET_SYSLOG_H
+#define LL_TARGET_SYSLOG_H
+
+#include "ll_log.h"
+
+/// Path of the journald native protocol socket.
+#define LL_SYSLOG_JOURNAL_PATH  "/run/systemd/journal/socket"
+
+/// Path of the local syslog socket.
+#define LL_SYSLOG_DEV_LOG_PATH  "/dev/log"
+
+/// Structured data ID of the location fields in RFC 5424 messages.
+#ifndef LL_SYSLOG_SD_ID
+#   define LL_SYSLOG_SD_ID      "loglib@32473"
+#endif
+
+/// Size of the host name kept for RFC 5424 messages, including the terminator.
+#define LL_SYSLOG_HOSTNAME_SIZE 65
+
+/// Protocols spoken by the system log target.
+enum ll_syslog_protocol
+{
+    LL_SYSLOG_JOURNAL,      ///< journald native protocol.
+    LL_SYSLOG_RFC5424       ///< RFC 5424 syslog messages.
+};
+
+/**
+ * System log target.  Each message goes out in one sendmsg() on an unconnected datagram socket,
+ * gathered straight from the formatted message, so that no lock is taken and the daemon may be
+ * restarted at any time.  The level is mapped to a syslog priority, and the source location and
+ * logger path are split out of the standard message layout into fields of their own: CODE_FILE,
+ * CODE_LINE and LOGGER for journald, or structured data for RFC 5424.
+ *
+ * A journald entry too large for a datagram is written to a sealed memfd instead, and the file
+ * descriptor is passed to journald, as systemd's own client does.  RFC 5424 messages too large
+ * for a datagram are dropped.  Messages the daemon does not accept are counted, and the loss is
+ * reported once a message gets through.  Compact records are sent as the message, as they are.
+ *
+ * The socket is created the first time a message is logged.  Sending blocks if the daemon falls
+ * behind, as with syslog().  This target requires sendmsg().
+ */
+struct ll_syslog_target
+{
+    struct ll_target         target;        ///< Target interface.  Must be the first member.
+
+    const char              *path;          ///< Path of the daemon's socket.
+    enum ll_syslog_protocol  protocol;      ///< Protocol spoken to the daemon.
+    const char              *identifier;    ///< Program name sent with each message, or NULL to let
+                                            ///< journald use the process name.
+    unsigned int             facility;      ///< Syslog facility code, 0 to 23.
+
+    volatile uint32_t        state;         ///< Setup state of the target.
+    int                      fd;            ///< Datagram socket, once set up.
+    unsigned long            pid;           ///< Process ID, for RFC 5424 messages.
+    char                     hostname[LL_SYSLOG_HOSTNAME_SIZE]; ///< Host name, for RFC 5424.
+    volatile uint32_t        dropped;       ///< Number of messages dropped since the last report.
+    volatile uint32_t        users;         ///< Number of threads using the socket, which is not
+                                            ///< closed until they are done.
+
+#if LL_THREADING
+    ll_mutex                 mutex;         ///< Mutex used to serialize setup and closing.
+#endif
+};
+
+/**
+ * Initialiser for a system log target.
+ *
+ * @param   next        Next target instance, or NULL if this is the last target of a log.
+ * @param   path        Path of the daemon's socket, such as LL_SYSLOG_JOURNAL_PATH.
+ * @param   protocol    Protocol spoken to the daemon.
+ * @param   identifier  Program name sent with each message, or NULL.
+ * @param   facility    Syslog facility code, such as 1 for user-level messages.
+ *
+ * Example:
+ * @code
+ * static struct ll_syslog_target JournalTarget = LL_SYSLOG_TARGET_INIT(NULL,
+ *                                                                      LL_SYSLOG_JOURNAL_PATH,
+ *                                                                      LL_SYSLOG_JOURNAL,
+ *                                                                      "myapp", 1);
+ * @endcode
+ */
+#define LL_SYSLOG_TARGET_INIT(next, path, protocol, identifier, facility)                   \
+    {                                                                                       \
+        { (next), &_ll_syslog_send, NULL, NULL, NULL, &_ll_syslog_emergency, NULL,          \
+          LL_LEVEL_INHERIT },                                                               \
+        (path), (protocol), (identifier), (facility), 0, -1                                 \
+    }
+
+/**
+ * Close the socket of a system log target, once any messages being sent through it have gone.  The
+ * target may be used again afterwards, in which case a new socket is created.
+ */
+void ll_syslog_target_close
+(
+    struct ll_syslog_target *target     ///< [in] System log target.
+);
+
+/// Send function of the system log target.
+void _ll_syslog_send
+(
+    struct ll_target    *target,
+    enum ll_level        level,
+    ll_timestamp_t       timestamp,
+    const char          *message,
+    size_t               length
+);
+
+/// Emergency function of the system log target, which sends the message without blocking.
+void _ll_syslog_emergency
+(
+    struct ll_target    *target,
+    const char          *message,
+    size_t               length
+);
+
+#endif /* end LL_TARGET_SYSLOG_H */
@@ -0,0 +1,137 @@
+/**
+ * @file        ll_target_uring.h
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       io_uring log file target.
+ *              A buffered file target which hands full buffers to the kernel through an io_uring
+ *              and carries on filling another, rather than waiting for write(2) to return.
+ */
+#ifndef LL_TARGET_URING_H
+#define LL_TARGET_URING_H
+
+#include "ll_target_file.h"
+
+/**
+ * io_uring log file target.  The buffer is divided into LL_URING_SEGMENTS segments, which are
+ * registered with the kernel along with the file descriptor.  Messages are gathered in one segment,
+ * and when it fills, or a message calls for it as with the buffered file target, the segment is
+ * submitted as a single write and the next segment is filled meanwhile.  A logging thread only
+ * waits when every segment is in flight.
+ *
+ * The io_uring is set up with raw system calls the first time a message is written.  Where that
+ * fails, as on kernels before 5.1 or where io_uring is disabled, the target acts as a buffered file
+ * target instead, writing the whole buffer with writev.
+ */
+struct ll_uring_target
+{
+    struct ll_file_target    file;          ///< Buffered file target, used as is if io_uring is
+                                            ///< unavailable.  Must be the first member.
+
+    int                      state;         ///< Set up state of the io_uring.
+    int                      ring_fd;       ///< io_uring file descriptor.
+    unsigned int             flags;         ///< Registrations which succeeded.
+    uint64_t                 offset;        ///< File offset at which the next write starts.
+    unsigned int             current;       ///< Index of the segment being filled.
+    size_t                   pending[LL_URING_SEGMENTS];    ///< Length of the write in flight
+                                                            ///< from each segment, or zero.
+    uint64_t                 offsets[LL_URING_SEGMENTS];    ///< File offset of the write in
+                                                            ///< flight from each segment.
+
+    void                    *sq_map;        ///< Submission queue ring mapping.
+    size_t                   sq_map_size;   ///< Size of the submission queue ring mapping.
+    void                    *cq_map;        ///< Completion queue ring mapping.
+    size_t                   cq_map_size;   ///< Size of the completion queue ring mapping.
+    void                    *sqes;          ///< Submission queue entries mapping.
+    size_t                   sqes_size;     ///< Size of the submission queue entries mapping.
+    uint32_t                 sq_fields[4];  ///< Offsets of the submission queue head, tail, mask,
+                                            ///< and array in its mapping.
+    uint32_t                 cq_fields[4];  ///< Offsets of the completion queue head, tail, mask,
+                                            ///< and entries in its mapping.
+};
+
+/**
+ * Initialiser for an io_uring log file target.
+ *
+ * @param   next        Next target instance, or NULL if this is the last target of a log.
+ * @param   fd          File descriptor to write to.  Messages are appended to the end of the file.
+ *                      O_APPEND is cleared, as writes are made at explicit offsets.
+ * @param   buffer      Buffer to gather messages in.  This must remain valid as long as the target
+ *                      is in use.
+ * @param   size        Size of the buffer, in bytes.
+ * @param   delay       Longest time a message may wait in the buffer, in nanoseconds, or
+ *                      LL_FILE_NO_DELAY.
+ * @param   flush_level Messages at or below this level are submitted immediately.
+ *
+ * Example:
+ * @code
+ * static char RingBuffer[4 * 65536];
+ * static struct ll_uring_target RingTarget = LL_URING_TARGET_INIT(NULL, -1, RingBuffer,
+ *                                                                 sizeof(RingBuffer), 100000000,
+ *                                                                 LL_LEVEL_ERROR);
+ * @endcode
+ */
+#define LL_URING_TARGET_INIT(next, fd, buffer, size, delay, flush_level)                    \
+    {                                                                                       \
+        {                                                                                   \
+            { (next), &_ll_uring_send, &_ll_uring_reserve, &_ll_uring_commit,               \
+              &_ll_uring_flush, &_ll_uring_emergency, NULL, LL_LEVEL_INHERIT },             \
+            (fd), (buffer), (size), 0, (delay), 0, (flush_level)                            \
+        },                                                                                  \
+        0, -1                                                                               \
+    }
+
+/**
+ * Stop writing to the file of an io_uring target.  Every write is submitted and waited for, the
+ * file and buffers are unregistered, and the io_uring is closed.  The file descriptor is not
+ * closed, and is left positioned at the end of the file.  If the target is used again, a new
+ * io_uring is set up.
+ */
+void ll_uring_target_close
+(
+    struct ll_uring_target  *target     ///< [in] io_uring target.
+);
+
+/// Send function of the io_uring target.
+void _ll_uring_send
+(
+    struct ll_target    *target,
+    enum ll_level        level,
+    ll_timestamp_t       timestamp,
+    const char          *message,
+    size_t               length
+);
+
+/// Reserve function of the io_uring target.
+char *_ll_uring_reserve
+(
+    struct ll_target    *target,
+    size_t               size
+);
+
+/// Commit function of the io_uring target.
+void _ll_uring_commit
+(
+    struct ll_target    *target,
+    enum ll_level        level,
+    ll_timestamp_t       timestamp,
+    char                *message,
+    size_t               length
+);
+
+/// Flush function of the io_uring target, which waits until every write has completed.
+void _ll_uring_flush
+(
+    struct ll_target    *target
+);
+
+/// Emergency function of the io_uring target.
+void _ll_uring_emergency
+(
+    struct ll_target    *target,
+    const char          *message,
+    size_t               length
+);
+
+#endif /* end LL_TARGET_URING_H */
@@ -0,0 +1,464 @@
+/**
+ * @file        async.c
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       Asynchronous message queue, serviced by a background delivery thread.
+ *
+ * Messages are passed to the background thread through a lock-free ring buffer, so producers do not
+ * take any lock in the common case.  The queue mutex is only used to put the background thread to
+ * sleep when the ring is empty, to put producers to sleep when it is full, and, under the
+ * LL_OVERFLOW_DROP_OLDEST policy, to let producers discard records on the consumer's behalf.
+ *
+ * The background thread hands each run of queued messages bound for the same targets to them in one
+ * batch, and only then removes the run from the ring.
+ *
+ * Producers only read the clock.  Converting the reading to a time stamp and formatting it are left
+ * to the background thread, which fills in a placeholder in the queued message.
+ */
+#include "ll_log.h"
+#include "ll_ring.h"
+
+#include "async.h"
+#include "common.h"
+#include "timestamp.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if LL_ASYNC
+
+#   if LL_ASYNC_QUEUE_SIZE < 2 * (LL_MAX_MESSAGE_SIZE + 64)
+#       error The asynchronous queue must be large enough to hold two maximum size messages!
+#   endif
+
+/// Background thread states.
+enum state
+{
+    STATE_STOPPED,  ///< Thread has not been started yet.
+    STATE_RUNNING,  ///< Thread is running.
+    STATE_FAILED    ///< Thread could not be started; messages are delivered synchronously.
+};
+
+/// Queued message header.  The message text and its terminator immediately follow.
+struct record
+{
+    struct ll_log   *log;           ///< Log the message was written to.
+    ll_timestamp_t   clock;         ///< Clock reading for the time stamp.
+    enum ll_level    level;         ///< Message level.
+    enum stamp       stamp;         ///< Kind of time stamp placeholder in the message.
+    size_t           offset;        ///< Offset of the time stamp placeholder in the message.
+};
+
+/// Message queue.
+static LL_RING_DEFINE(queue, LL_ASYNC_QUEUE_SIZE) = LL_RING_INIT(LL_ASYNC_QUEUE_SIZE);
+/// Background thread state.
+static volatile uint32_t    state = STATE_STOPPED;
+/// Non-zero while the background thread is waiting for messages.
+static volatile uint32_t    sleeping;
+/// Number of producers waiting for space in the queue.
+static volatile uint32_t    waiting;
+/// Number of messages discarded since the last report.
+static volatile uint32_t    dropped;
+/// Set once the failure to start the background thread has been reported.
+static volatile uint32_t    failure_reported;
+/// Cleared while the background thread is idle.  Protected by the queue mutex.
+static int                  busy;
+/// Background thread handle.
+static ll_thread            consumer;
+
+#   if LL_ASYNC_OVERFLOW == LL_OVERFLOW_DROP_OLDEST
+/// Copy of the record being delivered, so that producers may discard the queued original.
+static union
+{
+    struct record   record;                                             ///< Record header.
+    char            bytes[sizeof(struct record) + LL_MAX_MESSAGE_SIZE]; ///< Header and message.
+} current;
+#   endif /* end LL_ASYNC_OVERFLOW == LL_OVERFLOW_DROP_OLDEST */
+
+/// Mutex protecting the sleep and wake up of the background thread and producers.
+static ll_mutex             mutex       = LL_STATIC_MUTEX_INIT;
+/// Signalled when a record is added to the queue while the background thread is sleeping.
+static ll_cond              not_empty   = LL_STATIC_COND_INIT;
+/// Signalled when a record is removed from the queue while producers are waiting.
+static ll_cond              not_full    = LL_STATIC_COND_INIT;
+/// Signalled when the queue has been drained.
+static ll_cond              idle        = LL_STATIC_COND_INIT;
+
+/// Report messages lost to queue overflow.
+static void report_dropped(void)
+{
+    uint32_t lost = LL_ATOMIC_LOAD_RELAXED(&dropped);
+
+    if (lost > 0)
+    {
+        LL_ATOMIC_FETCH_SUB(&dropped, lost);
+#   if LL_LOCATION
+        post_error("Asynchronous queue overflow, messages were dropped!", NULL, 0);
+#   else
+        post_error("Asynchronous queue overflow, messages were dropped!");
+#   endif
+    }
+}
+
+/**
+ * Convert the clock reading of a message to a time stamp and write it over the placeholder.
+ *
+ * @return Time stamp of the message.
+ */
+static ll_timestamp_t write_stamp
+(
+    char            *message,   ///< [in,out] Message text.
+    ll_timestamp_t   clock,     ///< [in]     Clock reading obtained by LL_GET_TIME.
+    enum stamp       stamp,     ///< [in]     Kind of time stamp placeholder in the message.
+    size_t           offset     ///< [in]     Offset of the time stamp placeholder in the message.
+)
+{
+    ll_timestamp_t timestamp = 0;
+
+#   if LL_TIMESTAMP
+    const char *err;
+
+    if (stamp != STAMP_NONE)
+    {
+        timestamp = LL_CLOCK_TO_TIMESTAMP(clock);
+    }
+    if (stamp == STAMP_TEXT)
+    {
+        err = format_timestamp(message + offset, timestamp);
+        if (err != NULL)
+        {
+#       if LL_LOCATION
+            post_error(err, NULL, 0);
+#       else
+            post_error(err);
+#       endif
+        }
+    }
+    else if (stamp == STAMP_BINARY)
+    {
+        memcpy(message + offset, &timestamp, sizeof(timestamp));
+    }
+#   else /* !LL_TIMESTAMP */
+    LL_UNUSED(message);
+    LL_UNUSED(clock);
+    LL_UNUSED(stamp);
+    LL_UNUSED(offset);
+#   endif /* end !LL_TIMESTAMP */
+
+    return timestamp;
+}
+
+/// Wait for a record to arrive in the queue.  The queue mutex must be held by the caller.
+static struct record *wait_for_record(size_t *length)
+{
+    struct record *record;
+
+    LL_ATOMIC_STORE_RELAXED(&sleeping, 1);
+    LL_ATOMIC_FENCE();
+    while ((record = ll_ring_peek(&queue.ring, length)) == NULL)
+    {
+        busy = 0;
+        LL_COND_BROADCAST(&idle);
+        LL_COND_WAIT(&not_empty, &mutex);
+    }
+    LL_ATOMIC_STORE_RELAXED(&sleeping, 0);
+    busy = 1;
+
+    return record;
+}
+
+#   if LL_ASYNC_OVERFLOW != LL_OVERFLOW_DROP_OLDEST
+/// Find the log whose targets a log writes to, without locking, to tell which records can share a
+/// batch.
+static struct ll_log *owner_of(struct ll_log *log)
+{
+    while (log != NULL && log->targets == NULL)
+    {
+        log = log->parent;
+    }
+    return log;
+}
+
+/**
+ * Deliver the run of records at the front of the queue which were written to logs sharing the same
+ * targets, up to LL_BATCH_SIZE of them, to those targets in one batch, and then remove them.  The
+ * queue must not be empty.
+ */
+static void deliver_batch(void)
+{
+    struct ll_record     batch[LL_BATCH_SIZE];
+    struct record       *record;
+    struct ll_log       *log = NULL;
+    struct ll_log       *owner = NULL;
+    uint32_t             position = LL_ATOMIC_LOAD_RELAXED(&queue.ring.tail);
+    uint32_t             next = position;
+    size_t               count = 0;
+    size_t               length;
+
+    while (count < LL_BATCH_SIZE && (record = ll_ring_scan(&queue.ring, &next, &length)) != NULL)
+    {
+        if (count == 0)
+        {
+            log     = record->log;
+            owner   = owner_of(log);
+        }
+        else if (owner_of(record->log) != owner)
+        {
+            break;
+        }
+
+        batch[count].level      = record->level;
+        batch[count].message    = (char *) (record + 1);
+        batch[count].length     = length - sizeof(*record) - 1;
+        batch[count].timestamp  = write_stamp((char *) (record + 1), record->clock, record->stamp,
+                                              record->offset);
+        ++count;
+        position = next;
+    }
+
+    assert(count > 0);
+    send_batch_to_targets(log, batch, count);
+    ll_ring_release_to(&queue.ring, position);
+}
+#   endif /* end LL_ASYNC_OVERFLOW != LL_OVERFLOW_DROP_OLDEST */
+
+/// Background thread entry point.  Removes records from the queue and delivers them.
+static LL_THREAD_FUNC(consume, arg)
+{
+    struct record   *record;
+    size_t           length;
+#   if LL_ASYNC_OVERFLOW == LL_OVERFLOW_DROP_OLDEST
+    char            *message;
+    ll_timestamp_t   timestamp;
+#   endif
+
+    LL_UNUSED(arg);
+
+    for (;;)
+    {
+#   if LL_ASYNC_OVERFLOW == LL_OVERFLOW_DROP_OLDEST
+        // Producers may discard queued records, so take a private copy under the lock.
+        LL_LOCK(&mutex);
+        record = ll_ring_peek(&queue.ring, &length);
+        if (record == NULL)
+        {
+            record = wait_for_record(&length);
+        }
+        memcpy(current.bytes, record, length);
+        ll_ring_release(&queue.ring);
+        LL_UNLOCK(&mutex);
+        record = &current.record;
+
+        report_dropped();
+        message     = (char *) (record + 1);
+        timestamp   = write_stamp(message, record->clock, record->stamp, record->offset);
+        send_to_targets(record->log,
+                        record->level,
+                        timestamp,
+                        message,
+                        length - sizeof(*record) - 1);
+#   else /* LL_ASYNC_OVERFLOW != LL_OVERFLOW_DROP_OLDEST */
+        record = ll_ring_peek(&queue.ring, &length);
+        if (record == NULL)
+        {
+            LL_LOCK(&mutex);
+            record = wait_for_record(&length);
+            LL_UNLOCK(&mutex);
+        }
+
+        report_dropped();
+        deliver_batch();
+#   endif /* end LL_ASYNC_OVERFLOW != LL_OVERFLOW_DROP_OLDEST */
+
+        // Wake any producers waiting for space.
+        LL_ATOMIC_FENCE();
+        if (LL_ATOMIC_LOAD_RELAXED(&waiting) != 0)
+        {
+            LL_LOCK(&mutex);
+            LL_COND_BROADCAST(&not_full);
+            LL_UNLOCK(&mutex);
+        }
+    }
+
+    LL_THREAD_RETURN;
+}
+
+/// Start the background thread, if that has not already been attempted.
+static void start(void)
+{
+    LL_LOCK(&mutex);
+    if (LL_ATOMIC_LOAD_RELAXED(&state) == STATE_STOPPED)
+    {
+        busy = 1;
+        if (LL_THREAD_START(&consumer, &consume, NULL) == 0)
+        {
+            LL_ATOMIC_STORE_RELEASE(&state, STATE_RUNNING);
+            atexit(&ll_flush);
+        }
+        else
+        {
+            busy = 0;
+            LL_ATOMIC_STORE_RELEASE(&state, STATE_FAILED);
+        }
+    }
+    LL_UNLOCK(&mutex);
+}
+
+/// Reserve space in the queue, applying the overflow policy if it is full.
+static struct record *reserve(size_t size)
+{
+    struct record *record;
+
+    while ((record = ll_ring_reserve(&queue.ring, size)) == NULL)
+    {
+#   if LL_ASYNC_OVERFLOW == LL_OVERFLOW_BLOCK
+        LL_LOCK(&mutex);
+        LL_ATOMIC_FETCH_ADD(&waiting, 1);
+        record = ll_ring_reserve(&queue.ring, size);
+        if (record == NULL)
+        {
+            LL_COND_WAIT(&not_full, &mutex);
+        }
+        LL_ATOMIC_FETCH_SUB(&waiting, 1);
+        LL_UNLOCK(&mutex);
+        if (record != NULL)
+        {
+            break;
+        }
+#   elif LL_ASYNC_OVERFLOW == LL_OVERFLOW_DROP_NEWEST
+        LL_ATOMIC_FETCH_ADD(&dropped, 1);
+        break;
+#   elif LL_ASYNC_OVERFLOW == LL_OVERFLOW_DROP_OLDEST
+        size_t           length;
+        struct record   *oldest;
+
+        // Discard the oldest record, unless another producer is still writing it, in which case
+        // the new message is discarded instead.
+        LL_LOCK(&mutex);
+        oldest = ll_ring_peek(&queue.ring, &length);
+        if (oldest != NULL)
+        {
+            ll_ring_release(&queue.ring);
+        }
+        LL_UNLOCK(&mutex);
+        LL_ATOMIC_FETCH_ADD(&dropped, 1);
+        if (oldest == NULL)
+        {
+            break;
+        }
+#   else
+#       error Unknown asynchronous queue overflow policy!
+#   endif
+    }
+
+    return record;
+}
+
+/// Queue a formatted message for delivery to the targets of a log by the background thread.
+const char *async_push
+(
+    struct ll_log   *log,
+    enum ll_level    level,
+    ll_timestamp_t   clock,
+    enum stamp       stamp,
+    size_t           offset,
+    char            *message,
+    size_t           length
+)
+{
+    struct record *record;
+
+    assert(log != NULL);
+    assert(message != NULL);
+    assert(length < LL_MAX_MESSAGE_SIZE);
+
+    if (LL_ATOMIC_LOAD_ACQUIRE(&state) == STATE_STOPPED)
+    {
+        start();
+    }
+    if (LL_ATOMIC_LOAD_ACQUIRE(&state) == STATE_FAILED)
+    {
+        // The failure is only reported with the first message delivered synchronously.
+        send_to_targets(log, level, write_stamp(message, clock, stamp, offset), message, length);
+        return LL_ATOMIC_CAS(&failure_reported, 0, 1) ?
+            "Unable to start asynchronous logging thread!" : NULL;
+    }
+
+    record = reserve(sizeof(*record) + length + 1);
+    if (record == NULL)
+    {
+        return NULL;
+    }
+
+    record->log     = log;
+    record->clock   = clock;
+    record->level   = level;
+    record->stamp   = stamp;
+    record->offset  = offset;
+    memcpy(record + 1, message, length + 1);
+    ll_ring_commit(&queue.ring, record, sizeof(*record) + length + 1);
+
+    // Wake the background thread if it has gone to sleep.
+    LL_ATOMIC_FENCE();
+    if (LL_ATOMIC_LOAD_RELAXED(&sleeping) != 0)
+    {
+        LL_LOCK(&mutex);
+        LL_COND_SIGNAL(&not_empty);
+        LL_UNLOCK(&mutex);
+    }
+
+    return NULL;
+}
+
+/// Pass the messages waiting in the queue to the emergency functions of their targets.
+void async_emergency(void)
+{
+    struct record   *record;
+    char            *message;
+    uint32_t         position = LL_ATOMIC_LOAD_ACQUIRE(&queue.ring.tail);
+    size_t           length;
+
+    while ((record = ll_ring_scan(&queue.ring, &position, &length)) != NULL)
+    {
+        message = (char *) (record + 1);
+#   if LL_TIMESTAMP
+        if (record->stamp != STAMP_NONE)
+        {
+            ll_timestamp_t timestamp = LL_CLOCK_TO_TIMESTAMP_SAFE(record->clock);
+
+            if (record->stamp == STAMP_TEXT)
+            {
+                format_timestamp_safe(message + record->offset, timestamp);
+            }
+            else
+            {
+                memcpy(message + record->offset, &timestamp, sizeof(timestamp));
+            }
+        }
+#   endif /* end LL_TIMESTAMP */
+        emergency_send(record->log, message, length - sizeof(*record) - 1);
+    }
+}
+
+#endif /* end LL_ASYNC */
+
+/// Wait until all messages logged before this call have been delivered to their targets.
+void ll_flush(void)
+{
+#if LL_ASYNC
+    if (LL_ATOMIC_LOAD_ACQUIRE(&state) != STATE_RUNNING)
+    {
+        return;
+    }
+
+    LL_LOCK(&mutex);
+    while (busy || !ll_ring_empty(&queue.ring))
+    {
+        LL_COND_WAIT(&idle, &mutex);
+    }
+    LL_UNLOCK(&mutex);
+#endif /* end LL_ASYNC */
+}
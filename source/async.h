@@ -0,0 +1,59 @@
+/**
+ * @file        async.h
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       Asynchronous message queue, serviced by a background delivery thread.
+ */
+#ifndef ASYNC_H_
+#define ASYNC_H_
+
+#include "ll_internal.h"
+
+#include <stddef.h>
+
+#if LL_ASYNC
+/**
+ * Kinds of time stamp placeholder in a queued message.  Converting a clock reading to a time stamp
+ * and formatting it are left to the background thread, which writes the result over the
+ * placeholder before the message is delivered.
+ */
+enum stamp
+{
+    STAMP_NONE,     ///< The message has no time stamp.
+    STAMP_TEXT,     ///< TIMESTAMP_LENGTH characters to overwrite with the formatted time stamp.
+    STAMP_BINARY    ///< An ll_timestamp_t in host byte order, to overwrite with the time stamp.
+};
+
+/**
+ * Queue a formatted message for delivery to the targets of a log by the background thread.  The
+ * thread is started the first time this is called.  If the queue is full then the configured
+ * LL_ASYNC_OVERFLOW policy is applied.  If the thread cannot be started then messages are delivered
+ * synchronously, and the failure is returned only for the first of them.
+ *
+ * @retval  NULL        The message was queued, delivered, or discarded according to policy.
+ * @retval  non-NULL    An error occured.  The returned value is a constant string describing the
+ *                      error.
+ */
+const char *async_push
+(
+    struct ll_log   *log,           ///< [in] Log handle.
+    enum ll_level    level,         ///< [in] Message level.
+    ll_timestamp_t   clock,         ///< [in] Clock reading obtained by LL_GET_TIME, or zero.
+    enum stamp       stamp,         ///< [in] Kind of time stamp placeholder in the message.
+    size_t           offset,        ///< [in] Offset of the time stamp placeholder in the message.
+    char            *message,       ///< [in] Message text.  The placeholder may be overwritten.
+    size_t           length         ///< [in] Message length in bytes, excluding the terminator.
+);
+
+/**
+ * Pass the messages waiting in the queue to the emergency functions of their targets, without
+ * taking any lock or removing them from the queue, as is safe in a signal handler.  Messages which
+ * are still being written by producers are left out, as is everything after them.  The message
+ * being delivered by the background thread at the time may be written twice.
+ */
+void async_emergency(void);
+#endif /* end LL_ASYNC */
+
+#endif /* end ASYNC_H_ */
@@ -0,0 +1,96 @@
+/**
+ * @file        callsite.c
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       Enumeration and control of log statement call site descriptors.
+ *
+ * The linker gathers the descriptors of every log statement into the "ll_callsites" section and
+ * defines the __start_ll_callsites and __stop_ll_callsites symbols around it, so the descriptors
+ * form a single array.  The symbols are weak so that a program without any log statements still
+ * links.
+ */
+#include "ll_log.h"
+
+#include "port.h"
+
+#include <assert.h>
+#include <string.h>
+
+#if LL_CALLSITES
+
+/// Start of the call site descriptor array.
+extern struct ll_callsite __start_ll_callsites[] __attribute__((weak));
+/// End of the call site descriptor array.
+extern struct ll_callsite __stop_ll_callsites[] __attribute__((weak));
+
+/**
+ * Determine whether a source file name matches a pattern, either completely or in its trailing
+ * path components.
+ *
+ * @return Non-zero if the file name matches.
+ */
+static int match_file(const char *file, const char *pattern)
+{
+    size_t file_length      = strlen(file);
+    size_t pattern_length   = strlen(pattern);
+
+    if (pattern_length > file_length)
+    {
+        return 0;
+    }
+    if (strcmp(file + file_length - pattern_length, pattern) != 0)
+    {
+        return 0;
+    }
+    return  pattern_length == file_length                       ||
+            file[file_length - pattern_length - 1] == '/'       ||
+            file[file_length - pattern_length - 1] == '\\';
+}
+
+/// Iterate over the call site descriptors of every log statement in the program.
+struct ll_callsite *ll_callsite_next(struct ll_callsite *site)
+{
+    site = (site == NULL) ? __start_ll_callsites : site + 1;
+    while (site < __stop_ll_callsites)
+    {
+        if (site->level == LL_LEVEL_INHERIT || site->level <= LL_STATIC_MAX_LEVEL)
+        {
+            return site;
+        }
+        ++site;
+    }
+
+    return NULL;
+}
+
+/// Set the run time state of every log statement matching the given criteria.
+size_t ll_callsite_control
+(
+    const char              *file,
+    const char              *function,
+    unsigned int             line,
+    enum ll_callsite_state   state
+)
+{
+    struct ll_callsite  *site = NULL;
+    size_t               count = 0;
+
+    assert(state <= LL_CALLSITE_DISABLED);
+
+    while ((site = ll_callsite_next(site)) != NULL)
+    {
+        if ((file == NULL || match_file(site->file, file))                  &&
+            (function == NULL || strcmp(site->function, function) == 0)     &&
+            (line == 0 || site->line == line))
+        {
+            LL_ATOMIC_STORE_RELAXED(&site->state, (uint32_t) state);
+            ++count;
+        }
+    }
+
+    return count;
+}
+
+#endif /* end LL_CALLSITES */
@@ -0,0 +1,476 @@
+/**
+ * @file        clog.c
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       Log function implementation for compact log statements.
+ *
+ * A compact message is a binary record, in the byte order of the host, laid out as follows.
+ * @code{.unparsed}
+ * offset  size    field
+ * 0       2       Total record length in bytes, including this header.
+ * 2       1       Message level.
+ * 3       1       Flags.  Bit 0 is set if the record is big-endian.
+ * 4       4       Format string hash (LL_HASH).
+ * 8       8       Time stamp, in nanoseconds since the Epoch.  Zero if time stamps are disabled.
+ * 16      ...     Arguments.
+ * @endcode
+ *
+ * Each argument, including any '*' width or precision, is stored as the raw bytes of the type it
+ * was passed as, without padding.  Integers use the size of the type selected by the length
+ * modifier, floating point values are stored as double or long double, and pointers as void *.
+ * Strings are copied, honouring any precision, and followed by a zero byte.  The %n specifier
+ * stores nothing.
+ */
+#include "ll_log.h"
+
+#include "async.h"
+#include "common.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if LL_COMPACT
+
+#   if LL_MAX_MESSAGE_SIZE > 65536
+#       error Compact log messages are limited to 65536 bytes!
+#   endif
+
+/// Maximum record length, leaving room for a terminator.
+#   define LIMIT (LL_MAX_MESSAGE_SIZE - 1)
+
+/// Record flag indicating big-endian byte order.
+#   define FLAG_BIG_ENDIAN 0x01
+
+/// Compact record header.
+struct header
+{
+    uint16_t    length;     ///< Total record length in bytes, including this header.
+    uint8_t     level;      ///< Message level.
+    uint8_t     flags;      ///< Record flags.
+    uint32_t    hash;       ///< Format string hash.
+    uint64_t    timestamp;  ///< Time stamp, in nanoseconds since the Epoch.
+};
+
+/// Integer argument length modifiers.
+enum modifier
+{
+    MOD_NONE,   ///< No modifier, or hh or h.
+    MOD_L,      ///< l
+    MOD_LL,     ///< ll
+    MOD_J,      ///< j
+    MOD_Z,      ///< z
+    MOD_T,      ///< t
+    MOD_BIG_L   ///< L
+};
+
+/// Local implementation if _ll_clog is not inlined.
+LL_DEFINE_INLINE void _ll_clog
+(
+    struct ll_log   *log,
+    enum ll_level    level,
+#if LL_LOCATION
+    const char      *source,
+    unsigned int     line,
+#endif /* end LL_LOCATION */
+    ll_hash_t        hash,
+    const char      *format,
+    ...
+);
+
+/**
+ * Append an argument value to the record.
+ *
+ * @param   value   Value to append.  Must be an lvalue.
+ */
+#   define PUT(value)                                      \
+    do                                                     \
+    {                                                      \
+        if (used + sizeof(value) > LIMIT)                  \
+        {                                                  \
+            return "Message too long!";                    \
+        }                                                  \
+        memcpy(buffer + used, &(value), sizeof(value));    \
+        used += sizeof(value);                             \
+    } while (0)
+
+/**
+ * Append a string argument to the record.
+ *
+ * @retval  NULL        Operation was successful.
+ * @retval  non-NULL    An error occured.  The returned value is a constant string describing the
+ *                      error.
+ */
+static const char *put_string
+(
+    char            *buffer,    ///< [out]    Record buffer.
+    size_t          *used,      ///< [in,out] Number of bytes of the buffer in use.
+    const char      *string,    ///< [in]     String to append.  May be NULL.
+    int              precision  ///< [in]     Maximum number of bytes to copy, or negative for all.
+)
+{
+    size_t n;
+
+    if (string == NULL)
+    {
+        string = "(null)";
+    }
+
+    n = strlen(string);
+    if (precision >= 0 && (size_t) precision < n)
+    {
+        n = (size_t) precision;
+    }
+    if (*used + n + 1 > LIMIT)
+    {
+        return "Message too long!";
+    }
+
+    memcpy(buffer + *used, string, n);
+    buffer[*used + n] = '\0';
+    *used += n + 1;
+
+    return NULL;
+}
+
+/**
+ * Append the raw argument values to a compact record, using the format string to determine their
+ * types.
+ *
+ * @retval  NULL        Operation was successful.
+ * @retval  non-NULL    An error occured.  The returned value is a constant string describing the
+ *                      error.
+ */
+static const char *put_args
+(
+    char            *buffer,    ///< [out]    Record buffer.
+    size_t          *usedp,     ///< [in,out] Number of bytes of the buffer in use.
+    const char      *format,    ///< [in]     Format string.
+    va_list         *args       ///< [in]     Positional parameters of format string.
+)
+{
+    const char      *err;
+    size_t           used = *usedp;
+    enum modifier    modifier;
+    int              precision;
+
+    for (; *format != '\0'; ++format)
+    {
+        if (*format != '%')
+        {
+            continue;
+        }
+        ++format;
+        if (*format == '%')
+        {
+            continue;
+        }
+
+        // Flags.
+        while (*format != '\0' && strchr("-+ #0", *format) != NULL)
+        {
+            ++format;
+        }
+
+        // Width.
+        if (*format == '*')
+        {
+            int width = va_arg(*args, int);
+            PUT(width);
+            ++format;
+        }
+        while (*format >= '0' && *format <= '9')
+        {
+            ++format;
+        }
+
+        // Precision.
+        precision = -1;
+        if (*format == '.')
+        {
+            ++format;
+            if (*format == '*')
+            {
+                precision = va_arg(*args, int);
+                PUT(precision);
+                ++format;
+            }
+            else
+            {
+                precision = 0;
+                while (*format >= '0' && *format <= '9')
+                {
+                    precision = precision * 10 + (*format - '0');
+                    ++format;
+                }
+            }
+        }
+
+        // Length modifier.
+        modifier = MOD_NONE;
+        switch (*format)
+        {
+            case 'h':
+                format += (format[1] == 'h') ? 2 : 1;
+                break;
+            case 'l':
+                modifier = (format[1] == 'l') ? MOD_LL : MOD_L;
+                format += (format[1] == 'l') ? 2 : 1;
+                break;
+            case 'j':
+                modifier = MOD_J;
+                ++format;
+                break;
+            case 'z':
+                modifier = MOD_Z;
+                ++format;
+                break;
+            case 't':
+                modifier = MOD_T;
+                ++format;
+                break;
+            case 'L':
+                modifier = MOD_BIG_L;
+                ++format;
+                break;
+            default:
+                break;
+        }
+
+        // Conversion.
+        switch (*format)
+        {
+            case 'd':
+            case 'i':
+            case 'o':
+            case 'u':
+            case 'x':
+            case 'X':
+            case 'c':
+                // Wide characters are passed as wint_t, which is not recorded.
+                if (modifier == MOD_L && *format == 'c')
+                {
+                    return "Unsupported format specifier!";
+                }
+                switch (modifier)
+                {
+                    case MOD_L:
+                    {
+                        long value = va_arg(*args, long);
+                        PUT(value);
+                        break;
+                    }
+                    case MOD_LL:
+                    {
+                        long long value = va_arg(*args, long long);
+                        PUT(value);
+                        break;
+                    }
+                    case MOD_J:
+                    {
+                        intmax_t value = va_arg(*args, intmax_t);
+                        PUT(value);
+                        break;
+                    }
+                    case MOD_Z:
+                    {
+                        size_t value = va_arg(*args, size_t);
+                        PUT(value);
+                        break;
+                    }
+                    case MOD_T:
+                    {
+                        ptrdiff_t value = va_arg(*args, ptrdiff_t);
+                        PUT(value);
+                        break;
+                    }
+                    default:
+                    {
+                        int value = va_arg(*args, int);
+                        PUT(value);
+                        break;
+                    }
+                }
+                break;
+
+            case 'e':
+            case 'E':
+            case 'f':
+            case 'F':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A':
+                if (modifier == MOD_BIG_L)
+                {
+                    long double value = va_arg(*args, long double);
+                    PUT(value);
+                }
+                else
+                {
+                    double value = va_arg(*args, double);
+                    PUT(value);
+                }
+                break;
+
+            case 's':
+                // Wide strings are not recorded.
+                if (modifier == MOD_L)
+                {
+                    return "Unsupported format specifier!";
+                }
+                err = put_string(buffer, &used, va_arg(*args, const char *), precision);
+                if (err != NULL)
+                {
+                    return err;
+                }
+                break;
+
+            case 'p':
+            {
+                void *value = va_arg(*args, void *);
+                PUT(value);
+                break;
+            }
+
+            case 'n':
+                (void) va_arg(*args, void *);
+                break;
+
+            default:
+                return "Unsupported format specifier!";
+        }
+    }
+
+    *usedp = used;
+    return NULL;
+}
+
+/**
+ * Encode a compact record.
+ *
+ * @retval  NULL        Operation was successful and the record was written to the buffer.
+ * @retval  non-NULL    An error occured.  The returned value is a constant string describing the
+ *                      error.
+ */
+static const char *encode_record
+(
+    char            *buffer,    ///< [out] Buffer of LL_MAX_MESSAGE_SIZE bytes to write into.
+    enum ll_level    level,     ///< [in]  Message level.
+    ll_timestamp_t   timestamp, ///< [in]  Time stamp, or the clock reading if asynchronous.
+    ll_hash_t        hash,      ///< [in]  Compile-time hash of format string.
+    const char      *format,    ///< [in]  Format string.
+    va_list          args,      ///< [in]  Positional parameters of format string.
+    size_t          *length     ///< [out] Length of the record.
+)
+{
+    const char          *err;
+    struct header        header;
+    size_t               used;
+    va_list              copy;
+    const uint16_t       one = 1;
+
+    // Encode the arguments after the header.
+    used = sizeof(header);
+    va_copy(copy, args);
+    err = put_args(buffer, &used, format, &copy);
+    va_end(copy);
+    if (err != NULL)
+    {
+        return err;
+    }
+
+    buffer[used] = '\0';
+
+    header.length       = (uint16_t) used;
+    header.level        = (uint8_t) level;
+    header.flags        = (*(const uint8_t *) &one == 0) ? FLAG_BIG_ENDIAN : 0;
+    header.hash         = (uint32_t) hash;
+    header.timestamp    = timestamp;
+    memcpy(buffer, &header, sizeof(header));
+
+    *length = used;
+    return NULL;
+}
+
+/// Unconditionally log a compact message using a variable argument list.
+void _ll_clogv
+(
+    struct ll_log   *log,
+    enum ll_level    level,
+#if LL_LOCATION
+    const char      *source,
+    unsigned int     line,
+#endif /* end LL_LOCATION */
+    ll_hash_t        hash,
+    const char      *format,
+    va_list          args
+)
+{
+    const char          *err;
+    size_t               length = 0;
+    ll_timestamp_t       timestamp = 0;
+#   if !LL_ASYNC
+    struct ll_target    *target;
+    char                *reserved;
+#   endif /* end !LL_ASYNC */
+
+    assert(log != NULL);
+    assert(format != NULL);
+#if LL_LOCATION
+    assert(source != NULL);
+#endif
+
+#   if LL_TIMESTAMP
+    LL_GET_TIME(&timestamp);
+#       if !LL_ASYNC
+    timestamp = LL_CLOCK_TO_TIMESTAMP(timestamp);
+#       endif
+#   endif
+
+#   if !LL_ASYNC
+    // Encode the record straight into the target's own buffer, if it offers one.
+    reserved = reserve_direct(log, level, &target);
+    if (reserved != NULL)
+    {
+        err = encode_record(reserved, level, timestamp, hash, format, args, &length);
+        commit_direct(target, level, timestamp, reserved, (err == NULL) ? length : 0);
+    }
+    else
+#   endif /* end !LL_ASYNC */
+    {
+        LL_ALLOCATE_BUFFER(buffer, LL_MAX_MESSAGE_SIZE);
+
+        err = encode_record(buffer, level, timestamp, hash, format, args, &length);
+        if (err == NULL)
+        {
+#   if LL_ASYNC
+            // The background thread converts the clock reading in the header.
+            err = async_push(   log,
+                                level,
+                                timestamp,
+                                LL_TIMESTAMP ? STAMP_BINARY : STAMP_NONE,
+                                offsetof(struct header, timestamp),
+                                buffer,
+                                length);
+#   else /* !LL_ASYNC */
+            send_to_targets(log, level, timestamp, buffer, length);
+#   endif /* end !LL_ASYNC */
+        }
+        LL_RELEASE_BUFFER(buffer);
+    }
+
+    if (err != NULL)
+    {
+#if LL_LOCATION
+        post_error(err, source, line);
+#else
+        post_error(err);
+#endif
+    }
+}
+
+#endif /* end LL_COMPACT */
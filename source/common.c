@@ -6,10 +6,13 @@
  *
  * @brief       Common functions used by the logger implementations.
  */
+#include "ll_log.h"
+
 #include "common.h"
 
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
 
 #if LL_DEFAULT_LEVEL_MAPPING
 /// Provide the log level name mapping when using the default configuration.
@@ -24,33 +27,304 @@ const char *_ll_log_level_name[LL_LEVEL_INHERIT] =
 };
 #endif /* end LL_DEFAULT_LEVEL_MAPPING */
 
-/// Get the the threshold level below which a log's messages should be displayed.
-enum ll_level get_threshold(const struct ll_log *log)
+#if LL_PATH_CACHE_SIZE > 0
+/// Current path epoch.  Incremented whenever a parent link changes, which invalidates every cached
+/// path.  Starts at 1, which LL_LOG_INIT_PATH uses for the paths it provides, and skips zero and
+/// PATH_BUSY.
+static volatile uint32_t path_epoch = 1;
+
+/// Path epoch of a log whose cached path is being written.
+#   define PATH_BUSY UINT32_MAX
+#endif /* end LL_PATH_CACHE_SIZE > 0 */
+
+/// Target level epoch.  Incremented whenever the level of a target or a parent link changes, which
+/// invalidates the wanted level cached in every log.  Kept within 24 bits and never zero, so that a
+/// wanted field of zero is never taken as current.
+volatile uint32_t _ll_target_epoch = 1;
+
+/// Largest target level epoch.
+#define TARGET_EPOCH_MAX 0xFFFFFFU
+
+/**
+ * @def LOCK_TREE
+ * Lock the log hierarchy against changes, if supported.
+ */
+/**
+ * @def UNLOCK_TREE
+ * Unlock the log hierarchy, if supported.
+ */
+#if LL_THREADING
+/// Mutex serializing changes to the log hierarchy.
+static ll_mutex tree_mutex = LL_STATIC_MUTEX_INIT;
+#   define LOCK_TREE()      LL_LOCK(&tree_mutex)
+#   define UNLOCK_TREE()    LL_UNLOCK(&tree_mutex)
+#else /* !LL_THREADING */
+#   define LOCK_TREE()
+#   define UNLOCK_TREE()
+#endif /* end !LL_THREADING */
+
+/// Add a log to the children list of its parent, if it is not already there.  The hierarchy must be
+/// locked by the caller.
+static void link_child(struct ll_log *log)
+{
+    struct ll_log *child;
+
+    if (log->parent == NULL)
+    {
+        return;
+    }
+    for (child = log->parent->children; child != NULL; child = child->next)
+    {
+        if (child == log)
+        {
+            return;
+        }
+    }
+    log->next = log->parent->children;
+    log->parent->children = log;
+}
+
+/// Remove a log from the children list of its parent.  The hierarchy must be locked by the caller.
+static void unlink_child(struct ll_log *log)
 {
+    struct ll_log **link;
+
+    if (log->parent == NULL)
+    {
+        return;
+    }
+    for (link = &log->parent->children; *link != NULL; link = &(*link)->next)
+    {
+        if (*link == log)
+        {
+            *link = log->next;
+            log->next = NULL;
+            return;
+        }
+    }
+}
+
+/**
+ * Get the effective level of a log, resolving it and those of its ancestors if necessary.  Each log
+ * resolved is linked into its parent's children list so that later level changes reach it.  The
+ * hierarchy must be locked by the caller.
+ *
+ * @return The effective level of the log.
+ */
+static enum ll_level resolve(struct ll_log *log)
+{
+    enum ll_level level = (enum ll_level) LL_ATOMIC_LOAD_RELAXED(&log->effective);
+
+    if (level == LL_LEVEL_INHERIT)
+    {
+        link_child(log);
+        level = log->level;
+        if (level == LL_LEVEL_INHERIT)
+        {
+            level = (log->parent != NULL) ? resolve(log->parent) : LL_DEFAULT_LEVEL;
+        }
+        LL_ATOMIC_STORE_RELAXED(&log->effective, (uint32_t) level);
+    }
+
+    return level;
+}
+
+/**
+ * Recalculate the effective level of a log and push it down to the descendants which inherit it.
+ * The hierarchy must be locked by the caller.
+ */
+static void propagate(struct ll_log *log)
+{
+    struct ll_log   *child;
+    enum ll_level    level = log->level;
+
+    if (level == LL_LEVEL_INHERIT)
+    {
+        link_child(log);
+        level = (log->parent != NULL) ? resolve(log->parent) : LL_DEFAULT_LEVEL;
+    }
+    LL_ATOMIC_STORE_RELAXED(&log->effective, (uint32_t) level);
+
+    for (child = log->children; child != NULL; child = child->next)
+    {
+        if (child->level == LL_LEVEL_INHERIT)
+        {
+            propagate(child);
+        }
+    }
+}
+
+/// Local implementation if _ll_enabled is not inlined.
+LL_DEFINE_INLINE int _ll_enabled(struct ll_log *log, enum ll_level level);
+
+/// Resolve the effective level of a log which inherits its level, on first use.
+enum ll_level _ll_resolve_level(struct ll_log *log)
+{
+    enum ll_level level;
+
     assert(log != NULL);
 
-    while (log->level == LL_LEVEL_INHERIT)
+    LOCK_TREE();
+    level = resolve(log);
+    UNLOCK_TREE();
+
+    return level;
+}
+
+/// Set the threshold level of a log.
+void ll_set_level(struct ll_log *log, enum ll_level level)
+{
+    assert(log != NULL);
+    assert(level <= LL_LEVEL_INHERIT);
+
+    LOCK_TREE();
+    log->level = level;
+    propagate(log);
+    UNLOCK_TREE();
+}
+
+/// Advance the target level epoch.  The hierarchy must be locked by the caller.
+static void next_target_epoch(void)
+{
+    uint32_t epoch = _ll_target_epoch;
+
+    LL_ATOMIC_STORE_RELEASE(&_ll_target_epoch, (epoch == TARGET_EPOCH_MAX) ? 1U : epoch + 1U);
+}
+
+/// Work out the highest level any of the targets of a log takes, and cache it in the log.
+uint32_t _ll_resolve_wanted(struct ll_log *log)
+{
+    struct ll_log       *owner = log;
+    struct ll_target    *target;
+    uint32_t             epoch;
+    uint32_t             wanted;
+
+    assert(log != NULL);
+
+    // Read the epoch first, so that a level changed while the targets are examined leaves the
+    // result stale rather than wrong.  The logs are not locked, since target lists do not change
+    // once set up, and the level check must not wait on a log whose targets are writing.
+    epoch = LL_ATOMIC_LOAD_ACQUIRE(&_ll_target_epoch);
+    while (owner != NULL && owner->targets == NULL)
+    {
+        owner = owner->parent;
+    }
+
+    if (owner == NULL)
     {
-        if (log->parent != NULL)
+        wanted = LL_LEVEL_INHERIT;
+    }
+    else
+    {
+        wanted = 0;
+        for (target = owner->targets; target != NULL; target = target->next)
         {
-            log = log->parent;
+            uint32_t level = LL_ATOMIC_LOAD_RELAXED(&target->level);
+
+            if (level > wanted)
+            {
+                wanted = level;
+            }
         }
     }
 
-    return log->level;
+    wanted |= epoch << 8;
+    LL_ATOMIC_STORE_RELAXED(&log->wanted, wanted);
+    return wanted;
+}
+
+/// Set the threshold level of a target.
+void ll_set_target_level(struct ll_target *target, enum ll_level level)
+{
+    assert(target != NULL);
+    assert(level <= LL_LEVEL_INHERIT);
+
+    LL_ATOMIC_STORE_RELAXED(&target->level, (uint32_t) level);
+    LOCK_TREE();
+    next_target_epoch();
+    UNLOCK_TREE();
+}
+
+#if LL_PATH_CACHE_SIZE > 0
+/**
+ * Copy the cached path of a log into a buffer.
+ *
+ * @return  The length of the path, or a negative value if no valid path is cached or it does not
+ *          fit in the buffer.
+ */
+static int read_cached_path
+(
+    struct ll_log   *log,       ///< [in]  Log handle.
+    uint32_t         epoch,     ///< [in]  Current path epoch.
+    char            *buffer,    ///< [out] Buffer to write path to.
+    size_t           size       ///< [in]  Buffer size in bytes.
+)
+{
+    size_t length;
+
+    if (LL_ATOMIC_LOAD_ACQUIRE(&log->path_epoch) != epoch)
+    {
+        return -1;
+    }
+
+    length = log->path_length;
+    if (length >= LL_PATH_CACHE_SIZE || length >= size)
+    {
+        return -1;
+    }
+    memcpy(buffer, log->path, length);
+    buffer[length] = '\0';
+
+    // The path may have been rewritten while it was being copied.
+    LL_ATOMIC_FENCE();
+    if (LL_ATOMIC_LOAD_RELAXED(&log->path_epoch) != epoch)
+    {
+        return -1;
+    }
+    return (int) length;
+}
+
+/// Store a freshly built path in the cache of a log.  The cache is claimed atomically rather than
+/// by locking the log, as the log may already be locked while a message is formatted for its
+/// target.
+static void write_cached_path(struct ll_log *log, uint32_t epoch, const char *path, size_t length)
+{
+    uint32_t previous = LL_ATOMIC_LOAD_RELAXED(&log->path_epoch);
+
+    if (previous == PATH_BUSY || !LL_ATOMIC_CAS(&log->path_epoch, previous, PATH_BUSY))
+    {
+        // Another thread is writing the cache.
+        return;
+    }
+    memcpy(log->path, path, length + 1);
+    log->path_length = length;
+    LL_ATOMIC_STORE_RELEASE(&log->path_epoch, epoch);
 }
+#endif /* end LL_PATH_CACHE_SIZE > 0 */
 
 /// Get the path of the log, that is the names of this log and its ancestors as a single string.
-int get_path(const struct ll_log *log, char *buffer, size_t size)
+int get_path(struct ll_log *log, char *buffer, size_t size)
 {
     int length = 0;
-    const char *dot = "";
+    int n;
+#if LL_PATH_CACHE_SIZE > 0
+    uint32_t epoch = LL_ATOMIC_LOAD_ACQUIRE(&path_epoch);
+#endif
 
     assert(buffer != NULL);
     assert(log != NULL);
     assert(log->name != NULL);
     assert(size > 0);
 
+#if LL_PATH_CACHE_SIZE > 0
+    n = read_cached_path(log, epoch, buffer, size);
+    if (n >= 0)
+    {
+        return n;
+    }
+#endif /* end LL_PATH_CACHE_SIZE > 0 */
+
+    // Build the path from the parent's path, which is itself cached.
     if (log->parent != NULL)
     {
         length = get_path(log->parent, buffer, size);
@@ -58,12 +332,58 @@ int get_path(const struct ll_log *log, char *buffer, size_t size)
         {
             return length;
         }
+        if ((size_t) length + 1 >= size)
+        {
+            return length + 1 + (int) strlen(log->name);
+        }
+        buffer[length++] = '.';
+    }
+
+    n = snprintf(buffer + length, size - length, "%s", log->name);
+    if (n < 0)
+    {
+        return n;
+    }
+    n += length;
 
-        size -= length;
-        dot = ".";
+#if LL_PATH_CACHE_SIZE > 0
+    if ((size_t) n < size && n < LL_PATH_CACHE_SIZE)
+    {
+        write_cached_path(log, epoch, buffer, (size_t) n);
     }
+#endif /* end LL_PATH_CACHE_SIZE > 0 */
+
+    return n;
+}
+
+/// Change the parent of a log.
+int ll_set_parent(struct ll_log *log, struct ll_log *parent)
+{
+    struct ll_log *ancestor;
+
+    assert(log != NULL);
+
+    LOCK_TREE();
+    for (ancestor = parent; ancestor != NULL; ancestor = ancestor->parent)
+    {
+        if (ancestor == log)
+        {
+            UNLOCK_TREE();
+            return -1;
+        }
+    }
+
+    unlink_child(log);
+    log->parent = parent;
+    propagate(log);
+    next_target_epoch();
+#if LL_PATH_CACHE_SIZE > 0
+    // Only changed with the hierarchy locked, so a plain store suffices.
+    LL_ATOMIC_STORE_RELEASE(&path_epoch, (path_epoch + 1U == PATH_BUSY) ? 1U : path_epoch + 1U);
+#endif /* end LL_PATH_CACHE_SIZE > 0 */
+    UNLOCK_TREE();
 
-    return snprintf(buffer + length, size, "%s%s", dot, log->name);
+    return 0;
 }
 
 /// Get the list of targets to which a given log writes.
@@ -91,6 +411,183 @@ struct ll_target *get_targets(struct ll_log *log, struct ll_log **owner)
     return get_targets(log->parent, owner);
 }
 
+/// Pass a formatted message to each of the targets of a log.
+void send_to_targets
+(
+    struct ll_log   *log,
+    enum ll_level    level,
+    ll_timestamp_t   timestamp,
+    const char      *message,
+    size_t           length
+)
+{
+    struct ll_log       *target_owner = NULL;
+    struct ll_target    *target;
+
+    assert(message != NULL);
+
+    target = get_targets(log, &target_owner);
+    while (target != NULL)
+    {
+        if ((uint32_t) level <= target->level)
+        {
+            target->send(target, level, timestamp, message, length);
+        }
+        target = target->next;
+    }
+
+    if (target_owner != NULL)
+    {
+        UNLOCK(target_owner);
+    }
+}
+
+/// Pass a batch of formatted messages to each of the targets of a log.
+void send_batch_to_targets(struct ll_log *log, const struct ll_record *records, size_t count)
+{
+    struct ll_log       *target_owner = NULL;
+    struct ll_target    *targets;
+
+    assert(records != NULL);
+
+    targets = get_targets(log, &target_owner);
+    ll_target_send_batch(targets, records, count);
+
+    if (target_owner != NULL)
+    {
+        UNLOCK(target_owner);
+    }
+}
+
+/// Pass a formatted message to the emergency function of each of the targets of a log.
+void emergency_send(struct ll_log *log, const char *message, size_t length)
+{
+    struct ll_target *target;
+
+    assert(message != NULL);
+
+    // The logs are not locked, since the thread which crashed may hold their mutexes.
+    while (log != NULL && log->targets == NULL)
+    {
+        log = log->parent;
+    }
+    for (target = (log != NULL) ? log->targets : NULL; target != NULL; target = target->next)
+    {
+        if (target->emergency != NULL)
+        {
+            target->emergency(target, message, length);
+        }
+    }
+}
+
+/// Reserve space for a message in the target of a log, if it supports that.
+char *reserve_direct(struct ll_log *log, enum ll_level level, struct ll_target **target)
+{
+    struct ll_log   *ancestor;
+    struct ll_log   *owner = NULL;
+    char            *buffer = NULL;
+
+    assert(log != NULL);
+    assert(target != NULL);
+
+    // Check without locking first, so that logs without a suitable target pay nothing extra.
+    ancestor = log;
+    while (ancestor != NULL && ancestor->targets == NULL)
+    {
+        ancestor = ancestor->parent;
+    }
+    if (ancestor == NULL || ancestor->targets->reserve == NULL || ancestor->targets->next != NULL ||
+        (uint32_t) level > ancestor->targets->level)
+    {
+        return NULL;
+    }
+
+    *target = get_targets(log, &owner);
+    if (*target != NULL && (*target)->reserve != NULL && (*target)->next == NULL &&
+        (uint32_t) level <= (*target)->level)
+    {
+        // The target holds its own lock from here until the commit.  Targets are never freed, so
+        // it stays valid even if it is taken out of the list of the log meanwhile.
+        buffer = (*target)->reserve(*target, LL_MAX_MESSAGE_SIZE);
+    }
+
+    if (owner != NULL)
+    {
+        UNLOCK(owner);
+    }
+    return buffer;
+}
+
+/// Pass a message formatted into space from reserve_direct to its target.
+void commit_direct
+(
+    struct ll_target    *target,
+    enum ll_level        level,
+    ll_timestamp_t       timestamp,
+    char                *message,
+    size_t               length
+)
+{
+    assert(target != NULL);
+
+    target->commit(target, level, timestamp, message, length);
+}
+
+/// Write out the messages held buffered by a list of targets.
+void ll_target_flush(struct ll_target *targets)
+{
+    while (targets != NULL)
+    {
+        if (targets->flush != NULL)
+        {
+            targets->flush(targets);
+        }
+        targets = targets->next;
+    }
+}
+
+/// Pass a batch of messages to each of a list of targets.
+void ll_target_send_batch(struct ll_target *targets, const struct ll_record *records, size_t count)
+{
+    uint32_t    level;
+    size_t      taken;
+    size_t      i;
+
+    assert(records != NULL || count == 0);
+
+    if (count == 0)
+    {
+        return;
+    }
+    while (targets != NULL)
+    {
+        level = targets->level;
+        taken = 0;
+        while (taken < count && (uint32_t) records[taken].level <= level)
+        {
+            ++taken;
+        }
+
+        if (taken == count && targets->send_batch != NULL)
+        {
+            targets->send_batch(targets, records, count);
+        }
+        else
+        {
+            // Messages the target does not take are skipped, so pass the others one at a time.
+            for (i = 0; i < count; ++i)
+            {
+                if ((uint32_t) records[i].level <= level)
+                {
+                    targets->send(targets, records[i].level, records[i].timestamp,
+                                  records[i].message, records[i].length);
+                }
+            }
+        }
+        targets = targets->next;
+    }
+}
+
 ///  Display an error from the logging system itself.
 #if LL_LOCATION
 void post_error(const char *error, const char *source, unsigned int line)
@@ -15,15 +15,15 @@
 
 /**
  * @def LOCK
- * Lock a logger instance, if supported.
+ * Lock a logger or target instance, if supported.
  *
- * @param   logptr  Logger instance pointer.
+ * @param   logptr  Logger or target instance pointer.
  */
 /**
  * @def UNLOCK
- * Unlock a logger instance, if supported.
+ * Unlock a logger or target instance, if supported.
  *
- * @param   logptr  Logger instance pointer.
+ * @param   logptr  Logger or target instance pointer.
  */
 #if LL_THREADING
 #   define LOCK(logptr)     LL_LOCK(&(logptr)->mutex)
@@ -34,24 +34,47 @@
 #endif /* end !LL_THREADING */
 
 /**
- * Get the the threshold level below which a log's messages should be displayed.
+ * Write the body of a message, which follows the preamble of time stamp, level, location and log
+ * path.  At most *space bytes are written, including a terminator, and *space is reduced by the
+ * number of bytes written, excluding the terminator.
  *
- * @return The level below which to display messages.
+ * @retval  NULL        Operation was successful and the body was written to the buffer.
+ * @retval  non-NULL    An error occured.  The returned value is a constant string describing the
+ *                      error.
  */
-enum ll_level get_threshold
+typedef const char *(*body_writer)
 (
-    const struct ll_log *log    ///< Log handle.
+    char        *buffer,    ///< [out]    Buffer to write the body into.
+    size_t      *space,     ///< [in,out] Available space remaining in the buffer.
+    void        *context    ///< [in]     Context given with the function.
 );
 
 /**
- * Get the path of the log, that is the names of this log and its ancestors as a single string.
+ * Format a message in the configured layout, with its body written by a given function, and pass
+ * it to the targets of a log, or to the background thread.  Errors are reported with post_error.
+ */
+void log_message
+(
+    struct ll_log   *log,       ///< Log handle.
+    enum ll_level    level,     ///< Level of log message.
+#if LL_LOCATION
+    const char      *source,    ///< Source file of log statement.
+    unsigned int     line,      ///< Source line number of log statement.
+#endif /* end LL_LOCATION */
+    body_writer      body,      ///< Function to write the message body.
+    void            *context    ///< Context passed to the body function.
+);
+
+/**
+ * Get the path of the log, that is the names of this log and its ancestors as a single string.  The
+ * path is cached in the log the first time it is built, if it fits.
  *
  * @return  The number of bytes written or that would be written to the buffer given enough space,
  *          or a negative value on error.
  */
 int get_path
 (
-    const struct ll_log *log,       ///< [in]  Log handle.
+    struct ll_log       *log,       ///< [in]  Log handle.
     char                *buffer,    ///< [out] Buffer to write path to.
     size_t               size       ///< [in]  Buffer size in bytes.
 );
@@ -69,6 +92,71 @@ struct ll_target *get_targets
                             ///<        caller.
 );
 
+/**
+ * Pass a formatted message to each of the targets of a log.
+ */
+void send_to_targets
+(
+    struct ll_log   *log,           ///< Log handle.
+    enum ll_level    level,         ///< Message level.
+    ll_timestamp_t   timestamp,     ///< Time stamp, or zero if time stamps are disabled.
+    const char      *message,       ///< Message text.
+    size_t           length         ///< Message length in bytes, excluding the terminator.
+);
+
+/**
+ * Pass a batch of formatted messages, all written to logs which share their targets, to each of the
+ * targets of a log.
+ */
+void send_batch_to_targets
+(
+    struct ll_log           *log,       ///< Log handle.
+    const struct ll_record  *records,   ///< Messages to send.
+    size_t                   count      ///< Number of messages.
+);
+
+/**
+ * Pass a formatted message to the emergency function of each of the targets of a log, without
+ * taking any lock, as is safe in a signal handler.
+ */
+void emergency_send
+(
+    struct ll_log   *log,           ///< Log handle.
+    const char      *message,       ///< Message text.
+    size_t           length         ///< Message length in bytes, excluding the terminator.
+);
+
+/**
+ * Reserve space for a message in the target of a log, if the log has a single target and it
+ * supports formatting messages directly into its own buffer.
+ *
+ * Only the target itself stays locked until commit_direct; the log which owns it is unlocked again
+ * before returning, so that other threads may log to its other targets while the message is
+ * formatted.
+ *
+ * @return A buffer of LL_MAX_MESSAGE_SIZE bytes, or NULL if the message must be formatted and sent
+ *         in the usual way.
+ */
+char *reserve_direct
+(
+    struct ll_log       *log,       ///< [in]  Log handle.
+    enum ll_level        level,     ///< [in]  Message level, checked against that of the target.
+    struct ll_target   **target     ///< [out] Target the space was reserved in.
+);
+
+/**
+ * Pass a message formatted into space from reserve_direct to its target.
+ */
+void commit_direct
+(
+    struct ll_target    *target,    ///< Target the space was reserved in.
+    enum ll_level        level,     ///< Message level.
+    ll_timestamp_t       timestamp, ///< Time stamp, or zero if time stamps are disabled.
+    char                *message,   ///< Message text.
+    size_t               length     ///< Message length in bytes, excluding the terminator, or zero
+                                    ///< to discard the reserved space.
+);
+
 #if LL_LOCATION
 /**
  * Display an error from the logging system itself.  The message will be written to stderr.
@@ -0,0 +1,541 @@
+/**
+ * @file        emergency.c
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       Emergency output for a process which is about to die.
+ *
+ * Everything here may be called from a signal handler.  Only async-signal-safe system calls are
+ * made, through the emergency functions of the targets, and nothing is locked, since the thread
+ * which crashed may hold any of the mutexes.  Messages are formatted with a small formatter of our
+ * own rather than with stdio.
+ */
+#include "ll_emergency.h"
+
+#include "async.h"
+#include "common.h"
+#include "timestamp.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+
+#if HAVE_SIGACTION
+#   include <errno.h>
+#   include <signal.h>
+#endif
+
+/// Output of the formatter.
+struct output
+{
+    char    *buffer;    ///< Buffer to write into.
+    size_t   size;      ///< Size of the buffer, in bytes.
+    size_t   length;    ///< Number of characters produced so far, whether or not they fit.
+};
+
+/// Append a character to the output, if it fits with a terminator.
+static void put(struct output *out, char c)
+{
+    if (out->length + 1 < out->size)
+    {
+        out->buffer[out->length] = c;
+    }
+    ++out->length;
+}
+
+/// Append a field to the output, padded to a width.
+static void put_field
+(
+    struct output   *out,       ///< [in,out] Output.
+    const char      *text,      ///< [in]     Field text.
+    size_t           length,    ///< [in]     Length of the text.
+    size_t           width,     ///< [in]     Minimum field width.
+    int              left,      ///< [in]     Non-zero to pad on the right.
+    char             pad        ///< [in]     Padding character.
+)
+{
+    size_t i;
+
+    // Zero padding goes after any sign.
+    if (pad == '0' && length > 0 && text[0] == '-')
+    {
+        put(out, *text++);
+        --length;
+        width = (width > 0) ? width - 1 : 0;
+    }
+    for (i = length; !left && i < width; ++i)
+    {
+        put(out, pad);
+    }
+    for (i = 0; i < length; ++i)
+    {
+        put(out, text[i]);
+    }
+    for (i = length; left && i < width; ++i)
+    {
+        put(out, ' ');
+    }
+}
+
+/**
+ * Convert an unsigned number to text, ending at the end of a buffer.
+ *
+ * @return Start of the text.
+ */
+static char *convert_number
+(
+    char                *end,       ///< [in] End of the buffer.
+    unsigned long long   value,     ///< [in] Value to convert.
+    unsigned int         base,      ///< [in] 10 or 16.
+    const char          *digits     ///< [in] Digit characters.
+)
+{
+    do
+    {
+        *--end = digits[value % base];
+        value /= base;
+    } while (value != 0);
+
+    return end;
+}
+
+/// Format text into a buffer using a variable argument list, as is safe in a signal handler.
+int ll_safe_vformat(char *buffer, size_t size, const char *format, va_list args)
+{
+    struct output        out;
+    const char          *start;
+    const char          *text;
+    char                 number[24];
+    char                *digits;
+    char                 c;
+    unsigned long long   value;
+    size_t               width;
+    size_t               precision;
+    size_t               length;
+    int                  left;
+    int                  longs;
+    int                  sized;
+    int                  negative;
+    char                 pad;
+
+    assert(buffer != NULL || size == 0);
+    assert(format != NULL);
+
+    out.buffer  = buffer;
+    out.size    = size;
+    out.length  = 0;
+
+    while ((c = *format++) != '\0')
+    {
+        if (c != '%')
+        {
+            put(&out, c);
+            continue;
+        }
+
+        // Flags, width, precision, and length modifiers.
+        start       = format - 1;
+        left        = 0;
+        pad         = ' ';
+        width       = 0;
+        precision   = (size_t) -1;
+        longs       = 0;
+        sized       = 0;
+        for (;; ++format)
+        {
+            if (*format == '-')
+            {
+                left = 1;
+            }
+            else if (*format == '0')
+            {
+                pad = '0';
+            }
+            else
+            {
+                break;
+            }
+        }
+        if (*format == '*')
+        {
+            int n = va_arg(args, int);
+
+            ++format;
+            if (n < 0)
+            {
+                left = 1;
+                n = -n;
+            }
+            width = (size_t) n;
+        }
+        while (*format >= '0' && *format <= '9')
+        {
+            width = width * 10U + (size_t) (*format++ - '0');
+        }
+        if (*format == '.')
+        {
+            precision = 0;
+            if (*++format == '*')
+            {
+                int n = va_arg(args, int);
+
+                ++format;
+                precision = (n >= 0) ? (size_t) n : (size_t) -1;
+            }
+            while (*format >= '0' && *format <= '9')
+            {
+                precision = precision * 10U + (size_t) (*format++ - '0');
+            }
+        }
+        for (;; ++format)
+        {
+            if (*format == 'l')
+            {
+                ++longs;
+            }
+            else if (*format == 'z')
+            {
+                sized = 1;
+            }
+            else if (*format != 'h')
+            {
+                break;
+            }
+        }
+        if (left)
+        {
+            pad = ' ';
+        }
+
+        // Conversion.
+        negative = 0;
+        switch (c = *format++)
+        {
+        case '%':
+            put(&out, '%');
+            break;
+
+        case 'c':
+            number[0] = (char) va_arg(args, int);
+            put_field(&out, number, 1, width, left, ' ');
+            break;
+
+        case 's':
+            text = va_arg(args, const char *);
+            if (text == NULL)
+            {
+                text = "(null)";
+            }
+            for (length = 0; length < precision && text[length] != '\0'; ++length)
+            {
+            }
+            put_field(&out, text, length, width, left, ' ');
+            break;
+
+        case 'd':
+        case 'i':
+            {
+                long long n;
+
+                if (sized)
+                {
+                    n = (long long) va_arg(args, ptrdiff_t);
+                }
+                else if (longs >= 2)
+                {
+                    n = va_arg(args, long long);
+                }
+                else if (longs == 1)
+                {
+                    n = va_arg(args, long);
+                }
+                else
+                {
+                    n = va_arg(args, int);
+                }
+                negative = (n < 0);
+                value = negative ? 0U - (unsigned long long) n : (unsigned long long) n;
+            }
+            digits = convert_number(number + sizeof(number), value, 10, "0123456789");
+            if (negative)
+            {
+                *--digits = '-';
+            }
+            put_field(&out, digits, (size_t) (number + sizeof(number) - digits), width, left, pad);
+            break;
+
+        case 'u':
+        case 'x':
+        case 'X':
+            if (sized)
+            {
+                value = va_arg(args, size_t);
+            }
+            else if (longs >= 2)
+            {
+                value = va_arg(args, unsigned long long);
+            }
+            else if (longs == 1)
+            {
+                value = va_arg(args, unsigned long);
+            }
+            else
+            {
+                value = va_arg(args, unsigned int);
+            }
+            digits = convert_number(number + sizeof(number),
+                                    value,
+                                    (c == 'u') ? 10 : 16,
+                                    (c == 'X') ? "0123456789ABCDEF" : "0123456789abcdef");
+            put_field(&out, digits, (size_t) (number + sizeof(number) - digits), width, left, pad);
+            break;
+
+        case 'p':
+            value = (unsigned long long) (uintptr_t) va_arg(args, void *);
+            digits = convert_number(number + sizeof(number), value, 16, "0123456789abcdef");
+            *--digits = 'x';
+            *--digits = '0';
+            put_field(&out, digits, (size_t) (number + sizeof(number) - digits), width, left, ' ');
+            break;
+
+        default:
+            // Unsupported, so copy the conversion as it is.
+            if (c == '\0')
+            {
+                --format;
+            }
+            while (start != format)
+            {
+                put(&out, *start++);
+            }
+            break;
+        }
+    }
+
+    if (size > 0)
+    {
+        buffer[(out.length < size) ? out.length : size - 1] = '\0';
+    }
+
+    return (int) out.length;
+}
+
+/// Format text into a buffer like snprintf(), as is safe in a signal handler.
+int ll_safe_format(char *buffer, size_t size, const char *format, ...)
+{
+    va_list args;
+    int     n;
+
+    va_start(args, format);
+    n = ll_safe_vformat(buffer, size, format, args);
+    va_end(args);
+
+    return n;
+}
+
+/// Write out the messages waiting in the queue, then a message and the buffers of a target list.
+static void flush_targets(struct ll_target *targets, const char *message, size_t length)
+{
+#if LL_ASYNC
+    async_emergency();
+#endif
+    for (; targets != NULL; targets = targets->next)
+    {
+        if (targets->emergency != NULL)
+        {
+            targets->emergency(targets, message, length);
+        }
+    }
+}
+
+/// Write out the messages waiting in the queue and held buffered by a list of targets.
+void ll_emergency_flush(struct ll_target *targets)
+{
+    flush_targets(targets, NULL, 0);
+}
+
+#if !LL_COMPACT
+/**
+ * Write the standard message preamble, "[time stamp ]LEVL ", into a buffer.
+ *
+ * @return The length of the preamble.
+ */
+static size_t write_preamble
+(
+    char            *buffer,    ///< [out] Buffer of LL_MAX_MESSAGE_SIZE bytes.
+    enum ll_level    level      ///< [in]  Message level.
+)
+{
+    size_t length = 0;
+
+#   if LL_TIMESTAMP
+    ll_timestamp_t timestamp;
+
+    LL_GET_TIME(&timestamp);
+    format_timestamp_safe(buffer, LL_CLOCK_TO_TIMESTAMP_SAFE(timestamp));
+    buffer[TIMESTAMP_LENGTH] = ' ';
+    length = TIMESTAMP_LENGTH + 1;
+#   endif /* end LL_TIMESTAMP */
+
+    return length + (size_t) ll_safe_format(buffer + length, LL_MAX_MESSAGE_SIZE - length, "%5s ",
+                                            LL_LEVEL_NAME(level));
+}
+
+/**
+ * Write the path of a log into a buffer without using the path cache or stdio.
+ *
+ * @return The length the path would have given enough space.
+ */
+static size_t write_path(struct ll_log *log, char *buffer, size_t size)
+{
+    size_t length = 0;
+
+    if (log->parent != NULL)
+    {
+        length = write_path(log->parent, buffer, size);
+        length += (size_t) ll_safe_format(buffer + ((length < size) ? length : size),
+                                          (length < size) ? size - length : 0, ".");
+    }
+    return length + (size_t) ll_safe_format(buffer + ((length < size) ? length : size),
+                                            (length < size) ? size - length : 0, "%s", log->name);
+}
+
+/// Write a message to the targets of a log, as is safe in a signal handler.
+void ll_emergency_log(struct ll_log *log, enum ll_level level, const char *format, ...)
+{
+    char    buffer[LL_MAX_MESSAGE_SIZE];
+    size_t  length;
+    va_list args;
+
+    assert(log != NULL);
+    assert(format != NULL);
+
+    length = write_preamble(buffer, level);
+    length += write_path(log, buffer + length, sizeof(buffer) - length);
+    if (length + 2 < sizeof(buffer))
+    {
+        buffer[length++] = ':';
+        buffer[length++] = ' ';
+        va_start(args, format);
+        length += (size_t) ll_safe_vformat(buffer + length, sizeof(buffer) - length, format, args);
+        va_end(args);
+    }
+    if (length >= sizeof(buffer))
+    {
+        length = sizeof(buffer) - 1;
+    }
+
+    emergency_send(log, buffer, length);
+}
+#endif /* end !LL_COMPACT */
+
+#if HAVE_SIGACTION
+/// Signals caught by the crash handler.
+static const int signals[] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT };
+
+/// Number of signals caught by the crash handler.
+#   define SIGNAL_COUNT (sizeof(signals) / sizeof(signals[0]))
+
+/// Targets to flush from the crash handler.
+static struct ll_target *volatile   crash_targets;
+/// Handlers in place before the crash handler was installed.
+static struct sigaction             previous[SIGNAL_COUNT];
+/// Non-zero once the crash handler has been installed.
+static int                          installed;
+/// Non-zero once the crash handler has run, so that a crash inside it is not handled again.
+static volatile sig_atomic_t        crashing;
+
+#   if HAVE_SIGALTSTACK
+/// Alternate stack for the crash handler, so that it can run after a stack overflow.
+static char                         crash_stack[LL_EMERGENCY_STACK_SIZE];
+#   endif
+
+/// Crash handler.  Writes out buffered messages, then lets the previous handler deal with the
+/// signal.
+static void crash(int sig)
+{
+    int     saved = errno;
+    size_t  i;
+
+    if (!crashing)
+    {
+        crashing = 1;
+#   if !LL_COMPACT
+        {
+            char    message[LL_MAX_MESSAGE_SIZE];
+            size_t  length = write_preamble(message, LL_LEVEL_FATAL);
+
+            length += (size_t) ll_safe_format(message + length, sizeof(message) - length,
+                                              "Fatal signal %d", sig);
+            flush_targets(crash_targets, message, length);
+        }
+#   else /* LL_COMPACT */
+        flush_targets(crash_targets, NULL, 0);
+#   endif /* end LL_COMPACT */
+    }
+
+    for (i = 0; i < SIGNAL_COUNT; ++i)
+    {
+        if (signals[i] == sig)
+        {
+            sigaction(sig, &previous[i], NULL);
+        }
+    }
+    errno = saved;
+    raise(sig);
+}
+
+/// Install a handler for fatal signals which writes out buffered messages.
+int ll_emergency_install(struct ll_target *targets)
+{
+    struct sigaction    action;
+    size_t              i;
+
+    crash_targets = targets;
+    if (installed)
+    {
+        return 0;
+    }
+
+#   if HAVE_SIGALTSTACK
+    {
+        stack_t stack;
+
+        stack.ss_sp     = crash_stack;
+        stack.ss_size   = sizeof(crash_stack);
+        stack.ss_flags  = 0;
+        sigaltstack(&stack, NULL);
+    }
+#   endif /* end HAVE_SIGALTSTACK */
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = &crash;
+    action.sa_flags = 0;
+#   if HAVE_SIGALTSTACK
+    action.sa_flags |= SA_ONSTACK;
+#   endif
+    sigemptyset(&action.sa_mask);
+    for (i = 0; i < SIGNAL_COUNT; ++i)
+    {
+        if (sigaction(signals[i], &action, &previous[i]) != 0)
+        {
+            while (i-- > 0)
+            {
+                sigaction(signals[i], &previous[i], NULL);
+            }
+            return -1;
+        }
+    }
+    installed = 1;
+
+    return 0;
+}
+#else /* !HAVE_SIGACTION */
+/// Signal handlers are not supported.
+int ll_emergency_install(struct ll_target *targets)
+{
+    LL_UNUSED(targets);
+    return -1;
+}
+#endif /* end !HAVE_SIGACTION */
@@ -0,0 +1,169 @@
+/**
+ * @file        json.c
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       JSON string escaping.
+ *
+ * Most message text has nothing to escape, so the work is in finding the first character which
+ * must be escaped.  Where the compiler targets AVX2 or SSE2, 32 or 16 bytes are checked at a time
+ * by comparing them against the quote, the backslash, and the range of control characters, and
+ * the tail is checked one byte at a time.
+ */
+#include "json.h"
+
+#include <assert.h>
+#include <string.h>
+
+#if (__GNUC__ || __clang__) && (__SSE2__ || __AVX2__)
+#   include <immintrin.h>
+#endif
+
+/// Scan with 32 byte vectors.
+#define VECTOR_AVX2 ((__GNUC__ || __clang__) && __AVX2__)
+
+/// Scan with 16 byte vectors.
+#define VECTOR_SSE2 ((__GNUC__ || __clang__) && __SSE2__)
+
+/// Find the first character of a text which must be escaped in a JSON string.
+size_t json_find_escape(const char *text, size_t length)
+{
+    size_t i = 0;
+
+    assert(text != NULL || length == 0);
+
+#if VECTOR_AVX2
+    {
+        const __m256i control   = _mm256_set1_epi8(0x1F);
+        const __m256i quote     = _mm256_set1_epi8('"');
+        const __m256i backslash = _mm256_set1_epi8('\\');
+
+        for (; i + 32 <= length; i += 32)
+        {
+            __m256i     v = _mm256_loadu_si256((const __m256i *) (const void *) (text + i));
+            __m256i     hit;
+            uint32_t    mask;
+
+            // A byte is a control character if it is unchanged by taking the unsigned minimum
+            // with 0x1F.
+            hit = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(v, control), v),
+                                  _mm256_or_si256(_mm256_cmpeq_epi8(v, quote),
+                                                  _mm256_cmpeq_epi8(v, backslash)));
+            mask = (uint32_t) _mm256_movemask_epi8(hit);
+            if (mask != 0)
+            {
+                return i + (size_t) __builtin_ctz(mask);
+            }
+        }
+    }
+#endif /* end VECTOR_AVX2 */
+#if VECTOR_SSE2
+    {
+        const __m128i control   = _mm_set1_epi8(0x1F);
+        const __m128i quote     = _mm_set1_epi8('"');
+        const __m128i backslash = _mm_set1_epi8('\\');
+
+        for (; i + 16 <= length; i += 16)
+        {
+            __m128i     v = _mm_loadu_si128((const __m128i *) (const void *) (text + i));
+            __m128i     hit;
+            uint32_t    mask;
+
+            hit = _mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(v, control), v),
+                               _mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                                            _mm_cmpeq_epi8(v, backslash)));
+            mask = (uint32_t) _mm_movemask_epi8(hit);
+            if (mask != 0)
+            {
+                return i + (size_t) __builtin_ctz(mask);
+            }
+        }
+    }
+#endif /* end VECTOR_SSE2 */
+
+    while (i < length && !JSON_NEEDS_ESCAPE(text[i]))
+    {
+        ++i;
+    }
+    return i;
+}
+
+/// Write the escape sequence of a character which must be escaped in a JSON string.
+size_t json_escape_char(char c, char *escape)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    escape[0] = '\\';
+    switch (c)
+    {
+        case '"':   escape[1] = '"';    return 2;
+        case '\\':  escape[1] = '\\';   return 2;
+        case '\b':  escape[1] = 'b';    return 2;
+        case '\f':  escape[1] = 'f';    return 2;
+        case '\n':  escape[1] = 'n';    return 2;
+        case '\r':  escape[1] = 'r';    return 2;
+        case '\t':  escape[1] = 't';    return 2;
+        default:
+            escape[1] = 'u';
+            escape[2] = '0';
+            escape[3] = '0';
+            escape[4] = hex[(unsigned char) c >> 4];
+            escape[5] = hex[(unsigned char) c & 0x0F];
+            return JSON_ESCAPE_MAX;
+    }
+}
+
+/// Escape a text in place, for use inside a JSON string.
+const char *json_escape_in_place(char *text, size_t *length, size_t size)
+{
+    char    escape[JSON_ESCAPE_MAX];
+    size_t  first;
+    size_t  extra = 0;
+    size_t  source;
+    size_t  dest;
+    size_t  n;
+
+    assert(text != NULL);
+    assert(length != NULL);
+
+    first = json_find_escape(text, *length);
+    if (first == *length)
+    {
+        return NULL;
+    }
+
+    // Work out how much the text grows, then expand it from the end so that nothing is overwritten
+    // before it is read.
+    source = first;
+    while (source < *length)
+    {
+        extra += json_escape_char(text[source], escape) - 1;
+        ++source;
+        source += json_find_escape(text + source, *length - source);
+    }
+    if (*length + extra > size)
+    {
+        return "Message too long!";
+    }
+
+    source  = *length;
+    dest    = *length + extra;
+    while (source > first)
+    {
+        --source;
+        if (JSON_NEEDS_ESCAPE(text[source]))
+        {
+            n = json_escape_char(text[source], escape);
+            dest -= n;
+            memcpy(text + dest, escape, n);
+        }
+        else
+        {
+            text[--dest] = text[source];
+        }
+    }
+
+    *length += extra;
+    return NULL;
+}
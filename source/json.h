@@ -0,0 +1,66 @@
+/**
+ * @file        json.h
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       JSON string escaping.
+ */
+#ifndef JSON_H_
+#define JSON_H_
+
+#include "ll_internal.h"
+
+#include <stddef.h>
+
+/**
+ * Check whether a character must be escaped in a JSON string.
+ *
+ * @param   c   Character.
+ */
+#define JSON_NEEDS_ESCAPE(c) ((unsigned char) (c) < 0x20 || (c) == '"' || (c) == '\\')
+
+/// Longest escape sequence of a character, such as "\\u001f", in bytes.
+#define JSON_ESCAPE_MAX 6
+
+/**
+ * Write the escape sequence of a character which must be escaped in a JSON string.  The short
+ * forms are used where JSON has them.
+ *
+ * @return The length of the escape sequence, which is not terminated.
+ */
+size_t json_escape_char
+(
+    char             c,         ///< [in]  Character to escape.
+    char            *escape     ///< [out] Buffer of at least JSON_ESCAPE_MAX bytes.
+);
+
+/**
+ * Find the first character of a text which must be escaped in a JSON string.  The text is scanned
+ * with SSE2 or AVX2 where the compiler targets them.
+ *
+ * @return The offset of the first such character, or length if there is none.
+ */
+size_t json_find_escape
+(
+    const char      *text,      ///< [in] Text to scan.  Need not be terminated.
+    size_t           length     ///< [in] Length of the text in bytes.
+);
+
+/**
+ * Escape a text in place, for use inside a JSON string.  Control characters, quotes and
+ * backslashes are escaped, and all other bytes are left as they are, so UTF-8 passes through.  Text
+ * without any character to escape, the common case, is only scanned.
+ *
+ * @retval  NULL        Operation was successful.
+ * @retval  non-NULL    An error occured.  The returned value is a constant string describing the
+ *                      error.
+ */
+const char *json_escape_in_place
+(
+    char            *text,      ///< [in,out] Text to escape.
+    size_t          *length,    ///< [in,out] Length of the text in bytes, before and after.
+    size_t           size       ///< [in]     Size of the buffer holding the text, in bytes.
+);
+
+#endif /* end JSON_H_ */
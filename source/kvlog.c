@@ -0,0 +1,495 @@
+/**
+ * @file        kvlog.c
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       Log function implementation for structured key-value log statements.
+ *
+ * A structured message has the usual preamble and a plain message text, followed by its fields in
+ * the layout selected by LL_KV_FORMAT.  With LL_KV_LOGFMT and LL_KV_JSON the fields are rendered as
+ * text, with strings quoted and escaped as needed and non-finite numbers written as null in JSON.
+ * logfmt cannot quote field names, so a message with a name which is empty or holds a space, '=',
+ * '"', a backslash or a control character is rejected.  With LL_KV_BINARY the message text is
+ * followed by a space and the fields in the byte order of the host, base64 encoded so that the
+ * message stays a single line of text.  Before encoding they are laid out as follows.
+ * @code{.unparsed}
+ * size    field
+ * 1       Flags.  Bit 0 is set if the fields are big-endian.
+ * 1       Number of fields.
+ * ...     Fields, each made up of:
+ *   1     Field type, from enum ll_kv_type.
+ *   1     Key length in bytes.
+ *   ...   Key, without a terminator.
+ *   ...   Value: 8 bytes for an integer or double, 1 byte for a boolean, or for a string a 2 byte
+ *         length followed by the text without a terminator.  A NULL string has length 0xFFFF.
+ * @endcode
+ *
+ * Only floating point fields rendered as text go through printf.
+ */
+#include "ll_log.h"
+
+#include "common.h"
+#include "json.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !LL_COMPACT
+
+#   if LL_KV_FORMAT != LL_KV_LOGFMT && LL_KV_FORMAT != LL_KV_JSON && LL_KV_FORMAT != LL_KV_BINARY
+#       error Unknown key-value field format!
+#   endif
+
+#   if LL_JSON_FORMAT && LL_KV_FORMAT == LL_KV_BINARY
+#       error Binary key-value fields cannot be written in JSON messages!
+#   endif
+
+/// Fields flag indicating big-endian byte order.
+#   define FLAG_BIG_ENDIAN 0x01
+
+/// Length written for a NULL string in the binary encoding.
+#   define NULL_STRING     0xFFFFU
+
+#   if LL_KV_FORMAT == LL_KV_BINARY
+/// Digits of the base64 encoding the binary fields are written in.
+static const char base64_digits[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+#   endif
+
+/// Message text and fields of a structured message, for write_fields.
+struct structured
+{
+    const char          *message;   ///< Message text.
+    const struct ll_kv  *fields;    ///< Fields of the message.
+    size_t               count;     ///< Number of fields.
+};
+
+/// Output position in a message buffer.
+struct output
+{
+    char        *next;      ///< Next free byte.
+    size_t       space;     ///< Bytes left, including room for the terminator.
+    const char  *err;       ///< First error met, or NULL.  Nothing more is written after an error.
+#   if LL_KV_FORMAT == LL_KV_BINARY
+    uint8_t      held[3];   ///< Bytes waiting to be base64 encoded as a group.
+    size_t       count;     ///< Number of bytes held.
+#   endif
+};
+
+/// Append bytes to the output, keeping room for a terminator.
+static void put(struct output *out, const void *data, size_t n)
+{
+    if (out->err != NULL)
+    {
+        return;
+    }
+    if (n >= out->space)
+    {
+        out->err = "Message too long!";
+        return;
+    }
+
+    memcpy(out->next, data, n);
+    out->next += n;
+    out->space -= n;
+}
+
+/// Append a string to the output.
+static void put_string(struct output *out, const char *string)
+{
+    put(out, string, strlen(string));
+}
+
+#if LL_KV_FORMAT != LL_KV_BINARY
+/// Append an unsigned integer to the output in decimal.
+static void put_decimal(struct output *out, uint64_t value)
+{
+    char    digits[20];
+    size_t  n = sizeof(digits);
+
+    do
+    {
+        digits[--n] = (char) ('0' + value % 10U);
+        value /= 10U;
+    } while (value != 0);
+
+    put(out, digits + n, sizeof(digits) - n);
+}
+
+/// Append a signed integer to the output in decimal.
+static void put_signed(struct output *out, int64_t value)
+{
+    if (value < 0)
+    {
+        put(out, "-", 1);
+        // Negate as unsigned, which is well defined for the most negative value too.
+        put_decimal(out, 0U - (uint64_t) value);
+    }
+    else
+    {
+        put_decimal(out, (uint64_t) value);
+    }
+}
+
+/// Append a floating point number to the output, with 15 significant digits, or 17 if those do not
+/// read back exactly.
+static void put_double(struct output *out, double value)
+{
+    char    text[32];
+    int     n;
+
+    if (!isfinite(value))
+    {
+#   if LL_KV_FORMAT == LL_KV_JSON
+        put_string(out, "null");
+#   else /* !(LL_KV_FORMAT == LL_KV_JSON) */
+        put_string(out, isnan(value) ? "NaN" : (value < 0) ? "-Inf" : "+Inf");
+#   endif /* end !(LL_KV_FORMAT == LL_KV_JSON) */
+        return;
+    }
+
+    n = snprintf(text, sizeof(text), "%.15g", value);
+    if (strtod(text, NULL) != value)
+    {
+        n = snprintf(text, sizeof(text), "%.17g", value);
+    }
+    if (n < 0 || n >= (int) sizeof(text))
+    {
+        out->err = "Invalid field value!";
+        return;
+    }
+    put(out, text, (size_t) n);
+}
+
+/// Append a string to the output in double quotes, escaping it as JSON does.
+static void put_quoted(struct output *out, const char *string)
+{
+    char    escape[JSON_ESCAPE_MAX];
+    size_t  length = strlen(string);
+    size_t  n;
+
+    put(out, "\"", 1);
+    while (length > 0)
+    {
+        // Copy runs of plain characters in one go.
+        n = json_find_escape(string, length);
+        put(out, string, n);
+        if (n == length)
+        {
+            break;
+        }
+
+        put(out, escape, json_escape_char(string[n], escape));
+        string += n + 1;
+        length -= n + 1;
+    }
+    put(out, "\"", 1);
+}
+
+/// Append a field value to the output as text.
+static void put_value(struct output *out, const struct ll_kv *field)
+{
+    switch (field->type)
+    {
+        case LL_KV_TYPE_INT:
+            put_signed(out, field->value.i);
+            break;
+
+        case LL_KV_TYPE_UINT:
+            put_decimal(out, field->value.u);
+            break;
+
+        case LL_KV_TYPE_FLOAT:
+            put_double(out, field->value.f);
+            break;
+
+        case LL_KV_TYPE_BOOL:
+            put_string(out, field->value.u ? "true" : "false");
+            break;
+
+        case LL_KV_TYPE_STR:
+            if (field->value.s == NULL)
+            {
+                put_string(out, "null");
+            }
+#   if LL_KV_FORMAT == LL_KV_LOGFMT
+            else if (field->value.s[0] != '\0' && strpbrk(field->value.s, " =\"\\") == NULL &&
+                     strcmp(field->value.s, "null") != 0)
+            {
+                const char *c;
+
+                // Leave the value bare unless it holds a control character.
+                c = field->value.s;
+                while (*c != '\0' && (unsigned char) *c >= 0x20)
+                {
+                    ++c;
+                }
+                if (*c == '\0')
+                {
+                    put(out, field->value.s, (size_t) (c - field->value.s));
+                }
+                else
+                {
+                    put_quoted(out, field->value.s);
+                }
+            }
+#   endif /* end LL_KV_FORMAT == LL_KV_LOGFMT */
+            else
+            {
+                put_quoted(out, field->value.s);
+            }
+            break;
+
+        default:
+            out->err = "Invalid field type!";
+            break;
+    }
+}
+#endif /* end LL_KV_FORMAT != LL_KV_BINARY */
+
+#if LL_KV_FORMAT == LL_KV_LOGFMT
+/// Check that a field name can be written bare in a logfmt pair.
+static int valid_key(const char *key)
+{
+    const char *c;
+
+    for (c = key; *c != '\0'; ++c)
+    {
+        if ((unsigned char) *c <= 0x20 || *c == 0x7F || strchr("=\"\\", *c) != NULL)
+        {
+            return 0;
+        }
+    }
+    return c != key;
+}
+
+/// Append the fields to the output as logfmt pairs.
+static void put_fields(struct output *out, const struct ll_kv *fields, size_t count)
+{
+    size_t i;
+
+    for (i = 0; i < count; ++i)
+    {
+        if (!valid_key(fields[i].key))
+        {
+            out->err = "Invalid field name!";
+            return;
+        }
+        put(out, " ", 1);
+        put_string(out, fields[i].key);
+        put(out, "=", 1);
+        put_value(out, &fields[i]);
+    }
+}
+#elif LL_KV_FORMAT == LL_KV_JSON
+/// Append the fields to the output as a JSON object.
+static void put_fields(struct output *out, const struct ll_kv *fields, size_t count)
+{
+    size_t i;
+
+    put(out, " {", 2);
+    for (i = 0; i < count; ++i)
+    {
+        if (i > 0)
+        {
+            put(out, ",", 1);
+        }
+        put_quoted(out, fields[i].key);
+        put(out, ":", 1);
+        put_value(out, &fields[i]);
+    }
+    put(out, "}", 1);
+}
+#else /* LL_KV_FORMAT == LL_KV_BINARY */
+/// Append a group of one to three bytes to the output in base64, padded to four digits.
+static void put_group(struct output *out, const uint8_t *bytes, size_t n)
+{
+    uint32_t    bits = (uint32_t) bytes[0] << 16;
+    char        digits[4];
+
+    if (n > 1)
+    {
+        bits |= (uint32_t) bytes[1] << 8;
+    }
+    if (n > 2)
+    {
+        bits |= bytes[2];
+    }
+
+    digits[0] = base64_digits[bits >> 18];
+    digits[1] = base64_digits[(bits >> 12) & 0x3FU];
+    digits[2] = (n > 1) ? base64_digits[(bits >> 6) & 0x3FU] : '=';
+    digits[3] = (n > 2) ? base64_digits[bits & 0x3FU] : '=';
+    put(out, digits, sizeof(digits));
+}
+
+/// Append bytes to the output in base64.  Up to two bytes are held until more follow, or until
+/// put_encoded_end.
+static void put_encoded(struct output *out, const void *data, size_t n)
+{
+    const uint8_t *bytes = data;
+
+    for (; n > 0; --n)
+    {
+        out->held[out->count++] = *bytes++;
+        if (out->count == sizeof(out->held))
+        {
+            put_group(out, out->held, out->count);
+            out->count = 0;
+        }
+    }
+}
+
+/// Append the bytes held back by put_encoded to the output.
+static void put_encoded_end(struct output *out)
+{
+    if (out->count > 0)
+    {
+        put_group(out, out->held, out->count);
+        out->count = 0;
+    }
+}
+
+/// Append the fields to the output in their binary encoding, in base64.
+static void put_fields(struct output *out, const struct ll_kv *fields, size_t count)
+{
+    const uint16_t  one = 1;
+    uint8_t         byte;
+    uint16_t        length;
+    size_t          n;
+    size_t          i;
+
+    if (count > UINT8_MAX)
+    {
+        out->err = "Too many fields!";
+        return;
+    }
+
+    // A space separates the message text from the fields, which never hold one once encoded.
+    put(out, " ", 1);
+    byte = (*(const uint8_t *) &one == 0) ? FLAG_BIG_ENDIAN : 0;
+    put_encoded(out, &byte, 1);
+    byte = (uint8_t) count;
+    put_encoded(out, &byte, 1);
+
+    for (i = 0; i < count; ++i)
+    {
+        n = strlen(fields[i].key);
+        if (n > UINT8_MAX)
+        {
+            out->err = "Field name too long!";
+            return;
+        }
+        byte = (uint8_t) fields[i].type;
+        put_encoded(out, &byte, 1);
+        byte = (uint8_t) n;
+        put_encoded(out, &byte, 1);
+        put_encoded(out, fields[i].key, n);
+
+        switch (fields[i].type)
+        {
+            case LL_KV_TYPE_INT:
+            case LL_KV_TYPE_UINT:
+            case LL_KV_TYPE_FLOAT:
+                put_encoded(out, &fields[i].value, 8);
+                break;
+
+            case LL_KV_TYPE_BOOL:
+                byte = (uint8_t) fields[i].value.u;
+                put_encoded(out, &byte, 1);
+                break;
+
+            case LL_KV_TYPE_STR:
+                n = (fields[i].value.s != NULL) ? strlen(fields[i].value.s) : 0;
+                if (n >= NULL_STRING)
+                {
+                    out->err = "Message too long!";
+                    return;
+                }
+                length = (fields[i].value.s != NULL) ? (uint16_t) n : (uint16_t) NULL_STRING;
+                put_encoded(out, &length, sizeof(length));
+                put_encoded(out, fields[i].value.s, n);
+                break;
+
+            default:
+                out->err = "Invalid field type!";
+                return;
+        }
+    }
+    put_encoded_end(out);
+}
+#endif /* end LL_KV_FORMAT == LL_KV_BINARY */
+
+/**
+ * Write the body of a structured message: its text followed by its fields.
+ *
+ * @retval  NULL        Operation was successful and the body was written to the buffer.
+ * @retval  non-NULL    An error occured.  The returned value is a constant string describing the
+ *                      error.
+ */
+static const char *write_fields
+(
+    char            *buffer,    ///< [out]    Buffer to write the body into.
+    size_t          *space,     ///< [in,out] Available space remaining in the buffer.
+    void            *context    ///< [in]     Pointer to a struct structured.
+)
+{
+    const struct structured *structured = context;
+    struct output            out;
+
+    out.next    = buffer;
+    out.space   = *space;
+    out.err     = NULL;
+#if LL_KV_FORMAT == LL_KV_BINARY
+    out.count   = 0;
+#endif
+
+    put_string(&out, structured->message);
+    put_fields(&out, structured->fields, structured->count);
+    if (out.err != NULL)
+    {
+        return out.err;
+    }
+
+    *out.next = '\0';
+    *space = out.space;
+    return NULL;
+}
+
+/// Unconditionally log a structured message.
+void _ll_log_kv
+(
+    struct ll_log       *log,
+    enum ll_level        level,
+#if LL_LOCATION
+    const char          *source,
+    unsigned int         line,
+#endif /* end LL_LOCATION */
+    const char          *message,
+    const struct ll_kv  *fields,
+    size_t               count
+)
+{
+    struct structured structured;
+
+    assert(message != NULL);
+    assert(fields != NULL || count == 0);
+
+    structured.message  = message;
+    structured.fields   = fields;
+    structured.count    = count;
+    log_message(log,
+                level,
+#if LL_LOCATION
+                source,
+                line,
+#endif /* end LL_LOCATION */
+                &write_fields,
+                &structured);
+}
+
+#endif /* end !LL_COMPACT */
@@ -0,0 +1,196 @@
+/**
+ * @file        layout.c
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       Message layout programs, compiled from the patterns given to ll_set_layout.
+ *
+ * A pattern is parsed once into a short array of instructions, with the literal text between the
+ * specifiers gathered into a pool, so that formatting a message is a loop which copies literals and
+ * calls a writer for each field.  Two programs are kept, so that a new one is compiled while
+ * messages are still being formatted with the old one, and then published in a single store.
+ */
+#include "ll_log.h"
+
+#include "common.h"
+#include "layout.h"
+
+#include <assert.h>
+
+#if LL_CUSTOM_FORMAT
+
+/// Layout programs.  One is in use and the other is compiled into by ll_set_layout.
+static struct layout        layouts[2];
+/// Index of the program in use plus one, or zero before any program is compiled.
+static volatile uint32_t    current;
+
+/**
+ * @def LOCK_LAYOUT
+ * Serialize compiling layout programs, if supported.
+ */
+/**
+ * @def UNLOCK_LAYOUT
+ * Release the lock taken by LOCK_LAYOUT, if supported.
+ */
+#   if LL_THREADING
+/// Mutex serializing compiling layout programs.
+static ll_mutex layout_mutex = LL_STATIC_MUTEX_INIT;
+#       define LOCK_LAYOUT()    LL_LOCK(&layout_mutex)
+#       define UNLOCK_LAYOUT()  LL_UNLOCK(&layout_mutex)
+#   else /* !LL_THREADING */
+#       define LOCK_LAYOUT()
+#       define UNLOCK_LAYOUT()
+#   endif /* end !LL_THREADING */
+
+/**
+ * Compile a layout pattern into a program.
+ *
+ * @retval  0   The pattern was compiled.
+ * @retval  -1  The pattern is too long, has an unknown specifier, or has more than one %t.
+ */
+static int compile(struct layout *layout, const char *pattern)
+{
+    struct op  *op = NULL;
+    size_t      used = 0;
+    size_t      width;
+    uint8_t     flags;
+    int         stamps = 0;
+
+    layout->count = 0;
+    while (*pattern != '\0')
+    {
+        if (*pattern != '%' || pattern[1] == '%')
+        {
+            // Extend the literal being built, or start a new one.
+            if (used + 1 >= LL_LAYOUT_SIZE)
+            {
+                return -1;
+            }
+            if (op == NULL || op->code != OP_LITERAL)
+            {
+                if (layout->count >= LL_LAYOUT_SIZE)
+                {
+                    return -1;
+                }
+                op          = &layout->ops[layout->count++];
+                op->code    = OP_LITERAL;
+                op->flags   = 0;
+                op->width   = 0;
+                op->offset  = (uint16_t) used;
+                op->length  = 0;
+            }
+            layout->text[used++] = *pattern;
+            ++op->length;
+            pattern += (*pattern == '%') ? 2 : 1;
+            continue;
+        }
+
+        // Flags and minimum width.
+        ++pattern;
+        flags = 0;
+        if (*pattern == '-')
+        {
+            flags = OP_LEFT;
+            ++pattern;
+        }
+        width = 0;
+        while (*pattern >= '0' && *pattern <= '9')
+        {
+            width = width * 10U + (size_t) (*pattern++ - '0');
+            if (width >= LL_MAX_MESSAGE_SIZE)
+            {
+                return -1;
+            }
+        }
+
+        if (layout->count >= LL_LAYOUT_SIZE)
+        {
+            return -1;
+        }
+        op          = &layout->ops[layout->count++];
+        op->flags   = flags;
+        op->width   = (uint16_t) width;
+        op->offset  = 0;
+        op->length  = 0;
+        switch (*pattern)
+        {
+            case 't':
+                // The time stamp has a fixed width, and is written only once so that an
+                // asynchronous message has a single placeholder.
+                op->code    = OP_TIMESTAMP;
+                op->width   = 0;
+                if (++stamps > 1)
+                {
+                    return -1;
+                }
+                break;
+            case 'L':
+                op->code = OP_LEVEL;
+                break;
+            case 'f':
+                op->code = OP_FILE;
+                break;
+            case 'l':
+                op->code = OP_LINE;
+                break;
+            case 'n':
+                op->code = OP_PATH;
+                break;
+            case 'm':
+                op->code = OP_MESSAGE;
+                break;
+            default:
+                return -1;
+        }
+        ++pattern;
+    }
+
+    return 0;
+}
+
+/// Get the current layout program.
+const struct layout *layout_get(void)
+{
+    uint32_t index = LL_ATOMIC_LOAD_ACQUIRE(&current);
+
+    if (index == 0)
+    {
+        LOCK_LAYOUT();
+        if (LL_ATOMIC_LOAD_RELAXED(&current) == 0)
+        {
+            int result = compile(&layouts[0], LL_DEFAULT_LAYOUT);
+
+            assert(result == 0);
+            LL_UNUSED(result);
+            LL_ATOMIC_STORE_RELEASE(&current, 1U);
+        }
+        UNLOCK_LAYOUT();
+        index = LL_ATOMIC_LOAD_ACQUIRE(&current);
+    }
+
+    return &layouts[index - 1];
+}
+
+/// Set the layout of log messages.
+int ll_set_layout(const char *pattern)
+{
+    uint32_t    next;
+    int         result;
+
+    assert(pattern != NULL);
+
+    LOCK_LAYOUT();
+    // Compile into the program which is not in use.
+    next = (LL_ATOMIC_LOAD_RELAXED(&current) == 1) ? 1U : 0U;
+    result = compile(&layouts[next], pattern);
+    if (result == 0)
+    {
+        LL_ATOMIC_STORE_RELEASE(&current, next + 1U);
+    }
+    UNLOCK_LAYOUT();
+
+    return result;
+}
+
+#endif /* end LL_CUSTOM_FORMAT */
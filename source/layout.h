@@ -0,0 +1,66 @@
+/**
+ * @file        layout.h
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       Message layout programs, compiled from the patterns given to ll_set_layout.
+ */
+#ifndef LAYOUT_H_
+#define LAYOUT_H_
+
+#include "ll_internal.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if LL_CUSTOM_FORMAT
+
+#   if LL_LAYOUT_SIZE < 2 || LL_LAYOUT_SIZE > 65536
+#       error Layout patterns must be limited to between 2 and 65536 bytes!
+#   endif
+
+/// Layout program instructions.
+enum opcode
+{
+    OP_LITERAL,     ///< Copy text from the program's literal pool.
+    OP_TIMESTAMP,   ///< Write the time stamp (%t).
+    OP_LEVEL,       ///< Write the level name (%L).
+    OP_FILE,        ///< Write the source file name (%f).
+    OP_LINE,        ///< Write the source line number (%l).
+    OP_PATH,        ///< Write the log path (%n).
+    OP_MESSAGE      ///< Write the message body (%m).
+};
+
+/// Layout instruction flag to pad the field on the right rather than the left.
+#   define OP_LEFT 0x01
+
+/// Layout program instruction.
+struct op
+{
+    uint8_t     code;       ///< Instruction, from enum opcode.
+    uint8_t     flags;      ///< Instruction flags.
+    uint16_t    width;      ///< Minimum field width, padded with spaces.  Zero for no padding.
+    uint16_t    offset;     ///< Offset of the text of a literal in the pool.
+    uint16_t    length;     ///< Length of the text of a literal.
+};
+
+/// Layout program.  A pattern cannot produce more instructions than it has characters.
+struct layout
+{
+    size_t      count;                  ///< Number of instructions.
+    struct op   ops[LL_LAYOUT_SIZE];    ///< Instructions.
+    char        text[LL_LAYOUT_SIZE];   ///< Literal pool.
+};
+
+/**
+ * Get the current layout program, compiling LL_DEFAULT_LAYOUT the first time if ll_set_layout has
+ * not been called.
+ *
+ * @return The layout program.
+ */
+const struct layout *layout_get(void);
+
+#endif /* end LL_CUSTOM_FORMAT */
+
+#endif /* end LAYOUT_H_ */
@@ -8,10 +8,15 @@
  */
 #include "ll_log.h"
 
+#include "async.h"
 #include "common.h"
+#include "json.h"
+#include "layout.h"
+#include "timestamp.h"
 
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
 
 /**
  * Calculate offset of next free character in buffer.
@@ -22,6 +27,27 @@
  */
 #define OFFSET(space) (LL_MAX_MESSAGE_SIZE - (space))
 
+#if LL_CUSTOM_FORMAT && LL_JSON_FORMAT
+#   error Custom formats and JSON messages cannot be used together!
+#endif
+
+/// Time stamp offset of a message without a time stamp.
+#define NO_STAMP ((size_t) -1)
+
+/// Offset of the time stamp in a message in the standard or JSON layout.
+#if LL_JSON_FORMAT
+#   define STAMP_OFFSET (sizeof("{\"ts\":\"") - 1)
+#else /* !LL_JSON_FORMAT */
+#   define STAMP_OFFSET 0
+#endif /* end !LL_JSON_FORMAT */
+
+/// Format string and positional parameters of a message, for write_formatted.
+struct formatted
+{
+    const char  *format;    ///< Format string.
+    va_list      args;      ///< Positional parameters of the format string.
+};
+
 /// Local implementation if _ll_log is not inlined.
 LL_DEFINE_INLINE void _ll_log
 (
@@ -37,7 +63,8 @@ LL_DEFINE_INLINE void _ll_log
 
 #if LL_TIMESTAMP
 /**
- * Write a formatted timestamp into a buffer.
+ * Write a formatted timestamp into a buffer.  With asynchronous logging, a placeholder is written
+ * instead, and the background thread converts the clock reading and formats the time stamp.
  *
  * @retval  NULL        Operation was successful and the timestamp was written to the buffer.
  * @retval  non-NULL    An error occured.  The returned value is a constant string describing the
@@ -46,36 +73,39 @@ LL_DEFINE_INLINE void _ll_log
 static const char *write_timestamp
 (
     char             *buffer,       ///< [out]    Buffer to write the formatted timestamp into.
-    time_t           *seconds,      ///< [out]    Time since the Epoch, in seconds.
-    unsigned long    *microseconds, ///< [out]    Fraction of a second, in microseconds.
-    size_t           *space         ///< [in,out] Available space remaining in the buffer.
+    ll_timestamp_t   *timestamp,    ///< [out]    Time stamp, or the clock reading if asynchronous.
+    size_t           *space,        ///< [in,out] Available space remaining in the buffer.
+    char              separator     ///< [in]     Character to write after the time stamp, or zero
+                                    ///<              for none.
 )
 {
-    int              n;
-    struct tm        tm;
-    unsigned long    milliseconds;
+    size_t n = TIMESTAMP_LENGTH + ((separator != '\0') ? 1 : 0);
 
     // Obtain the current system time.
-    LL_GET_TIME(seconds, microseconds);
-    if (LL_CONVERT_TIME(*seconds, &tm) < 0)
-    {
-        return "Time conversion overflow!";
-    }
-    milliseconds = *microseconds / 1000U;
+    LL_GET_TIME(timestamp);
 
-    // Write the first part of the time stamp (down to seconds).
-    n = (int) strftime(buffer, *space, "%F %T", &tm);
-    if (n == 0)
+    // Write the time stamp and a separator, leaving room for a terminator.
+    if (*space < n + 1)
     {
         return "No space for time stamp!";
     }
-    *space -= n;
+#   if LL_ASYNC
+    memset(buffer, ' ', TIMESTAMP_LENGTH);
+#   else /* !LL_ASYNC */
+    {
+        const char *err;
 
-    // Write the fractional seconds.
-    n = snprintf(buffer + n, *space, ".%03lu ", milliseconds);
-    if (n < 5 || n >= (int) *space)
+        *timestamp = LL_CLOCK_TO_TIMESTAMP(*timestamp);
+        err = format_timestamp(buffer, *timestamp);
+        if (err != NULL)
+        {
+            return err;
+        }
+    }
+#   endif /* end !LL_ASYNC */
+    if (separator != '\0')
     {
-        return "No space for time stamp milliseconds!";
+        buffer[TIMESTAMP_LENGTH] = separator;
     }
     *space -= n;
 
@@ -83,14 +113,14 @@ static const char *write_timestamp
 }
 #endif /* end LL_TIMESTAMP */
 
-#if !LL_CUSTOM_FORMAT
+#if !LL_CUSTOM_FORMAT && !LL_JSON_FORMAT
 /**
  * Produce a log message using a standard, built-in format.
  *
  * Message format is the following.  Square brackets indicate optional portions of the message,
  * determined by the library configuration.
  * @code{.unparsed}
- * [YYYY-MM-DD HH:MM:SS.mmm ]LEVL [file:line ]logger.name: Formatted log message
+ * [YYYY-MM-DD HH:MM:SS.mmm[uuu[nnn]] ]LEVL [file:line ]logger.name: Message body
  * @endcode
  *
  * @retval  NULL        Operation was successful and the message was written to the buffer.
@@ -99,27 +129,28 @@ static const char *write_timestamp
  */
 static const char *standard_format
 (
-    const struct ll_log *log,           ///< [in]  Log instance.
+    struct ll_log       *log,           ///< [in]  Log instance.
     char                *buffer,        ///< [out] Buffer to write log message into.
 #if LL_TIMESTAMP
-    time_t              *seconds,       ///< [out] Timestamp time since the Epoch, in seconds.
-    unsigned long       *microseconds,  ///< [out] Timestamp fraction of a second, in microseconds.
+    ll_timestamp_t      *timestamp,     ///< [out] Time stamp, or the clock reading if asynchronous.
 #endif /* end LL_TIMESTAMP */
 #if LL_LOCATION
     const char          *source,        ///< [in]  Log message source file name.
     unsigned int         line,          ///< [in]  Log message line number.
 #endif /* end LL_LOCATION */
     enum ll_level        level,         ///< [in]  Log level.
-    const char          *format,        ///< [in]  Format string for log message.
-    va_list              args           ///< [in]  Positional parameters for format string.
+    body_writer          body,          ///< [in]  Function to write the message body.
+    void                *context,       ///< [in]  Context passed to the body function.
+    size_t              *length         ///< [out] Length of the message, excluding terminator.
 )
 {
-    int     n;
-    size_t  space = LL_MAX_MESSAGE_SIZE;
+    const char  *err;
+    int          n;
+    size_t       space = LL_MAX_MESSAGE_SIZE;
 
     // First, write the timestamp into the buffer, if so configured.
 #if LL_TIMESTAMP
-    const char *err = write_timestamp(buffer, seconds, microseconds, &space);
+    err = write_timestamp(buffer, timestamp, &space, ' ');
     if (err != NULL)
     {
         return err;
@@ -160,86 +191,566 @@ static const char *standard_format
     }
     space -= n;
 
-    // Write the formatted message.
-    n = vsnprintf(buffer + OFFSET(space), space, format, args);
-    if (n >= (int) space)
+    // Write the message body.
+    err = body(buffer + OFFSET(space), &space, context);
+    if (err != NULL)
+    {
+        return err;
+    }
+
+    *length = OFFSET(space);
+    return NULL;
+}
+#endif /* end !LL_CUSTOM_FORMAT && !LL_JSON_FORMAT */
+
+#if LL_CUSTOM_FORMAT || (LL_JSON_FORMAT && LL_LOCATION)
+/**
+ * Append text to a message, keeping room for a terminator.
+ *
+ * @retval  NULL        Operation was successful.
+ * @retval  non-NULL    An error occured.  The returned value is a constant string describing the
+ *                      error.
+ */
+static const char *put_text
+(
+    char            *buffer,    ///< [out]    Message buffer.
+    size_t          *space,     ///< [in,out] Available space remaining in the buffer.
+    const char      *text,      ///< [in]     Text to append.
+    size_t           n          ///< [in]     Length of the text in bytes.
+)
+{
+    if (n >= *space)
     {
         return "Message too long!";
     }
-    space -= n;
+    memcpy(buffer + OFFSET(*space), text, n);
+    *space -= n;
 
     return NULL;
 }
-#endif /* end LL_STDFORMAT */
 
-/// Unconditionally log a message using a variable argument list.
-void _ll_logv
+#   if LL_LOCATION
+/**
+ * Append a line number to a message in decimal, keeping room for a terminator.
+ *
+ * @retval  NULL        Operation was successful.
+ * @retval  non-NULL    An error occured.  The returned value is a constant string describing the
+ *                      error.
+ */
+static const char *put_line
 (
-    struct ll_log   *log,
-    enum ll_level    level,
+    char            *buffer,    ///< [out]    Message buffer.
+    size_t          *space,     ///< [in,out] Available space remaining in the buffer.
+    unsigned int     line       ///< [in]     Line number.
+)
+{
+    char    digits[10];
+    size_t  n = sizeof(digits);
+
+    do
+    {
+        digits[--n] = (char) ('0' + line % 10U);
+        line /= 10U;
+    } while (line != 0);
+
+    return put_text(buffer, space, digits + n, sizeof(digits) - n);
+}
+#   endif /* end LL_LOCATION */
+#endif /* end LL_CUSTOM_FORMAT || (LL_JSON_FORMAT && LL_LOCATION) */
+
+#if LL_JSON_FORMAT
+/**
+ * Append a string literal to a JSON message, keeping room for a terminator.
+ *
+ * @param   text    String literal.
+ */
+#   define PUT_LITERAL(text)                                               \
+    do                                                                      \
+    {                                                                       \
+        if (sizeof(text) - 1 >= space)                                      \
+        {                                                                   \
+            return "Message too long!";                                     \
+        }                                                                   \
+        memcpy(buffer + OFFSET(space), (text), sizeof(text) - 1);           \
+        space -= sizeof(text) - 1;                                          \
+    } while (0)
+
+/**
+ * Escape a string value written as it is at the end of a JSON message, and close its quotes.
+ *
+ * @retval  NULL        Operation was successful.
+ * @retval  non-NULL    An error occured.  The returned value is a constant string describing the
+ *                      error.
+ */
+static const char *close_string
+(
+    char            *text,      ///< [in,out] String value.
+    size_t           length,    ///< [in]     Length of the string value, before escaping.
+    size_t          *space      ///< [in,out] Available space remaining from the start of the value.
+)
+{
+    const char *err;
+
+    // Leave room for the closing quote and the terminator.
+    if (*space < length + 2)
+    {
+        return "Message too long!";
+    }
+    err = json_escape_in_place(text, &length, *space - 2);
+    if (err != NULL)
+    {
+        return err;
+    }
+
+    text[length] = '"';
+    *space -= length + 1;
+    return NULL;
+}
+
+/**
+ * Produce a log message as a single line JSON object.
+ *
+ * Message format is the following.  Square brackets indicate optional portions of the message,
+ * determined by the library configuration.
+ * @code{.unparsed}
+ * {["ts":"YYYY-MM-DD HH:MM:SS.mmm[uuu[nnn]]",]"lvl":"LEVL","logger":"logger.name",
+ *  ["file":"file","line":line,]"msg":"Message body"}
+ * @endcode
+ *
+ * Strings are written as they are and then escaped in place, which for the usual text with nothing
+ * to escape costs one vectorized scan.
+ *
+ * @retval  NULL        Operation was successful and the message was written to the buffer.
+ * @retval  non-NULL    An error occured.  The returned value is a constant string describing the
+ *                      error.
+ */
+static const char *json_format
+(
+    struct ll_log       *log,           ///< [in]  Log instance.
+    char                *buffer,        ///< [out] Buffer to write log message into.
+#if LL_TIMESTAMP
+    ll_timestamp_t      *timestamp,     ///< [out] Time stamp, or the clock reading if asynchronous.
+#endif /* end LL_TIMESTAMP */
 #if LL_LOCATION
-    const char      *source,
-    unsigned int     line,
+    const char          *source,        ///< [in]  Log message source file name.
+    unsigned int         line,          ///< [in]  Log message line number.
 #endif /* end LL_LOCATION */
-    const char      *format,
-    va_list          args
+    enum ll_level        level,         ///< [in]  Log level.
+    body_writer          body,          ///< [in]  Function to write the message body.
+    void                *context,       ///< [in]  Context passed to the body function.
+    size_t              *length         ///< [out] Length of the message, excluding terminator.
 )
 {
-    const char          *err = NULL;
-    struct ll_log       *target_owner = NULL;
-    struct ll_target    *target;
-    time_t               seconds = 0;
-    unsigned long        microseconds = 0;
+    const char  *err;
+    const char  *name;
+    size_t       space = LL_MAX_MESSAGE_SIZE;
+    size_t       start;
+    size_t       n;
+    int          path;
 
-    assert(log != NULL);
-    if (level > get_threshold(log))
+#if LL_TIMESTAMP
+    PUT_LITERAL("{\"ts\":\"");
+    err = write_timestamp(buffer + OFFSET(space), timestamp, &space, '"');
+    if (err != NULL)
     {
-        // Current level prohibits logging this message, so just return.
-        return;
+        return err;
     }
-    assert(format != NULL);
+    PUT_LITERAL(",\"lvl\":\"");
+#else /* !LL_TIMESTAMP */
+    PUT_LITERAL("{\"lvl\":\"");
+#endif /* end !LL_TIMESTAMP */
+
+    // Level names come from the configuration, so they are escaped like everything else.
+    name = LL_LEVEL_NAME(level);
+    n = strlen(name);
+    if (n >= space)
+    {
+        return "No space for log level!";
+    }
+    memcpy(buffer + OFFSET(space), name, n);
+    err = close_string(buffer + OFFSET(space), n, &space);
+    if (err != NULL)
+    {
+        return err;
+    }
+
+    PUT_LITERAL(",\"logger\":\"");
+    path = get_path(log, buffer + OFFSET(space), space);
+    if (path < 0 || path >= (int) space)
+    {
+        return "Log path too long!";
+    }
+    err = close_string(buffer + OFFSET(space), (size_t) path, &space);
+    if (err != NULL)
+    {
+        return err;
+    }
+
 #if LL_LOCATION
-    assert(source != NULL);
-#endif
+    PUT_LITERAL(",\"file\":\"");
+    n = strlen(source);
+    if (n >= space)
+    {
+        return "No space for location info!";
+    }
+    memcpy(buffer + OFFSET(space), source, n);
+    err = close_string(buffer + OFFSET(space), n, &space);
+    if (err != NULL)
+    {
+        return err;
+    }
+
+    PUT_LITERAL(",\"line\":");
+    err = put_line(buffer, &space, line);
+    if (err != NULL)
+    {
+        return err;
+    }
+#endif /* end LL_LOCATION */
+
+    // Write the message body, then escape it where it lies.
+    PUT_LITERAL(",\"msg\":\"");
+    start = space;
+    err = body(buffer + OFFSET(space), &space, context);
+    if (err != NULL)
+    {
+        return err;
+    }
+    n = start - space;
+    space = start;
+    err = close_string(buffer + OFFSET(space), n, &space);
+    if (err != NULL)
+    {
+        return err;
+    }
+
+    PUT_LITERAL("}");
+    buffer[OFFSET(space)] = '\0';
+
+    *length = OFFSET(space);
+    return NULL;
+}
+#endif /* end LL_JSON_FORMAT */
 
-    LL_ALLOCATE_BUFFER(buffer, LL_MAX_MESSAGE_SIZE);
+#if LL_CUSTOM_FORMAT
+/**
+ * Pad the field just written to a message to its minimum width, keeping room for a terminator.
+ *
+ * @retval  NULL        Operation was successful.
+ * @retval  non-NULL    An error occured.  The returned value is a constant string describing the
+ *                      error.
+ */
+static const char *pad_field
+(
+    char            *buffer,    ///< [in,out] Message buffer.
+    size_t           start,     ///< [in]     Offset of the field in the buffer.
+    size_t          *space,     ///< [in,out] Available space remaining in the buffer.
+    const struct op *op         ///< [in]     Instruction which wrote the field.
+)
+{
+    size_t n = OFFSET(*space) - start;
+    size_t pad;
+
+    if (n >= op->width)
+    {
+        return NULL;
+    }
+    pad = op->width - n;
+    if (pad >= *space)
+    {
+        return "Message too long!";
+    }
+
+    if ((op->flags & OP_LEFT) != 0)
+    {
+        memset(buffer + start + n, ' ', pad);
+    }
+    else
+    {
+        memmove(buffer + start + pad, buffer + start, n);
+        memset(buffer + start, ' ', pad);
+    }
+    *space -= pad;
+
+    return NULL;
+}
+
+/**
+ * Produce a log message by running the layout program compiled from the pattern set with
+ * ll_set_layout.
+ *
+ * @retval  NULL        Operation was successful and the message was written to the buffer.
+ * @retval  non-NULL    An error occured.  The returned value is a constant string describing the
+ *                      error.
+ */
+static const char *custom_format
+(
+    struct ll_log       *log,           ///< [in]  Log instance.
+    char                *buffer,        ///< [out] Buffer to write log message into.
+#if LL_TIMESTAMP
+    ll_timestamp_t      *timestamp,     ///< [out] Time stamp, or the clock reading if asynchronous.
+#endif /* end LL_TIMESTAMP */
+#if LL_LOCATION
+    const char          *source,        ///< [in]  Log message source file name.
+    unsigned int         line,          ///< [in]  Log message line number.
+#endif /* end LL_LOCATION */
+    enum ll_level        level,         ///< [in]  Log level.
+    body_writer          body,          ///< [in]  Function to write the message body.
+    void                *context,       ///< [in]  Context passed to the body function.
+    size_t              *length,        ///< [out] Length of the message, excluding terminator.
+    size_t              *stamp          ///< [out] Offset of the time stamp, or NO_STAMP.
+)
+{
+    const struct layout *layout = layout_get();
+    const struct op     *op;
+    const struct op     *end = layout->ops + layout->count;
+    const char          *err = NULL;
+    const char          *name;
+    size_t               space = LL_MAX_MESSAGE_SIZE;
+    size_t               start;
+    int                  n;
+
+    *stamp = NO_STAMP;
+    for (op = layout->ops; op < end; ++op)
+    {
+        start = OFFSET(space);
+        switch (op->code)
+        {
+            case OP_LITERAL:
+                err = put_text(buffer, &space, layout->text + op->offset, op->length);
+                break;
+
+            case OP_TIMESTAMP:
+#   if LL_TIMESTAMP
+                err = write_timestamp(buffer + start, timestamp, &space, '\0');
+                *stamp = start;
+#   endif /* end LL_TIMESTAMP */
+                break;
+
+            case OP_LEVEL:
+                name = LL_LEVEL_NAME(level);
+                err = put_text(buffer, &space, name, strlen(name));
+                break;
+
+            case OP_FILE:
+#   if LL_LOCATION
+                err = put_text(buffer, &space, source, strlen(source));
+#   endif /* end LL_LOCATION */
+                break;
+
+            case OP_LINE:
+#   if LL_LOCATION
+                err = put_line(buffer, &space, line);
+#   endif /* end LL_LOCATION */
+                break;
+
+            case OP_PATH:
+                n = get_path(log, buffer + start, space);
+                if (n < 0 || n >= (int) space)
+                {
+                    return "Log path too long!";
+                }
+                space -= n;
+                break;
+
+            case OP_MESSAGE:
+                err = body(buffer + start, &space, context);
+                break;
 
+            default:
+                err = "Invalid layout!";
+                break;
+        }
+
+        if (err == NULL && op->width != 0)
+        {
+            err = pad_field(buffer, start, &space, op);
+        }
+        if (err != NULL)
+        {
+            return err;
+        }
+    }
+
+    buffer[OFFSET(space)] = '\0';
+    *length = OFFSET(space);
+    return NULL;
+}
+#endif /* end LL_CUSTOM_FORMAT */
+
+/**
+ * Produce a log message in the configured format.
+ *
+ * @retval  NULL        Operation was successful and the message was written to the buffer.
+ * @retval  non-NULL    An error occured.  The returned value is a constant string describing the
+ *                      error.
+ */
+static const char *format_message
+(
+    struct ll_log       *log,           ///< [in]  Log instance.
+    char                *buffer,        ///< [out] Buffer of LL_MAX_MESSAGE_SIZE bytes to write the
+                                        ///<       log message into.
+    ll_timestamp_t      *timestamp,     ///< [out] Time stamp, or the clock reading if asynchronous.
+#if LL_LOCATION
+    const char          *source,        ///< [in]  Log message source file name.
+    unsigned int         line,          ///< [in]  Log message line number.
+#endif /* end LL_LOCATION */
+    enum ll_level        level,         ///< [in]  Log level.
+    body_writer          body,          ///< [in]  Function to write the message body.
+    void                *context,       ///< [in]  Context passed to the body function.
+    size_t              *length,        ///< [out] Length of the message, excluding terminator.
+    size_t              *stamp          ///< [out] Offset of the time stamp, or NO_STAMP.
+)
+{
+#if !LL_TIMESTAMP
+    LL_UNUSED(timestamp);
+#endif
 #if LL_CUSTOM_FORMAT
-#   error Custom format specifiers are not currently supported!
+    return custom_format(   log,
+                            buffer,
+#   if LL_TIMESTAMP
+                            timestamp,
+#   endif /* end LL_TIMESTAMP */
+#   if LL_LOCATION
+                            source,
+                            line,
+#   endif /* end LL_LOCATION */
+                            level,
+                            body,
+                            context,
+                            length,
+                            stamp);
 #else /* !LL_CUSTOM_FORMAT */
-    err = standard_format(  log,
+    *stamp = LL_TIMESTAMP ? STAMP_OFFSET : NO_STAMP;
+#   if LL_JSON_FORMAT
+    return json_format(     log,
+#   else /* !LL_JSON_FORMAT */
+    return standard_format( log,
+#   endif /* end !LL_JSON_FORMAT */
                             buffer,
 #   if LL_TIMESTAMP
-                            &seconds,
-                            &microseconds,
+                            timestamp,
 #   endif /* end LL_TIMESTAMP */
 #   if LL_LOCATION
                             source,
                             line,
 #   endif /* end LL_LOCATION */
                             level,
-                            format,
-                            args);
-    if (err != NULL)
-    {
-        goto end;
-    }
+                            body,
+                            context,
+                            length);
 #endif /* end !LL_CUSTOM_FORMAT */
+}
 
-    // Pass the message buffer to the targets to write out.
-    target = get_targets(log, &target_owner);
-    while (target != NULL)
+/**
+ * Write a message body from a format string and its positional parameters.
+ *
+ * @retval  NULL        Operation was successful and the body was written to the buffer.
+ * @retval  non-NULL    An error occured.  The returned value is a constant string describing the
+ *                      error.
+ */
+static const char *write_formatted
+(
+    char            *buffer,    ///< [out]    Buffer to write the body into.
+    size_t          *space,     ///< [in,out] Available space remaining in the buffer.
+    void            *context    ///< [in]     Pointer to a struct formatted.
+)
+{
+    struct formatted    *formatted = context;
+    int                  n;
+
+    n = vsnprintf(buffer, *space, formatted->format, formatted->args);
+    if (n < 0 || n >= (int) *space)
     {
-        target->send(target, level, seconds, microseconds, buffer);
-        target = target->next;
+        return "Message too long!";
     }
+    *space -= n;
+
+    return NULL;
+}
 
-end:
-    if (target_owner != NULL)
+/// Format and deliver a message whose body is written by a given function.
+void log_message
+(
+    struct ll_log   *log,
+    enum ll_level    level,
+#if LL_LOCATION
+    const char      *source,
+    unsigned int     line,
+#endif /* end LL_LOCATION */
+    body_writer      body,
+    void            *context
+)
+{
+    const char          *err = NULL;
+    size_t               length = 0;
+    size_t               stamp;
+    ll_timestamp_t       timestamp = 0;
+#if !LL_ASYNC
+    struct ll_target    *target;
+    char                *reserved;
+#endif /* end !LL_ASYNC */
+
+    assert(log != NULL);
+    assert(body != NULL);
+#if LL_LOCATION
+    assert(source != NULL);
+#endif
+
+#if !LL_ASYNC
+    // Format the message straight into the target's own buffer, if it offers one.
+    reserved = reserve_direct(log, level, &target);
+    if (reserved != NULL)
     {
-        UNLOCK(target_owner);
+        err = format_message(   log,
+                                reserved,
+                                &timestamp,
+#   if LL_LOCATION
+                                source,
+                                line,
+#   endif /* end LL_LOCATION */
+                                level,
+                                body,
+                                context,
+                                &length,
+                                &stamp);
+        commit_direct(target, level, timestamp, reserved, (err == NULL) ? length : 0);
+    }
+    else
+#endif /* end !LL_ASYNC */
+    {
+        LL_ALLOCATE_BUFFER(buffer, LL_MAX_MESSAGE_SIZE);
+
+        err = format_message(   log,
+                                buffer,
+                                &timestamp,
+#if LL_LOCATION
+                                source,
+                                line,
+#endif /* end LL_LOCATION */
+                                level,
+                                body,
+                                context,
+                                &length,
+                                &stamp);
+        if (err == NULL)
+        {
+#if LL_ASYNC
+            // Hand the message to the background thread to write out.
+            err = async_push(   log,
+                                level,
+                                timestamp,
+                                (stamp != NO_STAMP) ? STAMP_TEXT : STAMP_NONE,
+                                (stamp != NO_STAMP) ? stamp : 0,
+                                buffer,
+                                length);
+#else /* !LL_ASYNC */
+            // Pass the message buffer to the targets to write out.
+            send_to_targets(log, level, timestamp, buffer, length);
+#endif /* end !LL_ASYNC */
+        }
+        LL_RELEASE_BUFFER(buffer);
     }
-    LL_RELEASE_BUFFER(buffer);
 
     if (err != NULL)
     {
@@ -250,3 +761,33 @@ end:
 #endif
     }
 }
+
+/// Unconditionally log a message using a variable argument list.
+void _ll_logv
+(
+    struct ll_log   *log,
+    enum ll_level    level,
+#if LL_LOCATION
+    const char      *source,
+    unsigned int     line,
+#endif /* end LL_LOCATION */
+    const char      *format,
+    va_list          args
+)
+{
+    struct formatted formatted;
+
+    assert(format != NULL);
+
+    formatted.format = format;
+    va_copy(formatted.args, args);
+    log_message(log,
+                level,
+#if LL_LOCATION
+                source,
+                line,
+#endif /* end LL_LOCATION */
+                &write_formatted,
+                &formatted);
+    va_end(formatted.args);
+}
@@ -29,6 +29,34 @@
 #   endif
 #endif /* end LL_THREADING */
 
+/**
+ * @section atomic Atomic Operation Ports
+ */
+#ifndef LL_ATOMIC_CAS
+#   include "port/gnuc/atomic.h"
+#endif
+#ifndef LL_ATOMIC_CAS
+#   include "port/mswin/atomic.h"
+#endif
+#ifndef LL_ATOMIC_CAS
+#   include "port/stdc/atomic.h"
+#endif
+#ifndef LL_ATOMIC_CAS
+#   error No atomic operation implementation provided, and no compatible existing port found!
+#endif
+
+/**
+ * @section thread Thread Ports
+ */
+#if LL_THREADING
+#   ifndef LL_THREAD_START
+#      include "port/posix/thread.h"
+#   endif
+#   if LL_ASYNC && !defined(LL_THREAD_START)
+#       error No thread implementation provided, and no compatible existing port found!
+#   endif
+#endif /* end LL_THREADING */
+
 /**
  * @section gettime Time Retrieval Ports
  */
@@ -58,6 +86,9 @@
 #       error No time conversion implementation provided, and no compatible existing port found!
 #   endif
 
+#   ifndef LL_GET_TIME
+#      include "port/x86/tsc.h"
+#   endif
 #   ifndef LL_GET_TIME
 #      include "port/mswin/gettime.h"
 #   endif
@@ -70,6 +101,23 @@
 #   ifndef LL_GET_TIME
 #       error No implementation provided to obtain time, and no compatible existing port found!
 #   endif
+#   ifndef LL_CLOCK_TO_TIMESTAMP
+/**
+ * Convert a value obtained by LL_GET_TIME to a time stamp.  Clocks which already produce
+ * nanoseconds since the Epoch need no conversion.
+ *
+ * @param   clock   Value obtained by LL_GET_TIME.
+ */
+#       define LL_CLOCK_TO_TIMESTAMP(clock) (clock)
+#   endif
+#   ifndef LL_CLOCK_TO_TIMESTAMP_SAFE
+/**
+ * Convert a value obtained by LL_GET_TIME to a time stamp, as is safe in a signal handler.
+ *
+ * @param   clock   Value obtained by LL_GET_TIME.
+ */
+#       define LL_CLOCK_TO_TIMESTAMP_SAFE(clock) LL_CLOCK_TO_TIMESTAMP(clock)
+#   endif
 #endif /* end LL_TIMESTAMP */
 
 #endif /* end PORT_H_ */
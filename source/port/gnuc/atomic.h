@@ -0,0 +1,80 @@
+/**
+ * @file        port/gnuc/atomic.h
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       Atomic operation port implementation for GCC and Clang compilers.
+ */
+#ifndef PORT_GNUC_ATOMIC_H_
+#define PORT_GNUC_ATOMIC_H_
+
+#include "ll_internal.h"
+
+#if __GNUC__ || __clang__
+
+/**
+ * Load a value with no ordering constraints.
+ *
+ * @param   p   Pointer to the variable.
+ */
+#   define LL_ATOMIC_LOAD_RELAXED(p)        __atomic_load_n((p), __ATOMIC_RELAXED)
+
+/**
+ * Load a value with acquire semantics.
+ *
+ * @param   p   Pointer to the variable.
+ */
+#   define LL_ATOMIC_LOAD_ACQUIRE(p)        __atomic_load_n((p), __ATOMIC_ACQUIRE)
+
+/**
+ * Store a value with no ordering constraints.
+ *
+ * @param   p   Pointer to the variable.
+ * @param   v   Value to store.
+ */
+#   define LL_ATOMIC_STORE_RELAXED(p, v)    __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+
+/**
+ * Store a value with release semantics.
+ *
+ * @param   p   Pointer to the variable.
+ * @param   v   Value to store.
+ */
+#   define LL_ATOMIC_STORE_RELEASE(p, v)    __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+/**
+ * Replace a value if it is equal to an expected value.  Acts as a full barrier.
+ *
+ * @param   p   Pointer to the variable.
+ * @param   e   Expected value.
+ * @param   d   Desired value.
+ *
+ * @return  Non-zero if the value was replaced.
+ */
+#   define LL_ATOMIC_CAS(p, e, d)           __sync_bool_compare_and_swap((p), (e), (d))
+
+/**
+ * Add to a value, returning the original value.  Acts as a full barrier.
+ *
+ * @param   p   Pointer to the variable.
+ * @param   v   Amount to add.
+ */
+#   define LL_ATOMIC_FETCH_ADD(p, v)        __atomic_fetch_add((p), (v), __ATOMIC_SEQ_CST)
+
+/**
+ * Subtract from a value, returning the original value.  Acts as a full barrier.
+ *
+ * @param   p   Pointer to the variable.
+ * @param   v   Amount to subtract.
+ */
+#   define LL_ATOMIC_FETCH_SUB(p, v)        __atomic_fetch_sub((p), (v), __ATOMIC_SEQ_CST)
+
+/**
+ * Full memory barrier.
+ */
+#   define LL_ATOMIC_FENCE()                __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+#endif /* end __GNUC__ || __clang__ */
+
+#endif /* end PORT_GNUC_ATOMIC_H_ */
@@ -0,0 +1,87 @@
+/**
+ * @file        port/mswin/atomic.h
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       Atomic operation port implementation for Windows platforms.
+ *              Only 32-bit variables are supported.  Every operation acts as a full barrier.
+ */
+#ifndef PORT_MSWIN_ATOMIC_H_
+#define PORT_MSWIN_ATOMIC_H_
+
+#include "ll_internal.h"
+
+#if _MSC_VER
+#   define WIN32_LEAN_AND_MEAN
+#   include <Windows.h>
+#   undef WIN32_LEAN_AND_MEAN
+
+/**
+ * Load a value with no ordering constraints.
+ *
+ * @param   p   Pointer to the variable.
+ */
+#   define LL_ATOMIC_LOAD_RELAXED(p)        (*(p))
+
+/**
+ * Load a value with acquire semantics.
+ *
+ * @param   p   Pointer to the variable.
+ */
+#   define LL_ATOMIC_LOAD_ACQUIRE(p)        ((uint32_t) InterlockedOr((volatile LONG *) (p), 0))
+
+/**
+ * Store a value with no ordering constraints.
+ *
+ * @param   p   Pointer to the variable.
+ * @param   v   Value to store.
+ */
+#   define LL_ATOMIC_STORE_RELAXED(p, v)    (*(p) = (v))
+
+/**
+ * Store a value with release semantics.
+ *
+ * @param   p   Pointer to the variable.
+ * @param   v   Value to store.
+ */
+#   define LL_ATOMIC_STORE_RELEASE(p, v)    InterlockedExchange((volatile LONG *) (p), (LONG) (v))
+
+/**
+ * Replace a value if it is equal to an expected value.
+ *
+ * @param   p   Pointer to the variable.
+ * @param   e   Expected value.
+ * @param   d   Desired value.
+ *
+ * @return  Non-zero if the value was replaced.
+ */
+#   define LL_ATOMIC_CAS(p, e, d) \
+    (InterlockedCompareExchange((volatile LONG *) (p), (LONG) (d), (LONG) (e)) == (LONG) (e))
+
+/**
+ * Add to a value, returning the original value.
+ *
+ * @param   p   Pointer to the variable.
+ * @param   v   Amount to add.
+ */
+#   define LL_ATOMIC_FETCH_ADD(p, v) \
+    ((uint32_t) InterlockedExchangeAdd((volatile LONG *) (p), (LONG) (v)))
+
+/**
+ * Subtract from a value, returning the original value.
+ *
+ * @param   p   Pointer to the variable.
+ * @param   v   Amount to subtract.
+ */
+#   define LL_ATOMIC_FETCH_SUB(p, v) \
+    ((uint32_t) InterlockedExchangeAdd((volatile LONG *) (p), -(LONG) (v)))
+
+/**
+ * Full memory barrier.
+ */
+#   define LL_ATOMIC_FENCE()                MemoryBarrier()
+
+#endif /* end _MSC_VER */
+
+#endif /* end PORT_MSWIN_ATOMIC_H_ */
@@ -14,7 +14,7 @@
 #   if HAVE__FTIME_S
 
 /// Shared implementation if _ll_get_time is not inlined.
-LL_DEFINE_INLINE void _ll_get_time(time_t *secondsp, unsigned long *microsecondsp);
+LL_DEFINE_INLINE void _ll_get_time(ll_timestamp_t *timestampp);
 
 #   endif /* end HAVE__FTIME_S */
 #endif /* end LL_TIMESTAMP */
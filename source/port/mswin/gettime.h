@@ -22,8 +22,8 @@
  */
 LL_DECLARE_INLINE void _ll_get_time
 (
-    time_t          *secondsp,      ///< [out] Returned seconds since the Epoch.
-    unsigned long   *microsecondsp  ///< [out] Returned microseconds into the current second.
+    ll_timestamp_t  *timestampp ///< [out] Returned nanoseconds since the Epoch, at millisecond
+                                ///<       resolution.
 )
 {
     errno_t         result;
@@ -32,17 +32,16 @@ LL_DECLARE_INLINE void _ll_get_time
     result = _ftime_s(&now);
     assert(result == 0);
 
-    *secondsp       = (time_t) now.time;
-    *microsecondsp  = (unsigned long) now.millitm * 1000UL;
+    *timestampp =   (ll_timestamp_t) now.time * 1000000000U +
+                    (ll_timestamp_t) now.millitm * 1000000U;
 }
 
 /**
  * Retrieve the current system time.
  *
- * @param[out]  secondsp        Returned seconds since the Epoch.
- * @param[out]  microsecondsp   Returned fraction of the current second, in microseconds.
+ * @param[out]  timestampp  Returned nanoseconds since the Epoch.
  */
-#   define LL_GET_TIME(secondsp, microsecondsp) _ll_get_time((secondsp), (microsecondsp))
+#   define LL_GET_TIME(timestampp) _ll_get_time(timestampp)
 
 #endif /* end HAVE__FTIME_S */
 
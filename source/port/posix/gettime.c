@@ -11,10 +11,10 @@
 #if LL_TIMESTAMP
 #   include "gettime.h"
 
-#   if HAVE_GETTIMEOFDAY
+#   if HAVE_CLOCK_GETTIME || HAVE_GETTIMEOFDAY
 
 /// Shared implementation if _ll_get_time is not inlined.
-LL_DEFINE_INLINE void _ll_get_time(time_t *secondsp, unsigned long *microsecondsp);
+LL_DEFINE_INLINE void _ll_get_time(ll_timestamp_t *timestampp);
 
-#   endif /* end HAVE_GETTIMEOFDAY */
+#   endif /* end HAVE_CLOCK_GETTIME || HAVE_GETTIMEOFDAY */
 #endif /* end LL_TIMESTAMP */
@@ -11,7 +11,40 @@
 
 #include "ll_internal.h"
 
-#if HAVE_GETTIMEOFDAY
+#if HAVE_CLOCK_GETTIME
+#   include <time.h>
+
+#   if LL_CLOCK == LL_CLOCK_COARSE && HAVE_CLOCK_REALTIME_COARSE
+/// Clock to read.  The coarse clock is read from the vDSO without a system call on Linux, in a few
+/// nanoseconds, but only advances once per scheduler tick.
+#       define LL_POSIX_CLOCK CLOCK_REALTIME_COARSE
+#   else
+/// Clock to read.
+#       define LL_POSIX_CLOCK CLOCK_REALTIME
+#   endif
+
+/**
+ * Retrieve the current system time using POSIX clock_gettime().
+ */
+LL_DECLARE_INLINE void _ll_get_time
+(
+    ll_timestamp_t  *timestampp ///< [out]  Nanoseconds since the Epoch.
+)
+{
+    struct timespec now;
+
+    clock_gettime(LL_POSIX_CLOCK, &now);
+    *timestampp = (ll_timestamp_t) now.tv_sec * 1000000000U + (ll_timestamp_t) now.tv_nsec;
+}
+
+/**
+ * Retrieve the current system time.
+ *
+ * @param[out]  timestampp  Nanoseconds since the Epoch.
+ */
+#   define LL_GET_TIME(timestampp) _ll_get_time(timestampp)
+
+#elif HAVE_GETTIMEOFDAY
 #   include <sys/time.h>
 
 /**
@@ -19,25 +52,22 @@
  */
 LL_DECLARE_INLINE void _ll_get_time
 (
-    time_t          *secondsp,      ///< [out]  Seconds since the Epoch.
-    unsigned long   *microsecondsp  ///< [out]  Fraction of the current second, in microseconds.
+    ll_timestamp_t  *timestampp ///< [out]  Nanoseconds since the Epoch, at microsecond resolution.
 )
 {
     struct timeval now;
 
     gettimeofday(&now, NULL);
-    *secondsp       = (time_t) now.tv_sec;
-    *microsecondsp  = (unsigned long) now.tv_usec;
+    *timestampp = (ll_timestamp_t) now.tv_sec * 1000000000U + (ll_timestamp_t) now.tv_usec * 1000U;
 }
 
 /**
  * Retrieve the current system time.
  *
- * @param[out]  secondsp        Seconds since the Epoch.
- * @param[out]  microsecondsp   Fraction of the current second, in microseconds.
+ * @param[out]  timestampp  Nanoseconds since the Epoch.
  */
-#   define LL_GET_TIME(secondsp, microsecondsp) _ll_get_time((secondsp), (microsecondsp))
+#   define LL_GET_TIME(timestampp) _ll_get_time(timestampp)
 
-#endif /* end HAVE_GETTIMEOFDAY */
+#endif /* end HAVE_CLOCK_GETTIME || HAVE_GETTIMEOFDAY */
 
 #endif /* end PORT_POSIX_GETTIME_H_ */
@@ -0,0 +1,78 @@
+/**
+ * @file        port/posix/thread.h
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       Thread and condition variable port implementation for POSIX platforms.
+ */
+#ifndef PORT_POSIX_THREAD_H_
+#define PORT_POSIX_THREAD_H_
+
+#include "ll_internal.h"
+
+#if HAVE_PTHREAD_CREATE && HAVE_PTHREAD_COND
+#   include <pthread.h>
+
+/// Thread handle type.
+typedef pthread_t ll_thread;
+
+/// Condition variable type.
+typedef pthread_cond_t ll_cond;
+
+/**
+ * Static initializer for a condition variable.
+ */
+#   define LL_STATIC_COND_INIT          PTHREAD_COND_INITIALIZER
+
+/**
+ * Declare or define a thread entry point.
+ *
+ * @param   name    Function name.
+ * @param   arg     Name of the void pointer argument passed to the thread.
+ */
+#   define LL_THREAD_FUNC(name, arg)    void *name(void *arg)
+
+/**
+ * Return from a thread entry point.
+ */
+#   define LL_THREAD_RETURN             return NULL
+
+/**
+ * Start a detached thread.
+ *
+ * @param[out]  t       Thread handle pointer.
+ * @param[in]   func    Thread entry point, declared with LL_THREAD_FUNC.
+ * @param[in]   arg     Argument to pass to the thread.
+ *
+ * @retval  0   Success.
+ * @retval  !=0 The thread could not be started.
+ */
+#   define LL_THREAD_START(t, func, arg)                                            \
+    ((pthread_create((t), NULL, (func), (arg)) == 0) ? pthread_detach(*(t)) : -1)
+
+/**
+ * Wait on a condition variable.  The mutex must be locked by the caller.
+ *
+ * @param   c   Condition variable pointer.
+ * @param   m   Mutex instance pointer.
+ */
+#   define LL_COND_WAIT(c, m)           pthread_cond_wait((c), (m))
+
+/**
+ * Wake one thread waiting on a condition variable.
+ *
+ * @param   c   Condition variable pointer.
+ */
+#   define LL_COND_SIGNAL(c)            pthread_cond_signal(c)
+
+/**
+ * Wake all threads waiting on a condition variable.
+ *
+ * @param   c   Condition variable pointer.
+ */
+#   define LL_COND_BROADCAST(c)         pthread_cond_broadcast(c)
+
+#endif /* end HAVE_PTHREAD_CREATE && HAVE_PTHREAD_COND */
+
+#endif /* end PORT_POSIX_THREAD_H_ */
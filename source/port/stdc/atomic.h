@@ -0,0 +1,82 @@
+/**
+ * @file        port/stdc/atomic.h
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       Atomic operation port implementation using only standard C.
+ *              This port is limited to single-threaded environments as the operations are plain
+ *              loads and stores.
+ */
+#ifndef PORT_STDC_ATOMIC_H_
+#define PORT_STDC_ATOMIC_H_
+
+#include "ll_internal.h"
+
+#if !LL_THREADING
+
+/**
+ * Load a value with no ordering constraints.
+ *
+ * @param   p   Pointer to the variable.
+ */
+#   define LL_ATOMIC_LOAD_RELAXED(p)        (*(p))
+
+/**
+ * Load a value with acquire semantics.
+ *
+ * @param   p   Pointer to the variable.
+ */
+#   define LL_ATOMIC_LOAD_ACQUIRE(p)        (*(p))
+
+/**
+ * Store a value with no ordering constraints.
+ *
+ * @param   p   Pointer to the variable.
+ * @param   v   Value to store.
+ */
+#   define LL_ATOMIC_STORE_RELAXED(p, v)    (*(p) = (v))
+
+/**
+ * Store a value with release semantics.
+ *
+ * @param   p   Pointer to the variable.
+ * @param   v   Value to store.
+ */
+#   define LL_ATOMIC_STORE_RELEASE(p, v)    (*(p) = (v))
+
+/**
+ * Replace a value if it is equal to an expected value.
+ *
+ * @param   p   Pointer to the variable.
+ * @param   e   Expected value.
+ * @param   d   Desired value.
+ *
+ * @return  Non-zero if the value was replaced.
+ */
+#   define LL_ATOMIC_CAS(p, e, d)           ((*(p) == (e)) ? ((*(p) = (d)), 1) : 0)
+
+/**
+ * Add to a value, returning the original value.
+ *
+ * @param   p   Pointer to the variable.
+ * @param   v   Amount to add.
+ */
+#   define LL_ATOMIC_FETCH_ADD(p, v)        ((*(p) += (v)) - (v))
+
+/**
+ * Subtract from a value, returning the original value.
+ *
+ * @param   p   Pointer to the variable.
+ * @param   v   Amount to subtract.
+ */
+#   define LL_ATOMIC_FETCH_SUB(p, v)        ((*(p) -= (v)) + (v))
+
+/**
+ * Full memory barrier.
+ */
+#   define LL_ATOMIC_FENCE()
+
+#endif /* end !LL_THREADING */
+
+#endif /* end PORT_STDC_ATOMIC_H_ */
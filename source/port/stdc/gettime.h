@@ -18,15 +18,10 @@
 /**
  * Retrieve the current system time.
  *
- * @param[out]  secondsp        Seconds since the Epoch.
- * @param[out]  microsecondsp   Fraction of the current second, in microseconds.
+ * @param[out]  timestampp  Nanoseconds since the Epoch, at one second resolution.
  */
-#   define LL_GET_TIME(secondsp, microsecondsp) \
-    do                                          \
-    {                                           \
-        *secondsp = time(NULL);                 \
-        *microsecondsp = 0;                     \
-    } while (0)
+#   define LL_GET_TIME(timestampp) \
+    (*(timestampp) = (ll_timestamp_t) time(NULL) * 1000000000U)
 
 #endif /* end !LL_THREADING */
 
@@ -0,0 +1,244 @@
+/**
+ * @file        port/x86/tsc.c
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       Port implementation to obtain time from the x86 time stamp counter.
+ *
+ * Counter values are converted by interpolating from an anchor, a counter value and wall clock time
+ * sampled together, at a rate measured against the wall clock.  The anchor is sampled again once
+ * the counter has advanced by about a second, and the rate is measured from the first anchor each
+ * time so that it becomes more accurate the longer the process runs.  The calibration is published
+ * under a sequence lock so that conversions by different threads do not block each other.  While
+ * the rate is first being measured, other threads read the wall clock instead of waiting.
+ */
+#include "ll_internal.h"
+
+#if LL_TIMESTAMP
+#   include "tsc.h"
+#endif
+
+#if LL_TIMESTAMP && LL_TSC_IMPLEMENTED
+#   include "../gnuc/atomic.h"
+
+#   include <time.h>
+
+/// Interval over which the counter rate is first measured, in nanoseconds.
+#   define CALIBRATION_NS   1000000U
+
+/// Interval between anchors, in nanoseconds.
+#   define ANCHOR_NS        1000000000U
+
+/// Largest plausible change in the measured rate between anchors, as a fraction of the rate.  A
+/// larger change means that the wall clock was stepped, so the measurement is started over.
+#   define MAX_DRIFT        0.001
+
+/// Number of times a conversion in a signal handler tries to read the calibration.
+#   define SAFE_ATTEMPTS    64
+
+/// Sequence number of the calibration.  Zero until calibrated, and odd while being updated.  It is
+/// only ever one while the rate is first being measured, as it skips zero when it wraps.
+static volatile uint32_t    sequence;
+/// Counter value of the current anchor.
+static volatile uint64_t    anchor_ticks;
+/// Wall clock time of the current anchor, in nanoseconds since the Epoch.
+static volatile uint64_t    anchor_time;
+/// Nanoseconds per counter tick, as a 32.32 fixed point value.
+static volatile uint64_t    scale;
+/// Number of counter ticks after the current anchor at which to sample a new one.
+static volatile uint64_t    interval;
+/// Counter value of the anchor the rate is measured from.  Only used by the updater.
+static uint64_t             origin_ticks;
+/// Wall clock time of the anchor the rate is measured from.  Only used by the updater.
+static uint64_t             origin_time;
+
+/// Read the wall clock, in nanoseconds since the Epoch.
+static uint64_t wall_time(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (uint64_t) now.tv_sec * 1000000000U + (uint64_t) now.tv_nsec;
+}
+
+/// Sample the counter and the wall clock together, keeping the pair read in the shortest time.
+static void sample(uint64_t *ticks, uint64_t *time)
+{
+    uint64_t    before;
+    uint64_t    after;
+    uint64_t    now;
+    uint64_t    best = UINT64_MAX;
+    int         i;
+
+    for (i = 0; i < 3; ++i)
+    {
+        before  = __rdtsc();
+        now     = wall_time();
+        after   = __rdtsc();
+        if (after - before < best)
+        {
+            best    = after - before;
+            *ticks  = before + best / 2;
+            *time   = now;
+        }
+    }
+}
+
+/// Multiply a tick count by a 32.32 fixed point scale without overflowing the intermediate result.
+static uint64_t scale_ticks(uint64_t ticks, uint64_t factor)
+{
+    return (ticks >> 32) * factor + (((ticks & UINT32_C(0xFFFFFFFF)) * factor) >> 32);
+}
+
+/// Sample a new anchor and update the rate.  The caller must have made the sequence number odd.
+static void calibrate(uint32_t before)
+{
+    uint64_t    ticks;
+    uint64_t    time;
+    double      rate;
+
+    sample(&ticks, &time);
+    if (before != 0)
+    {
+        if (time <= origin_time || ticks <= origin_ticks)
+        {
+            rate = 0.0;
+        }
+        else
+        {
+            rate = (double) (time - origin_time) / (double) (ticks - origin_ticks) * 4294967296.0;
+        }
+        if (rate < (double) scale * (1.0 - MAX_DRIFT) || rate > (double) scale * (1.0 + MAX_DRIFT))
+        {
+            // The wall clock was stepped, so restart the measurement from the new anchor, keeping
+            // the previous rate meanwhile.
+            origin_ticks    = ticks;
+            origin_time     = time;
+            rate            = (double) scale;
+        }
+    }
+    else
+    {
+        // First use, so measure the rate over a short interval.
+        origin_ticks    = ticks;
+        origin_time     = time;
+        do
+        {
+            sample(&ticks, &time);
+        } while (time - origin_time < CALIBRATION_NS || ticks == origin_ticks);
+        rate = (double) (time - origin_time) / (double) (ticks - origin_ticks) * 4294967296.0;
+    }
+
+    anchor_ticks    = ticks;
+    anchor_time     = time;
+    scale           = (uint64_t) rate;
+    interval        = (uint64_t) (ANCHOR_NS / rate * 4294967296.0);
+    LL_ATOMIC_STORE_RELEASE(&sequence, (before + 2U != 0) ? before + 2U : 2U);
+}
+
+/// Convert a time stamp counter value to wall clock time.
+ll_timestamp_t _ll_tsc_to_timestamp(ll_timestamp_t ticks)
+{
+    uint32_t    before;
+    uint64_t    base_ticks;
+    uint64_t    base_time;
+    uint64_t    factor;
+    uint64_t    limit;
+
+    for (;;)
+    {
+        before = LL_ATOMIC_LOAD_ACQUIRE(&sequence);
+        if (before == 1U)
+        {
+            // Another thread is measuring the rate for the first time, which takes about
+            // CALIBRATION_NS, so read the wall clock rather than wait.
+            return wall_time();
+        }
+        if ((before & 1U) != 0)
+        {
+            // Another thread is sampling a new anchor, which only takes a few clock reads.
+            _mm_pause();
+            continue;
+        }
+        if (before == 0)
+        {
+            if (LL_ATOMIC_CAS(&sequence, 0U, 1U))
+            {
+                calibrate(0U);
+            }
+            continue;
+        }
+
+        base_ticks  = anchor_ticks;
+        base_time   = anchor_time;
+        factor      = scale;
+        limit       = interval;
+        LL_ATOMIC_FENCE();
+        if (LL_ATOMIC_LOAD_RELAXED(&sequence) != before)
+        {
+            continue;
+        }
+
+        // Sample a new anchor once the current one is old, unless another thread is already doing
+        // so.
+        if (ticks > base_ticks && ticks - base_ticks > limit &&
+            LL_ATOMIC_CAS(&sequence, before, before + 1U))
+        {
+            calibrate(before);
+            continue;
+        }
+        break;
+    }
+
+    if (ticks >= base_ticks)
+    {
+        return base_time + scale_ticks(ticks - base_ticks, factor);
+    }
+    return base_time - scale_ticks(base_ticks - ticks, factor);
+}
+
+/// Convert a time stamp counter value to wall clock time, as is safe in a signal handler.
+ll_timestamp_t _ll_tsc_to_timestamp_safe(ll_timestamp_t ticks)
+{
+    uint32_t    before;
+    uint64_t    base_ticks;
+    uint64_t    base_time;
+    uint64_t    factor;
+    int         i;
+
+    // The calibration is never updated here, and the thread interrupted may be the one updating
+    // it, so give up after a few attempts rather than wait for the sequence number to settle.
+    for (i = 0; i < SAFE_ATTEMPTS; ++i)
+    {
+        before = LL_ATOMIC_LOAD_ACQUIRE(&sequence);
+        if (before == 0)
+        {
+            break;
+        }
+        if ((before & 1U) != 0)
+        {
+            continue;
+        }
+
+        base_ticks  = anchor_ticks;
+        base_time   = anchor_time;
+        factor      = scale;
+        LL_ATOMIC_FENCE();
+        if (LL_ATOMIC_LOAD_RELAXED(&sequence) != before)
+        {
+            continue;
+        }
+
+        if (ticks >= base_ticks)
+        {
+            return base_time + scale_ticks(ticks - base_ticks, factor);
+        }
+        return base_time - scale_ticks(base_ticks - ticks, factor);
+    }
+
+    // Not calibrated yet, or being updated: read the wall clock, which is async-signal-safe.
+    return wall_time();
+}
+
+#endif /* end LL_TIMESTAMP && LL_TSC_IMPLEMENTED */
@@ -0,0 +1,77 @@
+/**
+ * @file        port/x86/tsc.h
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       Port implementation to obtain time from the x86 time stamp counter.
+ *
+ * Reading the time stamp counter takes a single instruction.  The raw counter value is stored as
+ * the time stamp of a message and only converted to wall clock time, using a calibration against
+ * clock_gettime(), when the time stamp is formatted.  This relies on an invariant time stamp
+ * counter, which runs at a constant rate on all cores, as found on any recent x86 processor.
+ */
+#ifndef PORT_X86_TSC_H_
+#define PORT_X86_TSC_H_
+
+#include "ll_internal.h"
+
+#if LL_CLOCK == LL_CLOCK_TSC && HAVE_CLOCK_GETTIME                     && \
+    (defined(__GNUC__) || defined(__clang__))                           && \
+    (defined(__x86_64__) || defined(__i386__))
+#   include <x86intrin.h>
+
+/// The time stamp counter port is in use.
+#   define LL_TSC_IMPLEMENTED 1
+
+/**
+ * Convert a time stamp counter value to wall clock time.  The calibration is performed on first
+ * use, which takes about a millisecond, and is refreshed about once per second after that.
+ *
+ * @return Nanoseconds since the Epoch.
+ */
+ll_timestamp_t _ll_tsc_to_timestamp
+(
+    ll_timestamp_t ticks ///< [in] Time stamp counter value.
+);
+
+/**
+ * Convert a time stamp counter value to wall clock time, as is safe in a signal handler.  The
+ * calibration is not started or refreshed, and if it cannot be read after a few attempts the wall
+ * clock is read instead.
+ *
+ * @return Nanoseconds since the Epoch.
+ */
+ll_timestamp_t _ll_tsc_to_timestamp_safe
+(
+    ll_timestamp_t ticks ///< [in] Time stamp counter value.
+);
+
+/**
+ * Retrieve the current time stamp counter value.
+ *
+ * @param[out]  timestampp  Time stamp counter value, to be converted by LL_CLOCK_TO_TIMESTAMP.
+ */
+#   define LL_GET_TIME(timestampp) (*(timestampp) = (ll_timestamp_t) __rdtsc())
+
+/**
+ * Convert a value obtained by LL_GET_TIME to wall clock time.
+ *
+ * @param   ticks   Time stamp counter value.
+ *
+ * @return Nanoseconds since the Epoch.
+ */
+#   define LL_CLOCK_TO_TIMESTAMP(ticks) _ll_tsc_to_timestamp(ticks)
+
+/**
+ * Convert a value obtained by LL_GET_TIME to wall clock time, as is safe in a signal handler.
+ *
+ * @param   ticks   Time stamp counter value.
+ *
+ * @return Nanoseconds since the Epoch.
+ */
+#   define LL_CLOCK_TO_TIMESTAMP_SAFE(ticks) _ll_tsc_to_timestamp_safe(ticks)
+
+#endif /* end LL_CLOCK == LL_CLOCK_TSC && ... */
+
+#endif /* end PORT_X86_TSC_H_ */
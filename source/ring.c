@@ -0,0 +1,253 @@
+/**
+ * @file        ring.c
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       Bounded lock-free multi-producer, single-consumer ring buffer.
+ *
+ * Positions are free-running 32-bit counters which are masked to obtain offsets into the data area.
+ * Each record is preceded by a header and padded to a multiple of the header size.  A record which
+ * would run past the end of the data area is instead placed at the start, and the space that was
+ * skipped is filled with a padding record.
+ *
+ * A header whose state is zero has been reserved but not committed.  The consumer clears every byte
+ * it releases so that the headers of future reservations start out uncommitted, wherever they fall.
+ */
+#include "ll_ring.h"
+
+#include "port.h"
+
+#include <assert.h>
+#include <string.h>
+
+/// Record header state for a padding record, which the consumer skips.
+#define STATE_PADDING   UINT32_C(0xFFFFFFFF)
+
+/**
+ * Round a length up to a multiple of the header size.
+ *
+ * @param   n   Length in bytes.
+ */
+#define ALIGN(n) (((n) + sizeof(struct header) - 1) & ~(sizeof(struct header) - 1))
+
+/// Record header.
+struct header
+{
+    uint32_t             size;  ///< Size of the record, excluding the header.
+    volatile uint32_t    state; ///< Zero if uncommitted, STATE_PADDING for a padding or abandoned
+                                ///< record, or the committed length.
+};
+
+/// Get a pointer to the header at a ring position.
+static struct header *header_at(struct ll_ring *ring, uint32_t position)
+{
+    unsigned char *data = (unsigned char *) (ring + 1);
+    return (struct header *) (data + (position & (ring->size - 1)));
+}
+
+/// Initialize a ring buffer at run time.
+int ll_ring_init(struct ll_ring *ring, size_t size)
+{
+    assert(ring != NULL);
+
+    if (size < 2 * sizeof(struct header)    ||
+        size > UINT32_C(0x40000000)         ||
+        (size & (size - 1)) != 0)
+    {
+        return -1;
+    }
+
+    memset(ring, 0, sizeof(*ring) + size);
+    ring->size = (uint32_t) size;
+    return 0;
+}
+
+/// Reserve space for a record.
+void *ll_ring_reserve(struct ll_ring *ring, size_t length)
+{
+    uint32_t         head;
+    uint32_t         tail;
+    uint32_t         pad;
+    uint32_t         need;
+    uint32_t         offset;
+    struct header   *header;
+
+    assert(ring != NULL);
+    assert(ring->size != 0);
+
+    if (length > ring->size / 2 - sizeof(struct header))
+    {
+        return NULL;
+    }
+    need = (uint32_t) (sizeof(struct header) + ALIGN(length));
+
+    do
+    {
+        head    = LL_ATOMIC_LOAD_RELAXED(&ring->head);
+        tail    = LL_ATOMIC_LOAD_ACQUIRE(&ring->tail);
+        offset  = head & (ring->size - 1);
+        pad     = (offset + need > ring->size) ? ring->size - offset : 0;
+
+        if (head - tail + pad + need > ring->size)
+        {
+            return NULL;
+        }
+    } while (!LL_ATOMIC_CAS(&ring->head, head, head + pad + need));
+
+    if (pad != 0)
+    {
+        header = header_at(ring, head);
+        header->size = pad - (uint32_t) sizeof(struct header);
+        LL_ATOMIC_STORE_RELEASE(&header->state, STATE_PADDING);
+    }
+
+    header = header_at(ring, head + pad);
+    header->size = need - (uint32_t) sizeof(struct header);
+    return header + 1;
+}
+
+/// Publish a reserved record to the consumer.
+void ll_ring_commit(struct ll_ring *ring, void *record, size_t length)
+{
+    struct header *header = (struct header *) record - 1;
+
+    assert(ring != NULL);
+    assert(record != NULL);
+    assert(length <= header->size);
+    LL_UNUSED(ring);
+
+    LL_ATOMIC_STORE_RELEASE(&header->state, (length != 0) ? (uint32_t) length : STATE_PADDING);
+}
+
+/// Get the oldest record without removing it from the ring.
+void *ll_ring_peek(struct ll_ring *ring, size_t *length)
+{
+    uint32_t         tail;
+    uint32_t         state;
+    struct header   *header;
+
+    assert(ring != NULL);
+    assert(length != NULL);
+
+    for (;;)
+    {
+        tail = LL_ATOMIC_LOAD_RELAXED(&ring->tail);
+        if (tail == LL_ATOMIC_LOAD_ACQUIRE(&ring->head))
+        {
+            return NULL;
+        }
+
+        header = header_at(ring, tail);
+        state = LL_ATOMIC_LOAD_ACQUIRE(&header->state);
+        if (state == 0)
+        {
+            return NULL;
+        }
+        else if (state == STATE_PADDING)
+        {
+            ll_ring_release(ring);
+        }
+        else
+        {
+            *length = state;
+            return header + 1;
+        }
+    }
+}
+
+/// Remove the oldest record from the ring.
+void ll_ring_release(struct ll_ring *ring)
+{
+    uint32_t         tail;
+    uint32_t         size;
+    struct header   *header;
+
+    assert(ring != NULL);
+
+    tail    = LL_ATOMIC_LOAD_RELAXED(&ring->tail);
+    header  = header_at(ring, tail);
+    size    = (uint32_t) sizeof(struct header) + header->size;
+
+    memset(header, 0, size);
+    LL_ATOMIC_STORE_RELEASE(&ring->tail, tail + size);
+}
+
+/// Get the next committed record without removing anything from the ring.
+void *ll_ring_scan(struct ll_ring *ring, uint32_t *position, size_t *length)
+{
+    uint32_t         state;
+    struct header   *header;
+
+    assert(ring != NULL);
+    assert(position != NULL);
+    assert(length != NULL);
+
+    while (*position != LL_ATOMIC_LOAD_ACQUIRE(&ring->head))
+    {
+        header = header_at(ring, *position);
+        state = LL_ATOMIC_LOAD_ACQUIRE(&header->state);
+        if (state == 0)
+        {
+            break;
+        }
+
+        *position += (uint32_t) sizeof(struct header) + header->size;
+        if (state != STATE_PADDING)
+        {
+            *length = state;
+            return header + 1;
+        }
+    }
+
+    return NULL;
+}
+
+/// Remove every record before a position reached with ll_ring_scan().
+void ll_ring_release_to(struct ll_ring *ring, uint32_t position)
+{
+    assert(ring != NULL);
+
+    while (LL_ATOMIC_LOAD_RELAXED(&ring->tail) != position)
+    {
+        ll_ring_release(ring);
+    }
+}
+
+/// Get the oldest record if it has been reserved but not committed.
+void *ll_ring_uncommitted(struct ll_ring *ring)
+{
+    size_t           length;
+    struct header   *header;
+
+    assert(ring != NULL);
+
+    // Skip any padding records first.
+    if (ll_ring_peek(ring, &length) != NULL || ll_ring_empty(ring))
+    {
+        return NULL;
+    }
+
+    header = header_at(ring, LL_ATOMIC_LOAD_RELAXED(&ring->tail));
+    return (*(volatile uint32_t *) &header->size != 0) ? header + 1 : NULL;
+}
+
+/// Abandon the oldest record, which has been reserved but not committed.
+void ll_ring_abandon(struct ll_ring *ring, void *record)
+{
+    struct header *header = (struct header *) record - 1;
+
+    assert(ring != NULL);
+    assert(record != NULL);
+    assert(header == header_at(ring, LL_ATOMIC_LOAD_RELAXED(&ring->tail)));
+    LL_UNUSED(ring);
+
+    LL_ATOMIC_STORE_RELEASE(&header->state, STATE_PADDING);
+}
+
+/// Determine whether any records are reserved or waiting in the ring.
+int ll_ring_empty(struct ll_ring *ring)
+{
+    assert(ring != NULL);
+    return LL_ATOMIC_LOAD_ACQUIRE(&ring->tail) == LL_ATOMIC_LOAD_ACQUIRE(&ring->head);
+}
@@ -0,0 +1,592 @@
+/**
+ * @file        target_direct.c
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       Direct I/O log file target implementation.
+ */
+#ifndef _GNU_SOURCE
+/// O_DIRECT is a GNU extension on Linux.
+#   define _GNU_SOURCE
+#endif
+
+#include "ll_target_direct.h"
+
+#include "common.h"
+#include "target_file.h"
+
+#if HAVE_WRITEV
+#   include <assert.h>
+#   include <errno.h>
+#   include <fcntl.h>
+#   include <stdint.h>
+#   include <string.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+
+/// Number of bytes written after each message: a newline in text mode, nothing for compact records.
+#   if LL_COMPACT
+#       define TRAILER_LENGTH 0
+#   else
+#       define TRAILER_LENGTH 1
+#   endif
+
+/// Report an error from the target.
+#   if LL_LOCATION
+#       define REPORT(err) post_error((err), NULL, 0)
+#   else
+#       define REPORT(err) post_error(err)
+#   endif
+
+/// Write out full blocks on a helper thread, if threads are available.
+#   if LL_THREADING && defined(LL_THREAD_START)
+#       define HELPER 1
+#   else
+#       define HELPER 0
+#   endif
+
+/// Set up states.
+#   define STATE_NONE       0   ///< The target has not been set up yet.
+#   define STATE_DIRECT     1   ///< Messages are gathered in aligned blocks.
+#   define STATE_FALLBACK   2   ///< The buffer is too small for two blocks, so the target acts as a
+                                ///< file target.
+
+/// Round a size up to a multiple of the alignment.
+#   define ALIGN_UP(n) (((n) + LL_DIRECT_ALIGN - 1) / LL_DIRECT_ALIGN * LL_DIRECT_ALIGN)
+
+/// Round a size down to a multiple of the alignment.
+#   define ALIGN_DOWN(n) ((n) / LL_DIRECT_ALIGN * LL_DIRECT_ALIGN)
+
+/// Start of a block.
+#   define BLOCK(direct, index) ((direct)->blocks + (size_t) (index) * (direct)->block_size)
+
+#   if HELPER
+/// Helper thread states.
+enum helper_state
+{
+    HELPER_STOPPED, ///< The thread has not been started.
+    HELPER_RUNNING, ///< The thread is running.
+    HELPER_FAILED   ///< The thread could not be started, so blocks are written as they fill.
+};
+
+/// Mutex protecting the helper thread state and the pending writes of the targets.
+static ll_mutex             helper_mutex = LL_STATIC_MUTEX_INIT;
+/// Condition signalled when a block is pending.
+static ll_cond              helper_wake = LL_STATIC_COND_INIT;
+/// Condition signalled when a pending block has been written.
+static ll_cond              helper_done = LL_STATIC_COND_INIT;
+/// Helper thread handle.
+static ll_thread            helper_thread;
+/// Helper thread state.
+static enum helper_state    helper_state;
+/// Targets known to the helper thread.
+static struct ll_direct_target *helper_targets;
+#   endif /* end HELPER */
+
+/// Write out data at a file offset.
+static void write_at(int fd, const char *data, size_t length, uint64_t offset)
+{
+    ssize_t n;
+
+    while (length > 0)
+    {
+        n = pwrite(fd, data, length, (off_t) offset);
+        if (n <= 0)
+        {
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            REPORT("Failed to write log file!");
+            return;
+        }
+        data    += n;
+        length  -= (size_t) n;
+        offset  += (uint64_t) n;
+    }
+}
+
+/// Write out the pending write of a block.
+static void write_block(struct ll_direct_target *direct, unsigned int block)
+{
+    write_at(direct->file.fd, BLOCK(direct, block) + direct->starts[block], direct->lengths[block],
+             direct->offsets[block]);
+}
+
+#   if HELPER
+/// Helper thread, which writes out full blocks.
+static LL_THREAD_FUNC(helper, arg)
+{
+    struct ll_direct_target *direct;
+    unsigned int             block = 0;
+
+    LL_UNUSED(arg);
+
+    LL_LOCK(&helper_mutex);
+    for (;;)
+    {
+        for (direct = helper_targets; direct != NULL; direct = direct->link)
+        {
+            if (direct->lengths[0] != 0 || direct->lengths[1] != 0)
+            {
+                block = (direct->lengths[0] != 0) ? 0 : 1;
+                break;
+            }
+        }
+        if (direct == NULL)
+        {
+            LL_COND_WAIT(&helper_wake, &helper_mutex);
+            continue;
+        }
+
+        LL_UNLOCK(&helper_mutex);
+        write_block(direct, block);
+        LL_LOCK(&helper_mutex);
+        direct->lengths[block] = 0;
+        LL_COND_BROADCAST(&helper_done);
+    }
+
+    LL_THREAD_RETURN;
+}
+#   endif /* end HELPER */
+
+/// Wait until the pending writes of a target have completed.
+static void wait_idle(struct ll_direct_target *direct)
+{
+#   if HELPER
+    LL_LOCK(&helper_mutex);
+    while (direct->lengths[0] != 0 || direct->lengths[1] != 0)
+    {
+        LL_COND_WAIT(&helper_done, &helper_mutex);
+    }
+    LL_UNLOCK(&helper_mutex);
+#   else /* !HELPER */
+    LL_UNUSED(direct);
+#   endif /* end !HELPER */
+}
+
+/**
+ * Read back the last partial block of the file, so that messages are appended after it.
+ *
+ * @retval  NULL        The file end was found.
+ * @retval  non-NULL    An error occured.  The returned value is a constant string describing the
+ *                      error.
+ */
+static const char *find_end(struct ll_direct_target *direct)
+{
+    struct stat info;
+    uint64_t    end;
+    size_t      tail;
+
+    if (fstat(direct->file.fd, &info) != 0)
+    {
+        return "Failed to read log file size!";
+    }
+    end             = (uint64_t) info.st_size;
+    direct->offset  = ALIGN_DOWN(end);
+#   if !LL_COMPACT
+    // Look for padding left in the last block if the target was not closed.
+    if (direct->offset == end && end > 0)
+    {
+        direct->offset -= LL_DIRECT_ALIGN;
+    }
+#   endif
+    tail = (size_t) (end - direct->offset);
+
+    if (tail > 0)
+    {
+        if (pread(direct->file.fd, direct->blocks, tail, (off_t) direct->offset) != (ssize_t) tail)
+        {
+            // Carry on after the end of the file, leaving a gap.
+            direct->offset = ALIGN_UP(end);
+            return "Failed to read log file!";
+        }
+#   if !LL_COMPACT
+        while (tail > 0 && direct->blocks[tail - 1] == '\0')
+        {
+            --tail;
+        }
+#   endif
+    }
+    direct->file.used   = tail;
+    direct->flushed     = tail;
+
+    return NULL;
+}
+
+/// Set up a target the first time it is used.  The target must be locked by the caller.
+static void setup(struct ll_direct_target *direct)
+{
+    uintptr_t   start = ALIGN_UP((uintptr_t) direct->file.buffer);
+    size_t      skip = (size_t) (start - (uintptr_t) direct->file.buffer);
+    const char *err;
+    int         flags;
+
+    direct->block_size = (skip < direct->file.size) ? ALIGN_DOWN((direct->file.size - skip) / 2) :
+                                                      0;
+    if (direct->block_size == 0)
+    {
+        direct->state = STATE_FALLBACK;
+        return;
+    }
+    direct->blocks  = (char *) start;
+    direct->current = 0;
+
+    err = find_end(direct);
+    if (err != NULL)
+    {
+        REPORT(err);
+    }
+
+    // Blocks are written at explicit offsets, which O_APPEND would override.
+    flags = fcntl(direct->file.fd, F_GETFL);
+    if (flags != -1)
+    {
+        flags &= ~O_APPEND;
+#   ifdef O_DIRECT
+        // Carry on through the page cache if the file system does not support direct I/O.
+        if (fcntl(direct->file.fd, F_SETFL, flags | O_DIRECT) != 0)
+#   endif
+        {
+            fcntl(direct->file.fd, F_SETFL, flags);
+        }
+    }
+#   if !defined(O_DIRECT) && defined(F_NOCACHE)
+    fcntl(direct->file.fd, F_NOCACHE, 1);
+#   endif
+
+#   if HELPER
+    LL_LOCK(&helper_mutex);
+    direct->link    = helper_targets;
+    helper_targets  = direct;
+    if (helper_state == HELPER_STOPPED)
+    {
+        helper_state = (LL_THREAD_START(&helper_thread, &helper, NULL) == 0) ? HELPER_RUNNING :
+                                                                                HELPER_FAILED;
+    }
+    LL_UNLOCK(&helper_mutex);
+#   endif
+
+    direct->state = STATE_DIRECT;
+}
+
+/**
+ * Set up a target the first time it is used.  The target must be locked by the caller.
+ *
+ * @return Non-zero if messages are gathered in aligned blocks, or zero if the target acts as a file
+ *         target.
+ */
+static int ready(struct ll_direct_target *direct)
+{
+    if (direct->state == STATE_NONE)
+    {
+        setup(direct);
+    }
+    return direct->state == STATE_DIRECT;
+}
+
+/**
+ * Hand the full current block over to be written out, and move on to the other one, waiting for it
+ * to be free.  The target must be locked by the caller.
+ */
+static void next_block(struct ll_direct_target *direct)
+{
+    unsigned int block = direct->current;
+
+    // Part of the block may already have been written out by a flush.
+    direct->starts[block]   = ALIGN_DOWN(direct->flushed);
+    direct->offsets[block]  = direct->offset + direct->starts[block];
+
+    direct->current     = block ^ 1;
+    direct->offset     += direct->block_size;
+    direct->flushed     = 0;
+    direct->file.used   = 0;
+
+#   if HELPER
+    LL_LOCK(&helper_mutex);
+    direct->lengths[block] = direct->block_size - direct->starts[block];
+    if (helper_state == HELPER_RUNNING)
+    {
+        LL_COND_SIGNAL(&helper_wake);
+        while (direct->lengths[direct->current] != 0)
+        {
+            LL_COND_WAIT(&helper_done, &helper_mutex);
+        }
+        LL_UNLOCK(&helper_mutex);
+        return;
+    }
+    LL_UNLOCK(&helper_mutex);
+#   else /* !HELPER */
+    direct->lengths[block] = direct->block_size - direct->starts[block];
+#   endif /* end !HELPER */
+
+    write_block(direct, block);
+    direct->lengths[block] = 0;
+}
+
+/// Copy data into the blocks, moving on to the next block whenever one fills.
+static void copy(struct ll_direct_target *direct, const char *data, size_t length)
+{
+    size_t n;
+
+    while (length > 0)
+    {
+        n = direct->block_size - direct->file.used;
+        if (n > length)
+        {
+            n = length;
+        }
+        memcpy(BLOCK(direct, direct->current) + direct->file.used, data, n);
+        direct->file.used   += n;
+        data                += n;
+        length              -= n;
+        if (direct->file.used == direct->block_size)
+        {
+            next_block(direct);
+        }
+    }
+}
+
+/**
+ * Write out everything gathered so far, padding the partial block to the alignment, and wait until
+ * it has been written.  The target must be locked by the caller.
+ */
+static void write_out(struct ll_direct_target *direct)
+{
+    char   *block = BLOCK(direct, direct->current);
+    size_t  start = ALIGN_DOWN(direct->flushed);
+    size_t  end = ALIGN_UP(direct->file.used);
+
+    wait_idle(direct);
+    if (direct->file.used > direct->flushed)
+    {
+        memset(block + direct->file.used, 0, end - direct->file.used);
+        write_at(direct->file.fd, block + start, end - start, direct->offset + start);
+        direct->flushed = direct->file.used;
+    }
+}
+
+/// Send function of the direct I/O target.
+void _ll_direct_send
+(
+    struct ll_target    *target,
+    enum ll_level        level,
+    ll_timestamp_t       timestamp,
+    const char          *message,
+    size_t               length
+)
+{
+    struct ll_direct_target *direct = (struct ll_direct_target *) target;
+    int                      due;
+
+    assert(direct != NULL);
+    assert(message != NULL);
+
+    LOCK(&direct->file);
+    if (!ready(direct))
+    {
+        file_append(&direct->file, level, timestamp, message, length);
+        UNLOCK(&direct->file);
+        return;
+    }
+
+    due = file_due(&direct->file, level, timestamp, direct->file.used == direct->flushed);
+    copy(direct, message, length);
+#   if !LL_COMPACT
+    copy(direct, "\n", 1);
+#   endif
+    if (due)
+    {
+        write_out(direct);
+    }
+    UNLOCK(&direct->file);
+}
+
+/// Reserve function of the direct I/O target.  The target stays locked until the commit.
+char *_ll_direct_reserve(struct ll_target *target, size_t size)
+{
+    struct ll_direct_target *direct = (struct ll_direct_target *) target;
+
+    assert(direct != NULL);
+
+    LOCK(&direct->file);
+    if (!ready(direct))
+    {
+        UNLOCK(&direct->file);
+        return _ll_file_reserve(target, size);
+    }
+    if (size > direct->block_size - direct->file.used)
+    {
+        // The message may need to be split across blocks.
+        UNLOCK(&direct->file);
+        return NULL;
+    }
+    return BLOCK(direct, direct->current) + direct->file.used;
+}
+
+/// Commit function of the direct I/O target.
+void _ll_direct_commit
+(
+    struct ll_target    *target,
+    enum ll_level        level,
+    ll_timestamp_t       timestamp,
+    char                *message,
+    size_t               length
+)
+{
+    struct ll_direct_target *direct = (struct ll_direct_target *) target;
+    int                      due;
+
+    assert(direct != NULL);
+
+    if (direct->state != STATE_DIRECT)
+    {
+        _ll_file_commit(target, level, timestamp, message, length);
+        return;
+    }
+
+    assert(message == BLOCK(direct, direct->current) + direct->file.used);
+    if (length > 0)
+    {
+#   if LL_COMPACT
+        LL_UNUSED(message);
+#   else
+        // The message terminator becomes the newline.
+        message[length] = '\n';
+#   endif
+        due = file_due(&direct->file, level, timestamp, direct->file.used == direct->flushed);
+        direct->file.used += length + TRAILER_LENGTH;
+        if (direct->file.used == direct->block_size)
+        {
+            next_block(direct);
+        }
+        if (due)
+        {
+            write_out(direct);
+        }
+    }
+    UNLOCK(&direct->file);
+}
+
+/// Flush function of the direct I/O target.
+void _ll_direct_flush(struct ll_target *target)
+{
+    struct ll_direct_target *direct = (struct ll_direct_target *) target;
+
+    assert(direct != NULL);
+
+    LOCK(&direct->file);
+    if (direct->state == STATE_DIRECT)
+    {
+        write_out(direct);
+    }
+    else
+    {
+        file_write_out(&direct->file);
+    }
+    UNLOCK(&direct->file);
+}
+
+/**
+ * Copy data into the current block from a signal handler, writing the block out synchronously and
+ * reusing it whenever it fills, so that the other block, which the helper thread may be writing, is
+ * left alone.
+ */
+static void emergency_copy(struct ll_direct_target *direct, const char *data, size_t length)
+{
+    char   *block = BLOCK(direct, direct->current);
+    size_t  start;
+    size_t  n;
+
+    while (length > 0)
+    {
+        n = direct->block_size - direct->file.used;
+        if (n > length)
+        {
+            n = length;
+        }
+        memcpy(block + direct->file.used, data, n);
+        direct->file.used   += n;
+        data                += n;
+        length              -= n;
+        if (direct->file.used == direct->block_size)
+        {
+            start = ALIGN_DOWN(direct->flushed);
+            emergency_pwrite(direct->file.fd, block + start, direct->block_size - start,
+                             direct->offset + start);
+            direct->offset     += direct->block_size;
+            direct->file.used   = 0;
+            direct->flushed     = 0;
+        }
+    }
+}
+
+/**
+ * Emergency function of the direct I/O target.  The target is not locked.  Blocks which the helper
+ * thread may still be writing are written again, which is harmless as they go to the same offsets.
+ */
+void _ll_direct_emergency(struct ll_target *target, const char *message, size_t length)
+{
+    struct ll_direct_target *direct = (struct ll_direct_target *) target;
+    char                    *block;
+    size_t                   start;
+    size_t                   end;
+    unsigned int             i;
+
+    if (direct == NULL || direct->state != STATE_DIRECT)
+    {
+        _ll_file_emergency(target, message, length);
+        return;
+    }
+
+    for (i = 0; i < 2; ++i)
+    {
+        if (direct->lengths[i] != 0)
+        {
+            emergency_pwrite(direct->file.fd, BLOCK(direct, i) + direct->starts[i],
+                             direct->lengths[i], direct->offsets[i]);
+        }
+    }
+
+    if (message != NULL)
+    {
+        emergency_copy(direct, message, length);
+#   if !LL_COMPACT
+        emergency_copy(direct, "\n", 1);
+#   endif
+    }
+
+    if (direct->file.used > direct->flushed)
+    {
+        block   = BLOCK(direct, direct->current);
+        start   = ALIGN_DOWN(direct->flushed);
+        end     = ALIGN_UP(direct->file.used);
+        memset(block + direct->file.used, 0, end - direct->file.used);
+        emergency_pwrite(direct->file.fd, block + start, end - start, direct->offset + start);
+        direct->flushed = direct->file.used;
+    }
+}
+
+/// Stop writing to the file of a direct I/O target.
+void ll_direct_target_close(struct ll_direct_target *target)
+{
+    assert(target != NULL);
+
+    LOCK(&target->file);
+    if (target->state == STATE_DIRECT)
+    {
+        write_out(target);
+        if (ftruncate(target->file.fd, (off_t) (target->offset + target->file.used)) != 0)
+        {
+            REPORT("Failed to truncate log file!");
+        }
+    }
+    else
+    {
+        file_write_out(&target->file);
+    }
+    UNLOCK(&target->file);
+}
+
+#endif /* end HAVE_WRITEV */
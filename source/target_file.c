@@ -0,0 +1,400 @@
+/**
+ * @file        target_file.c
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       Buffered file log target implementation.
+ */
+#include "target_file.h"
+
+#include "common.h"
+
+#if HAVE_WRITEV
+#   include <assert.h>
+#   include <errno.h>
+#   include <string.h>
+#   include <sys/uio.h>
+#   include <unistd.h>
+
+/// Number of bytes written after each message: a newline in text mode, nothing for compact records.
+#   if LL_COMPACT
+#       define TRAILER_LENGTH 0
+#   else
+#       define TRAILER_LENGTH 1
+#   endif
+
+/// Write out a set of buffers completely, retrying after partial writes and interruptions.
+static void write_all(int fd, struct iovec *iov, int count)
+{
+    ssize_t n;
+
+    for (;;)
+    {
+        // Skip buffers which have been written out entirely.
+        while (count > 0 && iov->iov_len == 0)
+        {
+            ++iov;
+            --count;
+        }
+        if (count == 0)
+        {
+            return;
+        }
+
+        n = writev(fd, iov, count);
+        if (n <= 0)
+        {
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+#   if LL_LOCATION
+            post_error("Failed to write log file!", NULL, 0);
+#   else
+            post_error("Failed to write log file!");
+#   endif
+            return;
+        }
+
+        while ((size_t) n >= iov->iov_len && count > 0)
+        {
+            n -= (ssize_t) iov->iov_len;
+            iov->iov_len = 0;
+            ++iov;
+            --count;
+        }
+        if (count > 0)
+        {
+            iov->iov_base = (char *) iov->iov_base + n;
+            iov->iov_len -= (size_t) n;
+        }
+    }
+}
+
+/**
+ * Write out the buffer, followed by a message which did not fit in it, with a single system call.
+ * The target must be locked by the caller.
+ */
+static void write_buffer
+(
+    struct ll_file_target   *file,      ///< [in] File target.
+    const char              *message,   ///< [in] Message to write after the buffer, or NULL.
+    size_t                   length     ///< [in] Message length in bytes.
+)
+{
+    struct iovec    iov[3];
+    int             count = 0;
+
+    iov[count].iov_base     = file->buffer;
+    iov[count++].iov_len    = file->used;
+    if (message != NULL)
+    {
+        iov[count].iov_base     = (void *) message;
+        iov[count++].iov_len    = length;
+#   if !LL_COMPACT
+        iov[count].iov_base     = (void *) "\n";
+        iov[count++].iov_len    = 1;
+#   endif
+    }
+
+    write_all(file->fd, iov, count);
+    file->used = 0;
+}
+
+/**
+ * Write out the buffer, followed by as many of a batch of messages as fit in one system call.  The
+ * target must be locked by the caller.
+ *
+ * @return The number of messages written out.
+ */
+static size_t write_gathered
+(
+    struct ll_file_target   *file,      ///< [in] File target.
+    const struct ll_record  *records,   ///< [in] Messages to write after the buffer.
+    size_t                   count      ///< [in] Number of messages.
+)
+{
+    struct iovec    iov[1 + 2 * LL_BATCH_SIZE];
+    int             n = 0;
+    size_t          i;
+
+    iov[n].iov_base     = file->buffer;
+    iov[n++].iov_len    = file->used;
+    for (i = 0; i < count && i < LL_BATCH_SIZE; ++i)
+    {
+        iov[n].iov_base     = (void *) records[i].message;
+        iov[n++].iov_len    = records[i].length;
+#   if !LL_COMPACT
+        iov[n].iov_base     = (void *) "\n";
+        iov[n++].iov_len    = 1;
+#   endif
+    }
+
+    write_all(file->fd, iov, n);
+    file->used = 0;
+    return i;
+}
+
+/**
+ * Account for a message just placed in the buffer, and write the buffer out if the message calls
+ * for it.  The target must be locked by the caller.
+ */
+static void append
+(
+    struct ll_file_target   *file,      ///< [in] File target.
+    enum ll_level            level,     ///< [in] Message level.
+    ll_timestamp_t           timestamp, ///< [in] Message time stamp.
+    size_t                   length     ///< [in] Message length in bytes, excluding the trailer.
+)
+{
+    int due = file_due(file, level, timestamp, file->used == 0);
+
+    file->used += length + TRAILER_LENGTH;
+    if (due)
+    {
+        write_buffer(file, NULL, 0);
+    }
+}
+
+/// Decide whether a message calls for the buffer of a file target to be written out.
+int file_due(struct ll_file_target *file, enum ll_level level, ll_timestamp_t timestamp, int empty)
+{
+    assert(file != NULL);
+
+    if (empty)
+    {
+        file->oldest = timestamp;
+    }
+
+    return level <= file->flush_level || timestamp - file->oldest >= file->delay;
+}
+
+/// Add a message to the buffer of a file target.
+void file_append
+(
+    struct ll_file_target   *file,
+    enum ll_level            level,
+    ll_timestamp_t           timestamp,
+    const char              *message,
+    size_t                   length
+)
+{
+    assert(file != NULL);
+    assert(message != NULL);
+
+    if (length + TRAILER_LENGTH > file->size - file->used)
+    {
+        // Write the buffer and the message together.
+        write_buffer(file, message, length);
+    }
+    else
+    {
+        memcpy(file->buffer + file->used, message, length);
+#   if !LL_COMPACT
+        file->buffer[file->used + length] = '\n';
+#   endif
+        append(file, level, timestamp, length);
+    }
+}
+
+/// Write out the buffer of a file target.
+void file_write_out(struct ll_file_target *file)
+{
+    assert(file != NULL);
+
+    if (file->used > 0)
+    {
+        write_buffer(file, NULL, 0);
+    }
+}
+
+/// Write out data with raw write system calls, ignoring errors.
+void emergency_write(int fd, const char *data, size_t length)
+{
+    ssize_t n;
+
+    while (length > 0)
+    {
+        n = write(fd, data, length);
+        if (n <= 0)
+        {
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            return;
+        }
+        data    += n;
+        length  -= (size_t) n;
+    }
+}
+
+/// Write out data at a file offset with raw pwrite system calls, ignoring errors.
+void emergency_pwrite(int fd, const char *data, size_t length, uint64_t offset)
+{
+    ssize_t n;
+
+    while (length > 0)
+    {
+        n = pwrite(fd, data, length, (off_t) offset);
+        if (n <= 0)
+        {
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            return;
+        }
+        data    += n;
+        length  -= (size_t) n;
+        offset  += (uint64_t) n;
+    }
+}
+
+/// Send function of the buffered file target.
+void _ll_file_send
+(
+    struct ll_target    *target,
+    enum ll_level        level,
+    ll_timestamp_t       timestamp,
+    const char          *message,
+    size_t               length
+)
+{
+    struct ll_file_target *file = (struct ll_file_target *) target;
+
+    LOCK(file);
+    file_append(file, level, timestamp, message, length);
+    UNLOCK(file);
+}
+
+/// Batch send function of the buffered file target.
+void _ll_file_send_batch(struct ll_target *target, const struct ll_record *records, size_t count)
+{
+    struct ll_file_target  *file = (struct ll_file_target *) target;
+    size_t                  i = 0;
+    int                     due = 0;
+
+    assert(file != NULL);
+    assert(records != NULL);
+
+    LOCK(file);
+    while (i < count)
+    {
+        if (records[i].length + TRAILER_LENGTH <= file->size - file->used)
+        {
+            due |= file_due(file, records[i].level, records[i].timestamp, file->used == 0);
+            memcpy(file->buffer + file->used, records[i].message, records[i].length);
+#   if !LL_COMPACT
+            file->buffer[file->used + records[i].length] = '\n';
+#   endif
+            file->used += records[i].length + TRAILER_LENGTH;
+            ++i;
+        }
+        else
+        {
+            // Write the buffer and the rest of the batch together, rather than filling it again.
+            i += write_gathered(file, records + i, count - i);
+            due = 0;
+        }
+    }
+    if (due)
+    {
+        write_buffer(file, NULL, 0);
+    }
+    UNLOCK(file);
+}
+
+/// Reserve function of the buffered file target.  The target stays locked until the commit.
+char *_ll_file_reserve(struct ll_target *target, size_t size)
+{
+    struct ll_file_target *file = (struct ll_file_target *) target;
+
+    assert(file != NULL);
+
+    if (size > file->size)
+    {
+        return NULL;
+    }
+
+    LOCK(file);
+    if (size > file->size - file->used)
+    {
+        write_buffer(file, NULL, 0);
+    }
+    return file->buffer + file->used;
+}
+
+/// Commit function of the buffered file target.
+void _ll_file_commit
+(
+    struct ll_target    *target,
+    enum ll_level        level,
+    ll_timestamp_t       timestamp,
+    char                *message,
+    size_t               length
+)
+{
+    struct ll_file_target *file = (struct ll_file_target *) target;
+
+    assert(file != NULL);
+    assert(message == file->buffer + file->used);
+
+    if (length > 0)
+    {
+#   if LL_COMPACT
+        LL_UNUSED(message);
+#   else
+        // The message terminator becomes the newline.
+        message[length] = '\n';
+#   endif
+        append(file, level, timestamp, length);
+    }
+    UNLOCK(file);
+}
+
+/// Flush function of the buffered file target.
+void _ll_file_flush(struct ll_target *target)
+{
+    struct ll_file_target *file = (struct ll_file_target *) target;
+
+    assert(file != NULL);
+
+    LOCK(file);
+    file_write_out(file);
+    UNLOCK(file);
+}
+
+/// Emergency function of the buffered file target.  The target is not locked.
+void _ll_file_emergency(struct ll_target *target, const char *message, size_t length)
+{
+    struct ll_file_target *file = (struct ll_file_target *) target;
+
+    if (file == NULL || file->fd < 0)
+    {
+        return;
+    }
+
+    if (message != NULL && length + TRAILER_LENGTH <= file->size - file->used)
+    {
+        memcpy(file->buffer + file->used, message, length);
+#   if !LL_COMPACT
+        file->buffer[file->used + length] = '\n';
+#   endif
+        file->used += length + TRAILER_LENGTH;
+        message = NULL;
+    }
+
+    emergency_write(file->fd, file->buffer, file->used);
+    file->used = 0;
+    if (message != NULL)
+    {
+        emergency_write(file->fd, message, length);
+#   if !LL_COMPACT
+        emergency_write(file->fd, "\n", 1);
+#   endif
+    }
+}
+
+#endif /* end HAVE_WRITEV */
@@ -0,0 +1,73 @@
+/**
+ * @file        target_file.h
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       Buffered file target operations shared with targets built on it.
+ */
+#ifndef TARGET_FILE_H_
+#define TARGET_FILE_H_
+
+#include "ll_target_file.h"
+
+/**
+ * Add a message to the buffer of a file target, writing the buffer out if it is full or the
+ * message calls for it.  The target must be locked by the caller.
+ */
+void file_append
+(
+    struct ll_file_target   *file,      ///< [in] File target.
+    enum ll_level            level,     ///< [in] Message level.
+    ll_timestamp_t           timestamp, ///< [in] Message time stamp.
+    const char              *message,   ///< [in] Message text.
+    size_t                   length     ///< [in] Message length in bytes, excluding the terminator.
+);
+
+/**
+ * Decide whether a message calls for the buffer of a file target to be written out, because of its
+ * level or because the oldest buffered message has waited for the flush delay.
+ *
+ * @return Non-zero if the buffer is due to be written out once the message has been added.
+ */
+int file_due
+(
+    struct ll_file_target   *file,      ///< [in] File target.
+    enum ll_level            level,     ///< [in] Message level.
+    ll_timestamp_t           timestamp, ///< [in] Message time stamp.
+    int                      empty      ///< [in] Non-zero if nothing is waiting to be written out,
+                                        ///<      so that the message becomes the oldest.
+);
+
+/**
+ * Write out the buffer of a file target.  The target must be locked by the caller.
+ */
+void file_write_out
+(
+    struct ll_file_target   *file       ///< [in] File target.
+);
+
+/**
+ * Write out data with raw write() calls, retrying after partial writes and interruptions and
+ * ignoring errors, as is safe in a signal handler.
+ */
+void emergency_write
+(
+    int              fd,        ///< [in] File descriptor.
+    const char      *data,      ///< [in] Data to write.
+    size_t           length     ///< [in] Length of the data in bytes.
+);
+
+/**
+ * Write out data at a file offset with raw pwrite() calls, retrying after partial writes and
+ * interruptions and ignoring errors, as is safe in a signal handler.
+ */
+void emergency_pwrite
+(
+    int              fd,        ///< [in] File descriptor.
+    const char      *data,      ///< [in] Data to write.
+    size_t           length,    ///< [in] Length of the data in bytes.
+    uint64_t         offset     ///< [in] File offset to write at.
+);
+
+#endif /* end TARGET_FILE_H_ */
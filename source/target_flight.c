@@ -0,0 +1,310 @@
+/**
+ * @file        target_flight.c
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       Flight recorder log target implementation.
+ *
+ * Positions are free-running 32-bit counters which are masked to obtain offsets into the buffer.
+ * Each message is stored as a record header followed by the message, padded to a multiple of 8
+ * bytes, and may wrap around the end of the buffer.  A producer claims space by advancing the head,
+ * fills in the record, and publishes it by storing the complement of its position in the header.
+ *
+ * Record boundaries are not tracked, so a dump finds them by scanning from the oldest position
+ * which may still hold a message for a header naming its own position.  A record is only valid if
+ * the head has not advanced a whole buffer past it by the time it has been copied out.  Records are
+ * copied out into a batch, which is handed to the downstream targets in one call.
+ */
+#include "ll_target_flight.h"
+
+#include "common.h"
+
+#include <assert.h>
+#include <string.h>
+
+/// Round a length up to a multiple of 8 bytes.
+#define ALIGN(n) (((n) + 7) & ~(size_t) 7)
+
+/// Size of the buffer messages are copied out into during a dump, in bytes.
+#define BATCH_TEXT_SIZE (4 * LL_MAX_MESSAGE_SIZE)
+
+/// Record header.
+struct record
+{
+    uint32_t             start;     ///< Position of the record.
+    volatile uint32_t    check;     ///< Complement of the position once the record is complete.
+    uint32_t             length;    ///< Message length in bytes, excluding the terminator.
+    uint32_t             level;     ///< Message level.
+    ll_timestamp_t       timestamp; ///< Message time stamp.
+};
+
+/// Get a pointer to the first 8 bytes of the record header at a position, which never wrap.
+static struct record *record_at(struct ll_flight_target *flight, uint32_t position)
+{
+    return (struct record *) ((char *) flight->buffer + (position & (flight->size - 1)));
+}
+
+/// Copy data into the buffer at a position, wrapping around its end.
+static void copy_in(struct ll_flight_target *flight, uint32_t position, const void *data,
+                    size_t length)
+{
+    size_t offset = position & (flight->size - 1);
+    size_t n = flight->size - offset;
+
+    if (n > length)
+    {
+        n = length;
+    }
+    memcpy((char *) flight->buffer + offset, data, n);
+    memcpy(flight->buffer, (const char *) data + n, length - n);
+}
+
+/// Copy data out of the buffer from a position, wrapping around its end.
+static void copy_out(struct ll_flight_target *flight, uint32_t position, void *data, size_t length)
+{
+    size_t offset = position & (flight->size - 1);
+    size_t n = flight->size - offset;
+
+    if (n > length)
+    {
+        n = length;
+    }
+    memcpy(data, (const char *) flight->buffer + offset, n);
+    memcpy((char *) data + n, flight->buffer, length - n);
+}
+
+/**
+ * Copy out the complete record at a position, if there is one.
+ *
+ * @return The size of the record in the buffer, or zero if there is no complete record at the
+ *         position.
+ */
+static uint32_t read_record
+(
+    struct ll_flight_target *flight,    ///< [in]  Flight recorder target.
+    uint32_t                 position,  ///< [in]  Position to read from.
+    uint32_t                 head,      ///< [in]  Head position when the dump started.
+    struct record           *header,    ///< [out] Record header.
+    char                    *message    ///< [out] Buffer of LL_MAX_MESSAGE_SIZE bytes for the
+                                        ///<       message, which is terminated.
+)
+{
+    struct record  *record = record_at(flight, position);
+    uint32_t        size;
+
+    if (LL_ATOMIC_LOAD_ACQUIRE(&record->check) != ~position || record->start != position)
+    {
+        return 0;
+    }
+    copy_out(flight, position, header, sizeof(*header));
+    size = (uint32_t) (sizeof(*header) + ALIGN(header->length));
+    if (header->length >= LL_MAX_MESSAGE_SIZE || size > head - position)
+    {
+        return 0;
+    }
+    copy_out(flight, position + (uint32_t) sizeof(*header), message, header->length);
+    message[header->length] = '\0';
+
+    // Make sure that no producer has started to overwrite the record while it was copied.
+    LL_ATOMIC_FENCE();
+    if (LL_ATOMIC_LOAD_ACQUIRE(&flight->head) - position > flight->size)
+    {
+        return 0;
+    }
+
+    return size;
+}
+
+/// Add a message to the buffer, unless it is too long.
+static void store
+(
+    struct ll_flight_target *flight,    ///< [in] Flight recorder target.
+    enum ll_level            level,     ///< [in] Message level.
+    ll_timestamp_t           timestamp, ///< [in] Message time stamp.
+    const char              *message,   ///< [in] Message text.
+    size_t                   length     ///< [in] Message length in bytes, excluding the terminator.
+)
+{
+    struct record    header;
+    struct record   *record;
+    uint32_t         position;
+
+    if (length >= flight->size / 2 - sizeof(header) || length >= LL_MAX_MESSAGE_SIZE)
+    {
+        return;
+    }
+
+    position = LL_ATOMIC_FETCH_ADD(&flight->head, (uint32_t) (sizeof(header) + ALIGN(length)));
+
+    header.start        = position;
+    header.check        = 0;
+    header.length       = (uint32_t) length;
+    header.level        = (uint32_t) level;
+    header.timestamp    = timestamp;
+
+    // The old check value is cleared before anything else is overwritten, so that whatever was
+    // there before is no longer valid, even if its bytes happen to match the new position.
+    record = record_at(flight, position);
+    LL_ATOMIC_STORE_RELEASE(&record->check, 0);
+    LL_ATOMIC_FENCE();
+    record->start = position;
+    copy_in(flight, position + 8, &header.length, sizeof(header) - 8);
+    copy_in(flight, position + (uint32_t) sizeof(header), message, length);
+    LL_ATOMIC_STORE_RELEASE(&record->check, ~position);
+}
+
+/// Pass a batch of messages copied out of the buffer to the downstream targets.
+static void pass_on
+(
+    struct ll_flight_target *flight,    ///< [in] Flight recorder target.
+    const struct ll_record  *batch,     ///< [in] Messages to pass on.
+    size_t                   count,     ///< [in] Number of messages.
+    int                      emergency  ///< [in] Non-zero to pass the messages to the emergency
+                                        ///<      functions of the downstream targets.
+)
+{
+    struct ll_target    *downstream;
+    size_t               i;
+
+    if (!emergency)
+    {
+        ll_target_send_batch(flight->downstream, batch, count);
+        return;
+    }
+
+    for (downstream = flight->downstream; downstream != NULL; downstream = downstream->next)
+    {
+        for (i = 0; i < count && downstream->emergency != NULL; ++i)
+        {
+            downstream->emergency(downstream, batch[i].message, batch[i].length);
+        }
+    }
+}
+
+/**
+ * Pass the messages in the buffer which have not been dumped before to the downstream targets.  The
+ * target must be locked by the caller, unless this is an emergency.
+ */
+static void dump
+(
+    struct ll_flight_target *flight,    ///< [in] Flight recorder target.
+    int                      emergency  ///< [in] Non-zero to pass the messages to the emergency
+                                        ///<      functions of the downstream targets.
+)
+{
+    struct ll_record     batch[LL_BATCH_SIZE];
+    struct record        header;
+    uint32_t             head;
+    uint32_t             position;
+    uint32_t             size;
+    size_t               count = 0;
+    size_t               used = 0;
+
+    LL_ALLOCATE_BUFFER(text, BATCH_TEXT_SIZE);
+
+    head = LL_ATOMIC_LOAD_ACQUIRE(&flight->head);
+    position = (head - flight->dumped <= flight->size) ? flight->dumped : head - flight->size;
+    while (position != head)
+    {
+        if (count == LL_BATCH_SIZE || BATCH_TEXT_SIZE - used < LL_MAX_MESSAGE_SIZE)
+        {
+            pass_on(flight, batch, count, emergency);
+            count   = 0;
+            used    = 0;
+        }
+
+        size = read_record(flight, position, head, &header, text + used);
+        if (size == 0)
+        {
+            // Incomplete or overwritten, so look for the next record.
+            position += 8;
+            continue;
+        }
+
+        batch[count].level      = (enum ll_level) header.level;
+        batch[count].timestamp  = header.timestamp;
+        batch[count].message    = text + used;
+        batch[count].length     = header.length;
+        ++count;
+        used += ALIGN(header.length + 1);
+        position += size;
+    }
+    if (count > 0)
+    {
+        pass_on(flight, batch, count, emergency);
+    }
+    flight->dumped = head;
+
+    LL_RELEASE_BUFFER(text);
+}
+
+/// Send function of the flight recorder target.
+void _ll_flight_send
+(
+    struct ll_target    *target,
+    enum ll_level        level,
+    ll_timestamp_t       timestamp,
+    const char          *message,
+    size_t               length
+)
+{
+    struct ll_flight_target *flight = (struct ll_flight_target *) target;
+
+    assert(flight != NULL);
+    assert(flight->buffer != NULL);
+    assert(flight->size >= 64 && (flight->size & (flight->size - 1)) == 0);
+    assert(message != NULL);
+
+    store(flight, level, timestamp, message, length);
+    if ((int) level <= flight->trigger_level)
+    {
+        ll_dump(flight);
+    }
+}
+
+/// Flush function of the flight recorder target.
+void _ll_flight_flush(struct ll_target *target)
+{
+    struct ll_flight_target *flight = (struct ll_flight_target *) target;
+
+    assert(flight != NULL);
+
+    ll_target_flush(flight->downstream);
+}
+
+/// Emergency function of the flight recorder target.  The target is not locked.
+void _ll_flight_emergency(struct ll_target *target, const char *message, size_t length)
+{
+    struct ll_flight_target *flight = (struct ll_flight_target *) target;
+    struct ll_target        *downstream;
+
+    if (flight == NULL)
+    {
+        return;
+    }
+
+    if (message != NULL)
+    {
+        store(flight, LL_LEVEL_FATAL, 0, message, length);
+    }
+    dump(flight, 1);
+    for (downstream = flight->downstream; downstream != NULL; downstream = downstream->next)
+    {
+        if (downstream->emergency != NULL)
+        {
+            downstream->emergency(downstream, NULL, 0);
+        }
+    }
+}
+
+/// Pass the messages in the buffer of a flight recorder target on to its downstream targets.
+void ll_dump(struct ll_flight_target *target)
+{
+    assert(target != NULL);
+
+    LOCK(target);
+    dump(target, 0);
+    ll_target_flush(target->downstream);
+    UNLOCK(target);
+}
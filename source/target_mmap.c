@@ -0,0 +1,365 @@
+/**
+ * @file        target_mmap.c
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       Memory mapped log file target implementation.
+ */
+#include "ll_target_mmap.h"
+
+#include "common.h"
+
+#if HAVE_MMAP
+#   include <assert.h>
+#   include <string.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#   if HAVE_POSIX_FALLOCATE
+#       include <fcntl.h>
+#   endif
+
+/// Number of bytes written after each message: a newline in text mode, nothing for compact records.
+#   if LL_COMPACT
+#       define TRAILER_LENGTH 0
+#   else
+#       define TRAILER_LENGTH 1
+#   endif
+
+/// Prefault the pages of each window as it is mapped, where supported.
+#   ifdef MAP_POPULATE
+#       define MAP_FLAGS (MAP_SHARED | MAP_POPULATE)
+#   else
+#       define MAP_FLAGS MAP_SHARED
+#   endif
+
+/// Report an error from the target.
+#   if LL_LOCATION
+#       define REPORT(err) post_error((err), NULL, 0)
+#   else
+#       define REPORT(err) post_error(err)
+#   endif
+
+#   if !LL_COMPACT
+/**
+ * Find the end of the text in a file, skipping the zero bytes left after the last message if the
+ * target was not closed.
+ *
+ * @return The file offset just past the last non-zero byte.
+ */
+static uint64_t find_end(int fd, uint64_t end)
+{
+    char    block[512];
+    size_t  count;
+    size_t  length;
+
+    while (end > 0)
+    {
+        count = (end < sizeof(block)) ? (size_t) end : sizeof(block);
+        if (pread(fd, block, count, (off_t) (end - count)) != (ssize_t) count)
+        {
+            break;
+        }
+        for (length = count; length > 0 && block[length - 1] == '\0'; --length)
+        {
+        }
+        if (length > 0)
+        {
+            return end - count + length;
+        }
+        end -= count;
+    }
+
+    return end;
+}
+#   endif /* end !LL_COMPACT */
+
+/**
+ * Map the window of the file which contains the end of the last message, allocating space for it in
+ * the file first.
+ *
+ * @retval  NULL        The window was mapped.
+ * @retval  non-NULL    An error occured.  The returned value is a constant string describing the
+ *                      error.
+ */
+static const char *map_window(struct ll_mmap_target *map)
+{
+    size_t  page = (size_t) sysconf(_SC_PAGESIZE);
+    void   *window;
+
+    if (map->end == LL_MMAP_APPEND)
+    {
+        struct stat info;
+
+        if (fstat(map->fd, &info) != 0)
+        {
+            return "Failed to read log file size!";
+        }
+        map->end = (uint64_t) info.st_size;
+#   if !LL_COMPACT
+        map->end = find_end(map->fd, map->end);
+#   endif
+    }
+
+    map->size = (map->chunk + page - 1) / page * page;
+    if (map->size == 0)
+    {
+        map->size = page;
+    }
+    map->base   = map->end / page * page;
+    map->used   = (size_t) (map->end - map->base);
+    map->synced = map->used;
+
+#   if HAVE_POSIX_FALLOCATE
+    if (posix_fallocate(map->fd, (off_t) map->base, (off_t) map->size) != 0)
+    {
+        return "Failed to allocate log file space!";
+    }
+#   else /* !HAVE_POSIX_FALLOCATE */
+    {
+        struct stat info;
+
+        if (fstat(map->fd, &info) != 0 ||
+            ((uint64_t) info.st_size < map->base + map->size &&
+             ftruncate(map->fd, (off_t) (map->base + map->size)) != 0))
+        {
+            return "Failed to allocate log file space!";
+        }
+    }
+#   endif /* end !HAVE_POSIX_FALLOCATE */
+
+    window = mmap(NULL, map->size, PROT_READ | PROT_WRITE, MAP_FLAGS, map->fd, (off_t) map->base);
+    if (window == MAP_FAILED)
+    {
+        return "Failed to map log file!";
+    }
+#   ifdef MADV_SEQUENTIAL
+    madvise(window, map->size, MADV_SEQUENTIAL);
+#   endif
+    map->map = (char *) window;
+
+    return NULL;
+}
+
+/// Synchronize the part of the current window written since the last synchronization.
+static void sync_window(struct ll_mmap_target *map)
+{
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    size_t start;
+
+    if (map->map != NULL && map->synced < map->used)
+    {
+        start = map->synced / page * page;
+        if (msync(map->map + start, map->used - start, MS_SYNC) != 0)
+        {
+            REPORT("Failed to synchronize log file!");
+        }
+        map->synced = map->used;
+    }
+}
+
+/// Unmap the current window, synchronizing it first if so configured.
+static void unmap_window(struct ll_mmap_target *map)
+{
+    if (map->map != NULL)
+    {
+        if (map->sync_level != LL_MMAP_NO_SYNC)
+        {
+            sync_window(map);
+        }
+        munmap(map->map, map->size);
+        map->map = NULL;
+    }
+}
+
+/**
+ * Make sure that the current window has space for another byte, mapping the next window if the
+ * current one is full.
+ *
+ * @return Non-zero if a window with space is mapped.
+ */
+static int make_space(struct ll_mmap_target *map)
+{
+    const char *err;
+
+    if (map->map != NULL && map->used == map->size)
+    {
+        unmap_window(map);
+    }
+    if (map->map == NULL)
+    {
+        err = map_window(map);
+        if (err != NULL)
+        {
+            REPORT(err);
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/// Copy data to the end of the file, spreading it across windows as needed.
+static void append(struct ll_mmap_target *map, const char *data, size_t length)
+{
+    size_t n;
+
+    while (length > 0 && make_space(map))
+    {
+        n = map->size - map->used;
+        if (n > length)
+        {
+            n = length;
+        }
+        memcpy(map->map + map->used, data, n);
+        map->used   += n;
+        map->end    += n;
+        data        += n;
+        length      -= n;
+    }
+}
+
+/// Synchronize the file after a message, if its level calls for it.
+static void finish(struct ll_mmap_target *map, enum ll_level level)
+{
+    if ((int) level <= map->sync_level)
+    {
+        sync_window(map);
+    }
+}
+
+/// Send function of the memory mapped target.
+void _ll_mmap_send
+(
+    struct ll_target    *target,
+    enum ll_level        level,
+    ll_timestamp_t       timestamp,
+    const char          *message,
+    size_t               length
+)
+{
+    struct ll_mmap_target *map = (struct ll_mmap_target *) target;
+
+    assert(map != NULL);
+    assert(message != NULL);
+
+    LL_UNUSED(timestamp);
+
+    LOCK(map);
+    append(map, message, length);
+#   if !LL_COMPACT
+    append(map, "\n", 1);
+#   endif
+    finish(map, level);
+    UNLOCK(map);
+}
+
+/// Reserve function of the memory mapped target.  The target stays locked until the commit.
+char *_ll_mmap_reserve(struct ll_target *target, size_t size)
+{
+    struct ll_mmap_target *map = (struct ll_mmap_target *) target;
+
+    assert(map != NULL);
+
+    LOCK(map);
+    if (!make_space(map) || size > map->size - map->used)
+    {
+        // The message may need to be split across windows.
+        UNLOCK(map);
+        return NULL;
+    }
+    return map->map + map->used;
+}
+
+/// Commit function of the memory mapped target.
+void _ll_mmap_commit
+(
+    struct ll_target    *target,
+    enum ll_level        level,
+    ll_timestamp_t       timestamp,
+    char                *message,
+    size_t               length
+)
+{
+    struct ll_mmap_target *map = (struct ll_mmap_target *) target;
+
+    assert(map != NULL);
+    assert(message == map->map + map->used);
+
+    LL_UNUSED(timestamp);
+
+    if (length > 0)
+    {
+#   if LL_COMPACT
+        LL_UNUSED(message);
+#   else
+        // The message terminator becomes the newline.
+        message[length] = '\n';
+#   endif
+        map->used   += length + TRAILER_LENGTH;
+        map->end    += length + TRAILER_LENGTH;
+        finish(map, level);
+    }
+    else
+    {
+        // Clear out the discarded message, so that it is not mistaken for data after a crash.
+        memset(message, 0, LL_MAX_MESSAGE_SIZE);
+    }
+    UNLOCK(map);
+}
+
+/// Flush function of the memory mapped target, which synchronizes the file with storage.
+void _ll_mmap_flush(struct ll_target *target)
+{
+    struct ll_mmap_target *map = (struct ll_mmap_target *) target;
+
+    assert(map != NULL);
+
+    LOCK(map);
+    sync_window(map);
+    // Earlier windows may not have been synchronized when they were unmapped.
+    if (fsync(map->fd) != 0)
+    {
+        REPORT("Failed to synchronize log file!");
+    }
+    UNLOCK(map);
+}
+
+/**
+ * Emergency function of the memory mapped target.  The target is not locked.  Messages already in
+ * the mapping survive the process, so only a message which fits in the current window is added.
+ */
+void _ll_mmap_emergency(struct ll_target *target, const char *message, size_t length)
+{
+    struct ll_mmap_target *map = (struct ll_mmap_target *) target;
+
+    if (map == NULL || message == NULL || map->map == NULL ||
+        length + TRAILER_LENGTH > map->size - map->used)
+    {
+        return;
+    }
+
+    memcpy(map->map + map->used, message, length);
+#   if !LL_COMPACT
+    map->map[map->used + length] = '\n';
+#   endif
+    map->used   += length + TRAILER_LENGTH;
+    map->end    += length + TRAILER_LENGTH;
+}
+
+/// Stop writing to the file of a memory mapped target.
+void ll_mmap_target_close(struct ll_mmap_target *target)
+{
+    assert(target != NULL);
+
+    LOCK(target);
+    unmap_window(target);
+    if (target->end != LL_MMAP_APPEND && ftruncate(target->fd, (off_t) target->end) != 0)
+    {
+        REPORT("Failed to truncate log file!");
+    }
+    UNLOCK(target);
+}
+
+#endif /* end HAVE_MMAP */
@@ -0,0 +1,375 @@
+/**
+ * @file        target_rotate.c
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       Rotating log file target implementation.
+ */
+#include "ll_target_rotate.h"
+
+#include "common.h"
+#include "target_file.h"
+
+#if HAVE_WRITEV && HAVE_OPENDIR
+#   include <assert.h>
+#   include <ctype.h>
+#   include <dirent.h>
+#   include <errno.h>
+#   include <fcntl.h>
+#   include <stdio.h>
+#   include <stdlib.h>
+#   include <string.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#   if HAVE_POSIX_SPAWN
+#       include <spawn.h>
+#       include <sys/wait.h>
+#   endif
+
+/// Number of bytes written after each message: a newline in text mode, nothing for compact records.
+#   if LL_COMPACT
+#       define TRAILER_LENGTH 0
+#   else
+#       define TRAILER_LENGTH 1
+#   endif
+
+/// Do not pass the file descriptor on to child processes, where supported.
+#   ifdef O_CLOEXEC
+#       define OPEN_FLAGS (O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC)
+#   else
+#       define OPEN_FLAGS (O_WRONLY | O_CREAT | O_APPEND)
+#   endif
+
+/// Report an error from the target.
+#   if LL_LOCATION
+#       define REPORT(err) post_error((err), NULL, 0)
+#   else
+#       define REPORT(err) post_error(err)
+#   endif
+
+/// Process rotated files on a helper thread, if threads are available.
+#   if LL_THREADING && defined(LL_THREAD_START)
+#       define HELPER 1
+#   else
+#       define HELPER 0
+#   endif
+
+#   if HELPER
+/// Helper thread states.
+enum helper_state
+{
+    HELPER_STOPPED, ///< The thread has not been started.
+    HELPER_RUNNING, ///< The thread is running.
+    HELPER_FAILED   ///< The thread could not be started, so files are processed as they rotate.
+};
+
+/// Mutex protecting the helper thread state and the sequence numbers of the targets.
+static ll_mutex             helper_mutex = LL_STATIC_MUTEX_INIT;
+/// Condition signalled when a file has been rotated.
+static ll_cond              helper_wake = LL_STATIC_COND_INIT;
+/// Helper thread handle.
+static ll_thread            helper_thread;
+/// Helper thread state.
+static enum helper_state    helper_state;
+/// Targets known to the helper thread.
+static struct ll_rotate_target *helper_targets;
+#   endif /* end HELPER */
+
+/**
+ * Build the name of a rotated file.
+ *
+ * @return Non-zero if the name fits in the buffer.
+ */
+static int rotated_name
+(
+    char                    *buffer,    ///< [out] Buffer of LL_ROTATE_PATH_SIZE bytes.
+    struct ll_rotate_target *rotate,    ///< [in]  Rotating target.
+    unsigned long            sequence,  ///< [in]  Sequence number of the file.
+    const char              *suffix     ///< [in]  Suffix to add, or NULL.
+)
+{
+    int n = snprintf(buffer, LL_ROTATE_PATH_SIZE, "%s.%lu%s", rotate->path, sequence,
+                     (suffix != NULL) ? suffix : "");
+
+    return n > 0 && n < LL_ROTATE_PATH_SIZE;
+}
+
+/// Find the highest sequence number of the rotated files next to a file.
+static unsigned long find_sequence(const char *path)
+{
+    char             directory[LL_ROTATE_PATH_SIZE];
+    const char      *name = strrchr(path, '/');
+    size_t           length;
+    DIR             *dir;
+    struct dirent   *entry;
+    unsigned long    sequence = 0;
+    unsigned long    n;
+
+    if (name == NULL)
+    {
+        strcpy(directory, ".");
+        name = path;
+    }
+    else
+    {
+        length = (name == path) ? 1 : (size_t) (name - path);
+        if (length >= sizeof(directory))
+        {
+            return 0;
+        }
+        memcpy(directory, path, length);
+        directory[length] = '\0';
+        ++name;
+    }
+
+    dir = opendir(directory);
+    if (dir == NULL)
+    {
+        return 0;
+    }
+    length = strlen(name);
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (strncmp(entry->d_name, name, length) == 0 &&
+            entry->d_name[length] == '.' &&
+            isdigit((unsigned char) entry->d_name[length + 1]))
+        {
+            n = strtoul(&entry->d_name[length + 1], NULL, 10);
+            if (n > sequence)
+            {
+                sequence = n;
+            }
+        }
+    }
+    closedir(dir);
+
+    return sequence;
+}
+
+/// Process a rotated file, and remove the rotated file which is no longer to be kept.
+static void process_file(struct ll_rotate_target *rotate, unsigned long sequence)
+{
+    char name[LL_ROTATE_PATH_SIZE];
+
+    if (rotate->process != NULL && rotated_name(name, rotate, sequence, NULL))
+    {
+        rotate->process(name);
+    }
+
+    if (rotate->max_files > 0 && sequence > rotate->max_files)
+    {
+        sequence -= rotate->max_files;
+        if (rotated_name(name, rotate, sequence, NULL))
+        {
+            unlink(name);
+        }
+        if (rotate->suffix != NULL && rotated_name(name, rotate, sequence, rotate->suffix))
+        {
+            unlink(name);
+        }
+    }
+}
+
+#   if HELPER
+/// Helper thread, which processes rotated files.
+static LL_THREAD_FUNC(helper, arg)
+{
+    struct ll_rotate_target *rotate;
+    unsigned long            sequence;
+
+    LL_UNUSED(arg);
+
+    LL_LOCK(&helper_mutex);
+    for (;;)
+    {
+        for (rotate = helper_targets; rotate != NULL; rotate = rotate->link)
+        {
+            if (rotate->processed != rotate->sequence)
+            {
+                break;
+            }
+        }
+        if (rotate == NULL)
+        {
+            LL_COND_WAIT(&helper_wake, &helper_mutex);
+            continue;
+        }
+
+        sequence = ++rotate->processed;
+        LL_UNLOCK(&helper_mutex);
+        process_file(rotate, sequence);
+        LL_LOCK(&helper_mutex);
+    }
+
+    LL_THREAD_RETURN;
+}
+#   endif /* end HELPER */
+
+/// Start writing to the file of a target for the first time.
+static void start(struct ll_rotate_target *rotate)
+{
+    unsigned long sequence = find_sequence(rotate->path);
+
+#   if HELPER
+    LL_LOCK(&helper_mutex);
+    rotate->sequence    = sequence;
+    rotate->processed   = sequence;
+    rotate->link        = helper_targets;
+    helper_targets      = rotate;
+    if (helper_state == HELPER_STOPPED)
+    {
+        helper_state = (LL_THREAD_START(&helper_thread, &helper, NULL) == 0) ? HELPER_RUNNING :
+                                                                                HELPER_FAILED;
+    }
+    LL_UNLOCK(&helper_mutex);
+#   else /* !HELPER */
+    rotate->sequence    = sequence;
+    rotate->processed   = sequence;
+#   endif /* end !HELPER */
+
+    rotate->opened = 1;
+}
+
+/// Open the file of a target, and work out when it is to be rotated.
+static void open_file(struct ll_rotate_target *rotate, ll_timestamp_t timestamp)
+{
+    struct stat info;
+
+    if (!rotate->opened)
+    {
+        start(rotate);
+    }
+
+    rotate->file.fd = open(rotate->path, OPEN_FLAGS, 0644);
+    if (rotate->file.fd < 0)
+    {
+        REPORT("Failed to open log file!");
+        return;
+    }
+    rotate->written = (fstat(rotate->file.fd, &info) == 0) ? (uint64_t) info.st_size : 0;
+    rotate->deadline = (rotate->interval > 0) ?
+                       (timestamp / rotate->interval + 1) * rotate->interval : UINT64_MAX;
+}
+
+/// Rename the file of a target out of the way, hand it to the helper thread, and start a new one.
+static void rotate_file(struct ll_rotate_target *rotate, ll_timestamp_t timestamp)
+{
+    char            name[LL_ROTATE_PATH_SIZE];
+    unsigned long   sequence = rotate->sequence + 1;
+
+    file_write_out(&rotate->file);
+    close(rotate->file.fd);
+    rotate->file.fd = -1;
+
+    if (!rotated_name(name, rotate, sequence, NULL) || rename(rotate->path, name) != 0)
+    {
+        REPORT("Failed to rename log file!");
+        open_file(rotate, timestamp);
+        // Carry on with the same file rather than trying again for every message.
+        rotate->written = 0;
+        return;
+    }
+
+#   if HELPER
+    LL_LOCK(&helper_mutex);
+    rotate->sequence = sequence;
+    if (helper_state == HELPER_RUNNING)
+    {
+        LL_COND_SIGNAL(&helper_wake);
+        LL_UNLOCK(&helper_mutex);
+    }
+    else
+    {
+        rotate->processed = sequence;
+        LL_UNLOCK(&helper_mutex);
+        process_file(rotate, sequence);
+    }
+#   else /* !HELPER */
+    rotate->sequence    = sequence;
+    rotate->processed   = sequence;
+    process_file(rotate, sequence);
+#   endif /* end !HELPER */
+
+    open_file(rotate, timestamp);
+}
+
+/// Send function of the rotating target.
+void _ll_rotate_send
+(
+    struct ll_target    *target,
+    enum ll_level        level,
+    ll_timestamp_t       timestamp,
+    const char          *message,
+    size_t               length
+)
+{
+    struct ll_rotate_target *rotate = (struct ll_rotate_target *) target;
+
+    assert(rotate != NULL);
+    assert(rotate->path != NULL);
+
+    LOCK(&rotate->file);
+    if (rotate->file.fd < 0)
+    {
+        open_file(rotate, timestamp);
+    }
+    else if ((rotate->max_size > 0 && rotate->written >= rotate->max_size) ||
+             timestamp >= rotate->deadline)
+    {
+        rotate_file(rotate, timestamp);
+    }
+
+    if (rotate->file.fd >= 0)
+    {
+        file_append(&rotate->file, level, timestamp, message, length);
+        rotate->written += length + TRAILER_LENGTH;
+    }
+    UNLOCK(&rotate->file);
+}
+
+/// Flush function of the rotating target.
+void _ll_rotate_flush(struct ll_target *target)
+{
+    struct ll_rotate_target *rotate = (struct ll_rotate_target *) target;
+
+    assert(rotate != NULL);
+
+    LOCK(&rotate->file);
+    file_write_out(&rotate->file);
+    UNLOCK(&rotate->file);
+}
+
+#   if HAVE_POSIX_SPAWN
+/// Environment of the process, passed on to gzip.
+extern char **environ;
+
+/// Compress a file with gzip.
+void ll_rotate_gzip(const char *path)
+{
+    static char  program[] = "gzip";
+    static char  force[] = "-f";
+    static char  end[] = "--";
+    char        *argv[5];
+    pid_t        pid;
+    int          status;
+
+    assert(path != NULL);
+
+    argv[0] = program;
+    argv[1] = force;
+    argv[2] = end;
+    argv[3] = (char *) path;
+    argv[4] = NULL;
+    if (posix_spawnp(&pid, program, NULL, NULL, argv, environ) != 0)
+    {
+        REPORT("Failed to start gzip!");
+        return;
+    }
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+    {
+    }
+}
+#   endif /* end HAVE_POSIX_SPAWN */
+
+#endif /* end HAVE_WRITEV && HAVE_OPENDIR */
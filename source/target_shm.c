@@ -0,0 +1,491 @@
+/**
+ * @file        target_shm.c
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       Shared memory log target and collector implementation.
+ *
+ * The ring buffer contains no pointers and its atomic operations work on plain 32-bit words, so it
+ * serves producers in different processes just as it does threads.  Each record is a header giving
+ * the level, time stamp and process, followed by the message and its terminator.
+ *
+ * A target keeps its mapping when the collector closes the object, as other threads may still be
+ * writing to it, so a mapping is left behind each time a collector restarts.
+ */
+#include "ll_target_shm.h"
+
+#include "common.h"
+
+#if HAVE_SHM_OPEN && HAVE_MMAP
+#   include <assert.h>
+#   include <errno.h>
+#   include <fcntl.h>
+#   include <signal.h>
+#   include <stddef.h>
+#   include <string.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <time.h>
+#   include <unistd.h>
+#   if HAVE_PTHREAD_ATFORK
+#       include <pthread.h>
+#   endif
+
+/// Report an error from the target.
+#   if LL_LOCATION
+#       define REPORT(err) post_error((err), NULL, 0)
+#   else
+#       define REPORT(err) post_error(err)
+#   endif
+
+/// Time an uncommitted record may hold up the collector before its process is checked, in
+/// nanoseconds.
+#   define STALL_TIMEOUT UINT64_C(100000000)
+
+/// Time to wait before attaching again after the first failure, in nanoseconds.
+#   define MIN_BACKOFF UINT64_C(10000000)
+
+/// Longest time to wait before attaching again, in nanoseconds.
+#   define MAX_BACKOFF UINT64_C(5000000000)
+
+/// Size of the mapping of a shared memory object with a ring of a given size.
+#   define MAPPING_SIZE(size) (offsetof(struct ll_shm, ring) + sizeof(struct ll_ring) + (size))
+
+/// Attach states.
+enum state
+{
+    STATE_NONE,     ///< Not attached yet.
+    STATE_READY,    ///< Attached to the shared memory object.
+    STATE_FAILED    ///< The shared memory object could not be attached; messages are dropped.
+};
+
+/// Record header.  The message and its terminator immediately follow.
+struct record
+{
+    ll_timestamp_t       timestamp; ///< Message time stamp.
+    uint32_t             level;     ///< Message level.
+    volatile uint32_t    pid;       ///< Process which added the message.  Written first, so that
+                                    ///< the collector can tell if it exited before committing.
+};
+
+/// Identifier of this process, or zero if not known yet.
+static volatile uint32_t process;
+
+#   if HAVE_PTHREAD_ATFORK
+/// Fork handler registration states.
+#       define FORK_NONE        0   ///< Not registered yet.
+#       define FORK_BUSY        1   ///< Being registered.
+#       define FORK_READY       2   ///< Registered, so the process identifier may be kept.
+#       define FORK_FAILED      3   ///< Could not be registered.
+
+/// Registration state of the fork handler which forgets the process identifier.
+static volatile uint32_t fork_state;
+
+/// Forget the process identifier in a child process.
+static void forget_process(void)
+{
+    process = 0;
+}
+
+/// Register the fork handler which forgets the process identifier, if not already done.
+static void register_fork(void)
+{
+    if (LL_ATOMIC_CAS(&fork_state, FORK_NONE, FORK_BUSY))
+    {
+        LL_ATOMIC_STORE_RELEASE(&fork_state, (pthread_atfork(NULL, NULL, &forget_process) == 0) ?
+                                             FORK_READY : FORK_FAILED);
+    }
+}
+#   endif /* end HAVE_PTHREAD_ATFORK */
+
+/**
+ * Get the identifier of this process.  Once the fork handler is registered it is kept, so that no
+ * system call is made for each message.
+ */
+static uint32_t own_pid(void)
+{
+    uint32_t pid = LL_ATOMIC_LOAD_RELAXED(&process);
+
+    if (pid == 0)
+    {
+        pid = (uint32_t) getpid();
+#   if HAVE_PTHREAD_ATFORK
+        if (LL_ATOMIC_LOAD_ACQUIRE(&fork_state) == FORK_READY)
+        {
+            LL_ATOMIC_STORE_RELAXED(&process, pid);
+        }
+#   endif /* end HAVE_PTHREAD_ATFORK */
+    }
+    return pid;
+}
+
+/// Read a monotonic clock, in nanoseconds.
+static uint64_t now(void)
+{
+#   if HAVE_CLOCK_GETTIME
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000U + (uint64_t) ts.tv_nsec;
+#   else
+    return (uint64_t) time(NULL) * 1000000000U;
+#   endif
+}
+
+/**
+ * Map an existing shared memory object and check that its ring is ready.
+ *
+ * @retval  NULL        The object was mapped.
+ * @retval  non-NULL    An error occured.  The returned value is a constant string describing the
+ *                      error.
+ */
+static const char *attach(struct ll_shm_target *shm)
+{
+    struct stat      info;
+    struct ll_shm   *mapping;
+    int              fd;
+
+    fd = shm_open(shm->name, O_RDWR, 0);
+    if (fd < 0)
+    {
+        return "Failed to open shared memory log ring!";
+    }
+    if (fstat(fd, &info) != 0 || (size_t) info.st_size < MAPPING_SIZE(0))
+    {
+        close(fd);
+        return "Shared memory log ring is not set up!";
+    }
+    mapping = mmap(NULL, (size_t) info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        return "Failed to map shared memory log ring!";
+    }
+
+    if (LL_ATOMIC_LOAD_ACQUIRE(&mapping->magic) != LL_SHM_MAGIC ||
+        MAPPING_SIZE(mapping->ring.size) != (size_t) info.st_size)
+    {
+        munmap(mapping, (size_t) info.st_size);
+        return "Shared memory log ring is not set up!";
+    }
+
+    shm->shm = mapping;
+    return NULL;
+}
+
+/// Attach a shared memory target to the object created by the collector.
+int ll_shm_target_attach(struct ll_shm_target *target)
+{
+    const char  *err = NULL;
+    uint32_t     state;
+    uint64_t     time = 0;
+
+    assert(target != NULL);
+    assert(target->name != NULL);
+
+    if (LL_ATOMIC_LOAD_ACQUIRE(&target->state) != STATE_READY)
+    {
+        LOCK(target);
+        state = LL_ATOMIC_LOAD_RELAXED(&target->state);
+        if (state == STATE_NONE || (state == STATE_FAILED && (time = now()) >= target->retry))
+        {
+            err = attach(target);
+            if (err == NULL)
+            {
+#   if HAVE_PTHREAD_ATFORK
+                register_fork();
+#   endif
+                target->backoff = 0;
+                LL_ATOMIC_STORE_RELEASE(&target->state, STATE_READY);
+            }
+            else
+            {
+                // The collector may not have started yet, so try again later, reporting only the
+                // first failure.
+                if (state == STATE_NONE)
+                {
+                    time = now();
+                }
+                else
+                {
+                    err = NULL;
+                }
+                target->backoff = (target->backoff == 0)              ? MIN_BACKOFF :
+                                  (target->backoff < MAX_BACKOFF / 2) ? 2 * target->backoff :
+                                                                        MAX_BACKOFF;
+                target->retry = time + target->backoff;
+                LL_ATOMIC_STORE_RELEASE(&target->state, STATE_FAILED);
+            }
+        }
+        UNLOCK(target);
+        if (err != NULL)
+        {
+            REPORT(err);
+        }
+    }
+
+    return (LL_ATOMIC_LOAD_ACQUIRE(&target->state) == STATE_READY) ? 0 : -1;
+}
+
+/**
+ * Detach a target from a shared memory object which its collector has closed, so that the next
+ * message attaches to the object of the next collector.  The mapping is kept, as other threads may
+ * still be writing to it.
+ */
+static void detach(struct ll_shm_target *target, struct ll_shm *shm)
+{
+    LOCK(target);
+    if (LL_ATOMIC_LOAD_RELAXED(&target->state) == STATE_READY && target->shm == shm)
+    {
+        target->backoff = 0;
+        LL_ATOMIC_STORE_RELEASE(&target->state, STATE_NONE);
+    }
+    UNLOCK(target);
+}
+
+/**
+ * Add a message to the ring, or count it as dropped if the ring is full.
+ *
+ * @retval  0   The message was added or dropped.
+ * @retval  -1  The collector has closed the object.
+ */
+static int put(struct ll_shm *shm, enum ll_level level, ll_timestamp_t timestamp,
+               const char *message, size_t length)
+{
+    struct record *record;
+
+    if (LL_ATOMIC_LOAD_RELAXED(&shm->magic) != LL_SHM_MAGIC)
+    {
+        return -1;
+    }
+
+    record = ll_ring_reserve(&shm->ring, sizeof(*record) + length + 1);
+    if (record == NULL)
+    {
+        LL_ATOMIC_FETCH_ADD(&shm->dropped, 1);
+        return 0;
+    }
+
+    LL_ATOMIC_STORE_RELAXED(&record->pid, own_pid());
+    record->timestamp   = timestamp;
+    record->level       = (uint32_t) level;
+    memcpy(record + 1, message, length);
+    ((char *) (record + 1))[length] = '\0';
+    ll_ring_commit(&shm->ring, record, sizeof(*record) + length + 1);
+    return 0;
+}
+
+/// Send function of the shared memory target.
+void _ll_shm_send
+(
+    struct ll_target    *target,
+    enum ll_level        level,
+    ll_timestamp_t       timestamp,
+    const char          *message,
+    size_t               length
+)
+{
+    struct ll_shm_target    *shm = (struct ll_shm_target *) target;
+    struct ll_shm           *mapping;
+
+    assert(shm != NULL);
+    assert(message != NULL);
+
+    if (LL_ATOMIC_LOAD_ACQUIRE(&shm->state) != STATE_READY && ll_shm_target_attach(shm) != 0)
+    {
+        return;
+    }
+    mapping = shm->shm;
+    if (put(mapping, level, timestamp, message, length) != 0)
+    {
+        detach(shm, mapping);
+        if (ll_shm_target_attach(shm) == 0)
+        {
+            put(shm->shm, level, timestamp, message, length);
+        }
+    }
+}
+
+/// Emergency function of the shared memory target.  Messages already in the ring are safe.
+void _ll_shm_emergency(struct ll_target *target, const char *message, size_t length)
+{
+    struct ll_shm_target *shm = (struct ll_shm_target *) target;
+
+    if (shm == NULL || message == NULL || LL_ATOMIC_LOAD_ACQUIRE(&shm->state) != STATE_READY)
+    {
+        return;
+    }
+    put(shm->shm, LL_LEVEL_FATAL, 0, message, length);
+}
+
+/**
+ * Mark an existing shared memory object of a name as closed, so that the targets attached to it
+ * move on to a new object.
+ */
+static void mark_closed(const char *name)
+{
+    struct stat      info;
+    struct ll_shm   *mapping;
+    int              fd;
+
+    fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0)
+    {
+        return;
+    }
+    if (fstat(fd, &info) == 0 && (size_t) info.st_size >= MAPPING_SIZE(0))
+    {
+        mapping = mmap(NULL, (size_t) info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mapping != MAP_FAILED)
+        {
+            LL_ATOMIC_STORE_RELEASE(&mapping->magic, 0U);
+            munmap(mapping, (size_t) info.st_size);
+        }
+    }
+    close(fd);
+}
+
+/// Create the shared memory object for a collector.
+int ll_shm_collector_open(struct ll_shm_collector *collector, const char *name, size_t size)
+{
+    void    *mapping;
+    int      fd;
+
+    assert(collector != NULL);
+    assert(name != NULL);
+
+    collector->name     = name;
+    collector->shm      = NULL;
+    collector->size     = MAPPING_SIZE(size);
+    collector->stalled  = 0;
+    collector->since    = 0;
+    if (size < 2 * (sizeof(struct record) + LL_MAX_MESSAGE_SIZE + 16) ||
+        size > UINT32_C(0x40000000) ||
+        (size & (size - 1)) != 0)
+    {
+        return -1;
+    }
+
+    mark_closed(name);
+    shm_unlink(name);
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    if (ftruncate(fd, (off_t) collector->size) != 0)
+    {
+        close(fd);
+        shm_unlink(name);
+        return -1;
+    }
+    mapping = mmap(NULL, collector->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        shm_unlink(name);
+        return -1;
+    }
+
+    collector->shm = (struct ll_shm *) mapping;
+    collector->shm->dropped = 0;
+    ll_ring_init(&collector->shm->ring, size);
+    LL_ATOMIC_STORE_RELEASE(&collector->shm->magic, LL_SHM_MAGIC);
+
+    return 0;
+}
+
+/// Pass the messages waiting in the ring to a list of targets, oldest first.
+size_t ll_shm_collect(struct ll_shm_collector *collector, struct ll_target *targets, size_t limit)
+{
+    struct ll_record     batch[LL_BATCH_SIZE];
+    struct ll_ring      *ring;
+    struct record       *record;
+    size_t               count = 0;
+    size_t               length;
+    size_t               n;
+    uint32_t             position;
+    uint32_t             next;
+    uint32_t             lost;
+    uint32_t             pid;
+
+    assert(collector != NULL);
+    assert(collector->shm != NULL);
+
+    lost = LL_ATOMIC_LOAD_RELAXED(&collector->shm->dropped);
+    if (lost > 0)
+    {
+        LL_ATOMIC_FETCH_SUB(&collector->shm->dropped, lost);
+        REPORT("Shared memory log ring overflow, messages were dropped!");
+    }
+
+    // Pass the messages on in batches, removing each batch from the ring once it has been sent.
+    ring = &collector->shm->ring;
+    while (count < limit)
+    {
+        position = next = LL_ATOMIC_LOAD_RELAXED(&ring->tail);
+        for (n = 0; n < LL_BATCH_SIZE && count + n < limit; ++n)
+        {
+            record = ll_ring_scan(ring, &next, &length);
+            if (record == NULL)
+            {
+                break;
+            }
+            batch[n].level      = (enum ll_level) record->level;
+            batch[n].timestamp  = record->timestamp;
+            batch[n].message    = (const char *) (record + 1);
+            batch[n].length     = length - sizeof(*record) - 1;
+            position = next;
+        }
+        if (n == 0)
+        {
+            break;
+        }
+        ll_target_send_batch(targets, batch, n);
+        ll_ring_release_to(ring, position);
+        count += n;
+    }
+
+    // A record left uncommitted at the tail holds up every message after it.  If the process which
+    // reserved it has exited, it can never be committed, so skip it.
+    record = (count == 0 && limit > 0) ? ll_ring_uncommitted(ring) : NULL;
+    if (record == NULL)
+    {
+        collector->since = 0;
+    }
+    else if (collector->since == 0 || collector->stalled != LL_ATOMIC_LOAD_RELAXED(&ring->tail))
+    {
+        collector->stalled  = LL_ATOMIC_LOAD_RELAXED(&ring->tail);
+        collector->since    = now();
+    }
+    else if (now() - collector->since > STALL_TIMEOUT)
+    {
+        pid = LL_ATOMIC_LOAD_ACQUIRE(&record->pid);
+        collector->since = now();
+        if (pid != 0 && kill((pid_t) pid, 0) != 0 && errno == ESRCH)
+        {
+            ll_ring_abandon(ring, record);
+            collector->since = 0;
+            REPORT("Shared memory log ring message left unfinished by a process which exited!");
+        }
+    }
+
+    return count;
+}
+
+/// Unmap and unlink the shared memory object of a collector.
+void ll_shm_collector_close(struct ll_shm_collector *collector)
+{
+    assert(collector != NULL);
+
+    if (collector->shm != NULL)
+    {
+        LL_ATOMIC_STORE_RELEASE(&collector->shm->magic, 0U);
+        munmap(collector->shm, collector->size);
+        shm_unlink(collector->name);
+        collector->shm = NULL;
+    }
+}
+
+#endif /* end HAVE_SHM_OPEN && HAVE_MMAP */
@@ -0,0 +1,453 @@
+/**
+ * @file        target_socket.c
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       UNIX domain socket log target implementation.
+ *
+ * Each message is kept in the buffer behind a 32-bit length, padded to a multiple of 4 bytes.  Sent
+ * messages are removed from the front of the buffer, and the remainder is only moved back to the
+ * start when a new message does not fit after it.
+ */
+#ifndef _GNU_SOURCE
+#   define _GNU_SOURCE  // For sendmmsg().
+#endif
+
+#include "ll_target_socket.h"
+
+#include "common.h"
+
+#if HAVE_SENDMSG
+#   include <assert.h>
+#   include <errno.h>
+#   include <fcntl.h>
+#   include <string.h>
+#   include <sys/socket.h>
+#   include <sys/uio.h>
+#   include <sys/un.h>
+#   include <time.h>
+#   include <unistd.h>
+
+/// Report an error from the target.
+#   if LL_LOCATION
+#       define REPORT(err) post_error((err), NULL, 0)
+#   else
+#       define REPORT(err) post_error(err)
+#   endif
+
+/// Don't raise SIGPIPE when the collector closes a stream, where that can be asked for.
+#   ifndef MSG_NOSIGNAL
+#       define MSG_NOSIGNAL 0
+#   endif
+
+/// Time to wait before reconnecting after the first failure, in nanoseconds.
+#   define MIN_BACKOFF UINT64_C(10000000)
+
+/// Longest time to wait before reconnecting, in nanoseconds.
+#   define MAX_BACKOFF UINT64_C(5000000000)
+
+/// Size of the length before each message in the buffer.
+#   define HEADER_LENGTH sizeof(uint32_t)
+
+/// Round a length up to a multiple of the header length.
+#   define ALIGN(n) (((n) + HEADER_LENGTH - 1) & ~(HEADER_LENGTH - 1))
+
+/// Read a monotonic clock, in nanoseconds.
+static uint64_t now(void)
+{
+#   if HAVE_CLOCK_GETTIME
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000U + (uint64_t) ts.tv_nsec;
+#   else
+    return (uint64_t) time(NULL) * 1000000000U;
+#   endif
+}
+
+/// Get the length of the message at an offset in the buffer.
+static size_t length_at(struct ll_socket_target *sock, size_t offset)
+{
+    uint32_t length;
+
+    memcpy(&length, sock->buffer + offset, sizeof(length));
+    return length;
+}
+
+/// Close the socket after a failure, and put off reconnecting it.
+static void disconnect(struct ll_socket_target *sock)
+{
+    close(sock->fd);
+    sock->fd = -1;
+    sock->sent = 0;
+    sock->backoff = (sock->backoff == 0) ? MIN_BACKOFF :
+                    (sock->backoff < MAX_BACKOFF / 2) ? 2 * sock->backoff : MAX_BACKOFF;
+    sock->retry = now() + sock->backoff;
+}
+
+/**
+ * Connect the socket, unless the last failure was too recent.
+ *
+ * @return Non-zero if the socket is connected.
+ */
+static int reconnect
+(
+    struct ll_socket_target *sock,      ///< [in] Socket target.
+    int                      force      ///< [in] Non-zero to try even if the last failure was
+                                        ///<      recent.
+)
+{
+    struct sockaddr_un  address;
+    size_t              length = strlen(sock->path);
+    int                 flags;
+
+    if (!force && sock->backoff != 0 && now() < sock->retry)
+    {
+        return 0;
+    }
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (length >= sizeof(address.sun_path))
+    {
+        length = sizeof(address.sun_path) - 1;
+    }
+    memcpy(address.sun_path, sock->path, length);
+
+    sock->fd = socket(AF_UNIX, sock->type, 0);
+    if (sock->fd < 0)
+    {
+        sock->backoff = MAX_BACKOFF / 2;
+        disconnect(sock);
+        return 0;
+    }
+    flags = fcntl(sock->fd, F_GETFL);
+    fcntl(sock->fd, F_SETFL, flags | O_NONBLOCK);
+    fcntl(sock->fd, F_SETFD, FD_CLOEXEC);
+    if (connect(sock->fd, (struct sockaddr *) &address, sizeof(address)) != 0)
+    {
+        disconnect(sock);
+        return 0;
+    }
+
+    sock->backoff = 0;
+    return 1;
+}
+
+/**
+ * Send a batch of messages from the front of the buffer.  Datagrams are sent with one call to
+ * sendmmsg() where available.  On a stream socket the batch is gathered into a single sendmsg()
+ * instead, so that a short write cannot let a later message overtake the rest of an earlier one.
+ *
+ * @return  The number of messages sent completely, or a negative value if nothing could be sent.
+ *          Partly sent messages on stream sockets are accounted for in the target.
+ */
+static int send_batch(struct ll_socket_target *sock)
+{
+    struct iovec    iov[LL_SOCKET_BATCH];
+    struct msghdr   message;
+    size_t          offset = sock->first;
+    ssize_t         sent;
+    int             count;
+    int             n;
+
+    for (count = 0; count < LL_SOCKET_BATCH && (size_t) count < sock->count; ++count)
+    {
+        iov[count].iov_base = sock->buffer + offset + HEADER_LENGTH;
+        iov[count].iov_len  = length_at(sock, offset);
+        offset += HEADER_LENGTH + ALIGN(iov[count].iov_len);
+    }
+    iov[0].iov_base = (char *) iov[0].iov_base + sock->sent;
+    iov[0].iov_len -= sock->sent;
+
+    memset(&message, 0, sizeof(message));
+    if (sock->type == SOCK_STREAM)
+    {
+        message.msg_iov     = iov;
+        message.msg_iovlen  = (size_t) count;
+        do
+        {
+            sent = sendmsg(sock->fd, &message, MSG_DONTWAIT | MSG_NOSIGNAL);
+        } while (sent < 0 && errno == EINTR);
+        if (sent < 0)
+        {
+            return -1;
+        }
+
+        for (n = 0; n < count && (size_t) sent >= iov[n].iov_len; ++n)
+        {
+            sent -= (ssize_t) iov[n].iov_len;
+            sock->sent = 0;
+        }
+        if (sent > 0)
+        {
+            sock->sent = (n == 0 ? sock->sent : 0) + (size_t) sent;
+        }
+        return n;
+    }
+
+#   if HAVE_SENDMMSG
+    {
+        struct mmsghdr messages[LL_SOCKET_BATCH];
+
+        memset(messages, 0, sizeof(messages[0]) * (size_t) count);
+        for (n = 0; n < count; ++n)
+        {
+            messages[n].msg_hdr.msg_iov     = &iov[n];
+            messages[n].msg_hdr.msg_iovlen  = 1;
+        }
+        do
+        {
+            n = sendmmsg(sock->fd, messages, (unsigned int) count, MSG_DONTWAIT | MSG_NOSIGNAL);
+        } while (n < 0 && errno == EINTR);
+    }
+#   else /* !HAVE_SENDMMSG */
+    message.msg_iovlen = 1;
+    for (n = 0; n < count; ++n)
+    {
+        message.msg_iov = &iov[n];
+        do
+        {
+            sent = sendmsg(sock->fd, &message, MSG_DONTWAIT | MSG_NOSIGNAL);
+        } while (sent < 0 && errno == EINTR);
+        if (sent < 0)
+        {
+            return (n > 0) ? n : -1;
+        }
+    }
+#   endif /* end !HAVE_SENDMMSG */
+
+    return n;
+}
+
+/// Remove messages from the front of the buffer.
+static void consume(struct ll_socket_target *sock, size_t count)
+{
+    while (count-- > 0)
+    {
+        sock->first += HEADER_LENGTH + ALIGN(length_at(sock, sock->first));
+        --sock->count;
+    }
+    if (sock->count == 0)
+    {
+        sock->first = 0;
+        sock->used  = 0;
+        sock->sent  = 0;
+    }
+}
+
+/**
+ * Send as much of the buffer as the collector will take without blocking.  The target must be
+ * locked by the caller, unless this is an emergency.
+ */
+static void transmit
+(
+    struct ll_socket_target *sock,      ///< [in] Socket target.
+    int                      emergency  ///< [in] Non-zero to connect regardless of recent failures,
+                                        ///<      and not to report anything.
+)
+{
+    int n;
+
+    while (sock->count > 0)
+    {
+        if (sock->fd < 0 && !reconnect(sock, emergency))
+        {
+            return;
+        }
+
+        n = send_batch(sock);
+        if (n < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+            {
+                // The collector is busy, so keep the rest for later.
+                return;
+            }
+            if (errno == EMSGSIZE)
+            {
+                // The message can never be sent as a datagram.
+                consume(sock, 1);
+                ++sock->dropped;
+                continue;
+            }
+            disconnect(sock);
+            continue;
+        }
+        consume(sock, (size_t) n);
+        if (sock->dropped > 0 && !emergency)
+        {
+            sock->dropped = 0;
+            REPORT("Log collector socket overflow, messages were dropped!");
+        }
+        if (n == 0)
+        {
+            // Only part of a message went out.
+            return;
+        }
+    }
+}
+
+/**
+ * Add a message to the end of the buffer.
+ *
+ * @return Non-zero if there was room for the message.
+ */
+static int put
+(
+    struct ll_socket_target *sock,      ///< [in] Socket target.
+    const char              *message,   ///< [in] Message text.
+    size_t                   length     ///< [in] Message length in bytes, excluding the terminator.
+)
+{
+    size_t      trailer = (!LL_COMPACT && sock->type == SOCK_STREAM) ? 1 : 0;
+    size_t      need = HEADER_LENGTH + ALIGN(length + trailer);
+    uint32_t    total = (uint32_t) (length + trailer);
+
+    if (need > sock->size - sock->used)
+    {
+        // Move the messages back to the start of the buffer to make room, if that would help.
+        if (need > sock->size - (sock->used - sock->first))
+        {
+            return 0;
+        }
+        memmove(sock->buffer, sock->buffer + sock->first, sock->used - sock->first);
+        sock->used -= sock->first;
+        sock->first = 0;
+    }
+
+    memcpy(sock->buffer + sock->used, &total, sizeof(total));
+    memcpy(sock->buffer + sock->used + HEADER_LENGTH, message, length);
+    if (trailer != 0)
+    {
+        sock->buffer[sock->used + HEADER_LENGTH + length] = '\n';
+    }
+    sock->used += need;
+    ++sock->count;
+
+    return 1;
+}
+
+/// Send function of the UNIX domain socket target.
+void _ll_socket_send
+(
+    struct ll_target    *target,
+    enum ll_level        level,
+    ll_timestamp_t       timestamp,
+    const char          *message,
+    size_t               length
+)
+{
+    struct ll_socket_target *sock = (struct ll_socket_target *) target;
+    int                      due;
+
+    assert(sock != NULL);
+    assert(sock->path != NULL);
+    assert(message != NULL);
+
+    LOCK(sock);
+    if (sock->count == 0)
+    {
+        sock->oldest = timestamp;
+    }
+    due = (level <= sock->flush_level || timestamp - sock->oldest >= sock->delay);
+    if (!put(sock, message, length))
+    {
+        // Make room by sending what the collector will take, then try once more.
+        transmit(sock, 0);
+        if (!put(sock, message, length))
+        {
+            ++sock->dropped;
+        }
+    }
+    if (due || sock->count >= LL_SOCKET_BATCH)
+    {
+        transmit(sock, 0);
+    }
+    UNLOCK(sock);
+}
+
+/// Batch send function of the UNIX domain socket target.
+void _ll_socket_send_batch(struct ll_target *target, const struct ll_record *records, size_t count)
+{
+    struct ll_socket_target *sock = (struct ll_socket_target *) target;
+    size_t                   i;
+    int                      due = 0;
+
+    assert(sock != NULL);
+    assert(sock->path != NULL);
+    assert(records != NULL);
+
+    LOCK(sock);
+    for (i = 0; i < count; ++i)
+    {
+        if (sock->count == 0)
+        {
+            sock->oldest = records[i].timestamp;
+        }
+        due |= (records[i].level <= sock->flush_level ||
+                records[i].timestamp - sock->oldest >= sock->delay);
+        if (!put(sock, records[i].message, records[i].length))
+        {
+            transmit(sock, 0);
+            if (!put(sock, records[i].message, records[i].length))
+            {
+                ++sock->dropped;
+            }
+        }
+    }
+    if (due || sock->count >= LL_SOCKET_BATCH)
+    {
+        transmit(sock, 0);
+    }
+    UNLOCK(sock);
+}
+
+/// Flush function of the UNIX domain socket target.
+void _ll_socket_flush(struct ll_target *target)
+{
+    struct ll_socket_target *sock = (struct ll_socket_target *) target;
+
+    assert(sock != NULL);
+
+    LOCK(sock);
+    transmit(sock, 0);
+    UNLOCK(sock);
+}
+
+/// Emergency function of the UNIX domain socket target.  The target is not locked.
+void _ll_socket_emergency(struct ll_target *target, const char *message, size_t length)
+{
+    struct ll_socket_target *sock = (struct ll_socket_target *) target;
+
+    if (sock == NULL)
+    {
+        return;
+    }
+
+    if (message != NULL && !put(sock, message, length))
+    {
+        transmit(sock, 1);
+        put(sock, message, length);
+    }
+    transmit(sock, 1);
+}
+
+/// Try to send everything in the buffer of a socket target and close its socket.
+void ll_socket_target_close(struct ll_socket_target *target)
+{
+    assert(target != NULL);
+
+    LOCK(target);
+    transmit(target, 0);
+    if (target->fd >= 0)
+    {
+        close(target->fd);
+        target->fd = -1;
+    }
+    consume(target, target->count);
+    UNLOCK(target);
+}
+
+#endif /* end HAVE_SENDMSG */
@@ -0,0 +1,747 @@
+/**
+ * @file        target_syslog.c
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       System log target implementation.
+ *
+ * Targets are given the formatted message, so the fields of an entry are found by splitting the
+ * standard message layout back up.  Messages in a custom or JSON layout are sent whole.  Each
+ * message is gathered from small pieces built on the stack and slices of the formatted message, and
+ * sent with a single sendmsg().
+ */
+#ifndef _GNU_SOURCE
+#   define _GNU_SOURCE  // For memfd_create() and file sealing.
+#endif
+
+#include "ll_target_syslog.h"
+
+#include "common.h"
+#include "timestamp.h"
+
+#if HAVE_SENDMSG
+#   include <assert.h>
+#   include <errno.h>
+#   include <fcntl.h>
+#   include <sched.h>
+#   include <stddef.h>
+#   include <string.h>
+#   include <sys/socket.h>
+#   include <sys/uio.h>
+#   include <sys/un.h>
+#   include <unistd.h>
+#   if HAVE_MEMFD_CREATE
+#       include <sys/mman.h>
+#   endif
+
+/// Report an error from the target.
+#   if LL_LOCATION
+#       define REPORT(err) post_error((err), NULL, 0)
+#   else
+#       define REPORT(err) post_error(err)
+#   endif
+
+/// Don't raise SIGPIPE, where that can be asked for.
+#   ifndef MSG_NOSIGNAL
+#       define MSG_NOSIGNAL 0
+#   endif
+
+/// Most pieces a message is gathered from.
+#   define MAX_PIECES 24
+
+/// Size of the buffer for the header of an RFC 5424 message.
+#   define HEADER_SIZE 1024
+
+/// Longest APP-NAME allowed by RFC 5424.
+#   define MAX_APP_NAME 48
+
+/// Setup states.
+enum state
+{
+    STATE_NONE,     ///< Not set up yet.
+    STATE_READY,    ///< The socket is ready.
+    STATE_FAILED    ///< The socket could not be created; messages are dropped.
+};
+
+/// Fields of a message in the standard layout.  Fields which were not found have a NULL value.
+struct fields
+{
+    const char  *file;          ///< Source file name.
+    size_t       file_length;   ///< Length of the source file name.
+    const char  *line;          ///< Line number text.
+    size_t       line_length;   ///< Length of the line number text.
+    const char  *logger;        ///< Logger path.
+    size_t       logger_length; ///< Length of the logger path.
+    const char  *text;          ///< Message text.
+    size_t       text_length;   ///< Length of the message text.
+};
+
+/// A message being gathered.
+struct pieces
+{
+    struct iovec    iov[MAX_PIECES];    ///< Pieces of the message.
+    size_t          count;              ///< Number of pieces.
+};
+
+/// Syslog severities of the log levels, from FATAL to TRACE.
+static const unsigned char severities[] = { 2, 3, 4, 6, 7, 7 };
+
+/// Newline, for the end of journald fields.
+static const char newline[] = "\n";
+
+/// Get the syslog severity of a log level.
+static unsigned int severity(enum ll_level level)
+{
+    return ((size_t) level < sizeof(severities)) ? severities[level] : 7U;
+}
+
+/**
+ * Split a message in the standard layout into its fields.  If the message does not have the
+ * standard layout, or is a compact record or a custom or JSON layout, the whole of it is taken as
+ * the text.
+ */
+static void split(const char *message, size_t length, struct fields *fields)
+{
+#   if !LL_COMPACT && !LL_CUSTOM_FORMAT && !LL_JSON_FORMAT
+    const char  *end = message + length;
+    const char  *p = message;
+    const char  *q;
+#       if LL_LOCATION
+    const char  *colon;
+#       endif
+#   endif /* end !LL_COMPACT && !LL_CUSTOM_FORMAT && !LL_JSON_FORMAT */
+
+    memset(fields, 0, sizeof(*fields));
+    fields->text        = message;
+    fields->text_length = length;
+
+#   if !LL_COMPACT && !LL_CUSTOM_FORMAT && !LL_JSON_FORMAT
+#       if LL_TIMESTAMP
+    if (length < TIMESTAMP_LENGTH + 1)
+    {
+        return;
+    }
+    p += TIMESTAMP_LENGTH + 1;
+#       endif /* end LL_TIMESTAMP */
+
+    // Skip the level name, which is padded on the left.
+    while (p < end && *p == ' ')
+    {
+        ++p;
+    }
+    while (p < end && *p != ' ')
+    {
+        ++p;
+    }
+    if (p == end)
+    {
+        return;
+    }
+    ++p;
+
+#       if LL_LOCATION
+    // The location is "file:line", split at the last colon.
+    q = memchr(p, ' ', (size_t) (end - p));
+    if (q == NULL)
+    {
+        return;
+    }
+    for (colon = q; colon > p && colon[-1] != ':'; --colon)
+    {
+    }
+    if (colon == p || colon == q || *colon < '0' || *colon > '9')
+    {
+        return;
+    }
+    fields->file        = p;
+    fields->file_length = (size_t) (colon - 1 - p);
+    fields->line        = colon;
+    fields->line_length = (size_t) (q - colon);
+    p = q + 1;
+#       endif /* end LL_LOCATION */
+
+    // The logger path runs up to the first ": ".
+    for (q = p; q + 1 < end && (q[0] != ':' || q[1] != ' '); ++q)
+    {
+    }
+    if (q + 1 >= end)
+    {
+        fields->file = NULL;
+        fields->line = NULL;
+        return;
+    }
+    fields->logger          = p;
+    fields->logger_length   = (size_t) (q - p);
+    fields->text            = q + 2;
+    fields->text_length     = (size_t) (end - q - 2);
+#   endif /* end !LL_COMPACT && !LL_CUSTOM_FORMAT && !LL_JSON_FORMAT */
+}
+
+/**
+ * Write a number as decimal text.
+ *
+ * @return The number of characters written, at most 20.
+ */
+static size_t write_number(char *buffer, unsigned long value)
+{
+    char    digits[20];
+    size_t  count = 0;
+    size_t  i;
+
+    do
+    {
+        digits[count++] = (char) ('0' + value % 10U);
+        value /= 10U;
+    } while (value != 0);
+
+    for (i = 0; i < count; ++i)
+    {
+        buffer[i] = digits[count - 1 - i];
+    }
+    return count;
+}
+
+/// Add a piece to a message.
+static void add(struct pieces *pieces, const void *base, size_t length)
+{
+    assert(pieces->count < MAX_PIECES);
+
+    pieces->iov[pieces->count].iov_base = (void *) base;
+    pieces->iov[pieces->count].iov_len  = length;
+    ++pieces->count;
+}
+
+/**
+ * Add a journald field to a message.  A value containing a newline is sent in the binary form,
+ * preceded by its length as a little-endian 64-bit number.
+ */
+static void add_field
+(
+    struct pieces   *pieces,    ///< [in,out] Message being gathered.
+    const char      *name,      ///< [in]     Field name, followed by '='.
+    const char      *value,     ///< [in]     Field value.
+    size_t           length,    ///< [in]     Length of the field value.
+    char            *size       ///< [out]    Buffer of 9 bytes for the binary form.
+)
+{
+    size_t  name_length = strlen(name);
+    size_t  i;
+
+    if (memchr(value, '\n', length) == NULL)
+    {
+        add(pieces, name, name_length);
+    }
+    else
+    {
+        size[0] = '\n';
+        for (i = 0; i < 8; ++i)
+        {
+            size[1 + i] = (char) (((uint64_t) length >> (8 * i)) & 0xFFU);
+        }
+        add(pieces, name, name_length - 1);
+        add(pieces, size, 9);
+    }
+    add(pieces, value, length);
+    add(pieces, newline, 1);
+}
+
+/// Fill in the address of the daemon's socket, and get its length.
+static socklen_t make_address(struct sockaddr_un *address, const char *path)
+{
+    size_t length = strlen(path);
+
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    if (length >= sizeof(address->sun_path))
+    {
+        length = sizeof(address->sun_path) - 1;
+    }
+    memcpy(address->sun_path, path, length);
+
+    return (socklen_t) (offsetof(struct sockaddr_un, sun_path) + length + 1);
+}
+
+/**
+ * Send a gathered message to the daemon.
+ *
+ * @return Zero if the message was sent, or an error number.
+ */
+static int transmit
+(
+    struct ll_syslog_target *sys,       ///< [in] System log target.
+    struct pieces           *pieces,    ///< [in] Message to send.
+    int                      flags      ///< [in] Flags for sendmsg().
+)
+{
+    struct sockaddr_un  address;
+    struct msghdr       message;
+    ssize_t             sent;
+
+    memset(&message, 0, sizeof(message));
+    message.msg_name    = &address;
+    message.msg_namelen = make_address(&address, sys->path);
+    message.msg_iov     = pieces->iov;
+    message.msg_iovlen  = pieces->count;
+    do
+    {
+        sent = sendmsg(sys->fd, &message, flags | MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+
+    return (sent < 0) ? errno : 0;
+}
+
+#   if HAVE_MEMFD_CREATE
+/**
+ * Send a journald entry which is too large for a datagram, by writing it to a sealed memfd and
+ * passing the file descriptor to journald.
+ *
+ * @return Zero if the entry was sent, or an error number.
+ */
+static int transmit_memfd
+(
+    struct ll_syslog_target *sys,       ///< [in] System log target.
+    struct pieces           *pieces,    ///< [in] Entry to send.
+    int                      flags      ///< [in] Flags for sendmsg().
+)
+{
+    union
+    {
+        struct cmsghdr  header;
+        char            data[CMSG_SPACE(sizeof(int))];
+    }                   control;
+    struct sockaddr_un  address;
+    struct msghdr       message;
+    struct cmsghdr     *header;
+    size_t              total = 0;
+    size_t              i;
+    ssize_t             sent;
+    int                 err = 0;
+    int                 fd;
+
+    fd = memfd_create("loglib-journal", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0)
+    {
+        return errno;
+    }
+    for (i = 0; i < pieces->count; ++i)
+    {
+        total += pieces->iov[i].iov_len;
+    }
+    sent = writev(fd, pieces->iov, (int) pieces->count);
+    if (sent < 0)
+    {
+        err = errno;
+    }
+    else if (sent != (ssize_t) total)
+    {
+        // A short write sets no error number of its own.
+        err = EIO;
+    }
+    else if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) != 0)
+    {
+        err = errno;
+    }
+    if (err != 0)
+    {
+        close(fd);
+        return err;
+    }
+
+    memset(&control, 0, sizeof(control));
+    memset(&message, 0, sizeof(message));
+    message.msg_name        = &address;
+    message.msg_namelen     = make_address(&address, sys->path);
+    message.msg_control     = &control;
+    message.msg_controllen  = sizeof(control);
+    header                  = CMSG_FIRSTHDR(&message);
+    header->cmsg_level      = SOL_SOCKET;
+    header->cmsg_type       = SCM_RIGHTS;
+    header->cmsg_len        = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(header), &fd, sizeof(int));
+    do
+    {
+        sent = sendmsg(sys->fd, &message, flags | MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    if (sent < 0)
+    {
+        err = errno;
+    }
+    close(fd);
+
+    return err;
+}
+#   endif /* end HAVE_MEMFD_CREATE */
+
+/**
+ * Send a message as a journald entry.
+ *
+ * @return Zero if the entry was sent, or an error number.
+ */
+static int send_journal
+(
+    struct ll_syslog_target *sys,       ///< [in] System log target.
+    enum ll_level            level,     ///< [in] Message level.
+    const struct fields     *fields,    ///< [in] Message fields.
+    int                      flags      ///< [in] Flags for sendmsg().
+)
+{
+    struct pieces   pieces;
+    char            numbers[64];
+    char            sizes[5][9];
+    size_t          used;
+    int             err;
+
+    pieces.count = 0;
+
+    used = sizeof("PRIORITY=") - 1;
+    memcpy(numbers, "PRIORITY=", used);
+    used += write_number(numbers + used, severity(level));
+    memcpy(numbers + used, "\nSYSLOG_FACILITY=", sizeof("\nSYSLOG_FACILITY=") - 1);
+    used += sizeof("\nSYSLOG_FACILITY=") - 1;
+    used += write_number(numbers + used, sys->facility);
+    numbers[used++] = '\n';
+    add(&pieces, numbers, used);
+
+    if (sys->identifier != NULL)
+    {
+        add_field(&pieces, "SYSLOG_IDENTIFIER=", sys->identifier, strlen(sys->identifier),
+                  sizes[0]);
+    }
+    if (fields->file != NULL)
+    {
+        add_field(&pieces, "CODE_FILE=", fields->file, fields->file_length, sizes[1]);
+        add_field(&pieces, "CODE_LINE=", fields->line, fields->line_length, sizes[2]);
+    }
+    if (fields->logger != NULL)
+    {
+        add_field(&pieces, "LOGGER=", fields->logger, fields->logger_length, sizes[3]);
+    }
+    add_field(&pieces, "MESSAGE=", fields->text, fields->text_length, sizes[4]);
+
+    err = transmit(sys, &pieces, flags);
+#   if HAVE_MEMFD_CREATE
+    if (err == EMSGSIZE || err == ENOBUFS)
+    {
+        err = transmit_memfd(sys, &pieces, flags);
+    }
+#   endif
+    return err;
+}
+
+/**
+ * Append text to a buffer.
+ *
+ * @return Non-zero if there was room for the text.
+ */
+static int append(char *buffer, size_t *used, const char *text, size_t length)
+{
+    if (length > HEADER_SIZE - *used)
+    {
+        return 0;
+    }
+    memcpy(buffer + *used, text, length);
+    *used += length;
+    return 1;
+}
+
+/**
+ * Append an RFC 5424 structured data parameter to a buffer, escaping its value.
+ *
+ * @return Non-zero if there was room for the parameter.
+ */
+static int append_param(char *buffer, size_t *used, const char *name, const char *value,
+                        size_t length)
+{
+    size_t i;
+
+    if (!append(buffer, used, name, strlen(name)) || !append(buffer, used, "=\"", 2))
+    {
+        return 0;
+    }
+    for (i = 0; i < length; ++i)
+    {
+        if ((value[i] == '"' || value[i] == '\\' || value[i] == ']') &&
+            !append(buffer, used, "\\", 1))
+        {
+            return 0;
+        }
+        if (!append(buffer, used, &value[i], 1))
+        {
+            return 0;
+        }
+    }
+    return append(buffer, used, "\"", 1);
+}
+
+/**
+ * Send a message as an RFC 5424 syslog message.
+ *
+ * @return Zero if the message was sent, or an error number.
+ */
+static int send_rfc5424
+(
+    struct ll_syslog_target *sys,       ///< [in] System log target.
+    enum ll_level            level,     ///< [in] Message level.
+    ll_timestamp_t           timestamp, ///< [in] Message time stamp, or zero if unknown.
+    const struct fields     *fields,    ///< [in] Message fields.
+    int                      flags      ///< [in] Flags for sendmsg().
+)
+{
+    struct pieces   pieces;
+    char            header[HEADER_SIZE];
+    size_t          used = 0;
+    size_t          mark;
+    size_t          length;
+    int             ok;
+
+    // PRI and VERSION.
+    header[used++] = '<';
+    used += write_number(header + used, sys->facility * 8U + severity(level));
+    header[used++] = '>';
+    header[used++] = '1';
+    header[used++] = ' ';
+
+    // TIMESTAMP.
+#   if LL_TIMESTAMP
+    if (timestamp != 0)
+    {
+        format_rfc3339(header + used, timestamp);
+        used += RFC3339_LENGTH;
+    }
+    else
+#   else
+    LL_UNUSED(timestamp);
+#   endif /* end LL_TIMESTAMP */
+    {
+        header[used++] = '-';
+    }
+    header[used++] = ' ';
+
+    // HOSTNAME, APP-NAME, PROCID and MSGID.
+    append(header, &used, sys->hostname, strlen(sys->hostname));
+    header[used++] = ' ';
+    if (sys->identifier != NULL && sys->identifier[0] != '\0')
+    {
+        length = strlen(sys->identifier);
+        append(header, &used, sys->identifier, (length < MAX_APP_NAME) ? length : MAX_APP_NAME);
+    }
+    else
+    {
+        header[used++] = '-';
+    }
+    header[used++] = ' ';
+    used += write_number(header + used, sys->pid);
+    append(header, &used, " - ", 3);
+
+    // STRUCTURED-DATA, left out if it does not fit.
+    mark = used;
+    ok = 1;
+    if (fields->file != NULL || fields->logger != NULL)
+    {
+        ok = append(header, &used, "[" LL_SYSLOG_SD_ID, sizeof(LL_SYSLOG_SD_ID));
+        if (ok && fields->file != NULL)
+        {
+            ok = append(header, &used, " ", 1) &&
+                 append_param(header, &used, "file", fields->file, fields->file_length) &&
+                 append(header, &used, " ", 1) &&
+                 append_param(header, &used, "line", fields->line, fields->line_length);
+        }
+        if (ok && fields->logger != NULL)
+        {
+            ok = append(header, &used, " ", 1) &&
+                 append_param(header, &used, "logger", fields->logger, fields->logger_length);
+        }
+        ok = ok && append(header, &used, "] ", 2);
+    }
+    if (!ok || used == mark)
+    {
+        used = mark;
+        append(header, &used, "- ", 2);
+    }
+
+    pieces.count = 0;
+    add(&pieces, header, used);
+    add(&pieces, fields->text, fields->text_length);
+
+    return transmit(sys, &pieces, flags);
+}
+
+/**
+ * Create the socket of a system log target and gather the process details.
+ *
+ * @retval  NULL        The target is ready.
+ * @retval  non-NULL    An error occured.  The returned value is a constant string describing the
+ *                      error.
+ */
+static const char *setup(struct ll_syslog_target *sys)
+{
+    sys->fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (sys->fd < 0)
+    {
+        return "Failed to create system log socket!";
+    }
+    fcntl(sys->fd, F_SETFD, FD_CLOEXEC);
+
+    sys->pid = (unsigned long) getpid();
+    if (gethostname(sys->hostname, sizeof(sys->hostname)) != 0 ||
+        memchr(sys->hostname, '\0', sizeof(sys->hostname)) == NULL ||
+        sys->hostname[0] == '\0')
+    {
+        sys->hostname[0] = '-';
+        sys->hostname[1] = '\0';
+    }
+
+    return NULL;
+}
+
+/// Set up a system log target, if that has not already been done.
+static int ready(struct ll_syslog_target *sys)
+{
+    const char *err = NULL;
+
+    if (LL_ATOMIC_LOAD_ACQUIRE(&sys->state) == STATE_NONE)
+    {
+        LOCK(sys);
+        if (LL_ATOMIC_LOAD_RELAXED(&sys->state) == STATE_NONE)
+        {
+            err = setup(sys);
+            LL_ATOMIC_STORE_RELEASE(&sys->state, (err == NULL) ? STATE_READY : STATE_FAILED);
+        }
+        UNLOCK(sys);
+        if (err != NULL)
+        {
+            REPORT(err);
+        }
+    }
+
+    return LL_ATOMIC_LOAD_ACQUIRE(&sys->state) == STATE_READY;
+}
+
+/// Send a message to the daemon in the target's protocol, and keep count of any loss.
+static void send_message
+(
+    struct ll_syslog_target *sys,       ///< [in] System log target.
+    enum ll_level            level,     ///< [in] Message level.
+    ll_timestamp_t           timestamp, ///< [in] Message time stamp, or zero if unknown.
+    const char              *message,   ///< [in] Formatted message.
+    size_t                   length,    ///< [in] Message length in bytes, excluding the terminator.
+    int                      emergency  ///< [in] Non-zero not to block or report anything.
+)
+{
+    struct fields   fields;
+    uint32_t        lost;
+    int             flags = emergency ? MSG_DONTWAIT : 0;
+    int             err;
+
+    split(message, length, &fields);
+    err = (sys->protocol == LL_SYSLOG_JOURNAL) ?
+          send_journal(sys, level, &fields, flags) :
+          send_rfc5424(sys, level, timestamp, &fields, flags);
+    if (err != 0)
+    {
+        LL_ATOMIC_FETCH_ADD(&sys->dropped, 1);
+        return;
+    }
+
+    lost = LL_ATOMIC_LOAD_RELAXED(&sys->dropped);
+    if (lost > 0 && !emergency)
+    {
+        LL_ATOMIC_FETCH_SUB(&sys->dropped, lost);
+        REPORT("System log daemon did not accept some messages!");
+    }
+}
+
+/**
+ * Send a message to the daemon if the socket is set up, keeping ll_syslog_target_close from closing
+ * it meanwhile.
+ *
+ * @return Non-zero if the socket was set up.
+ */
+static int send_if_ready
+(
+    struct ll_syslog_target *sys,       ///< [in] System log target.
+    enum ll_level            level,     ///< [in] Message level.
+    ll_timestamp_t           timestamp, ///< [in] Message time stamp, or zero if unknown.
+    const char              *message,   ///< [in] Formatted message.
+    size_t                   length,    ///< [in] Message length in bytes, excluding the terminator.
+    int                      emergency  ///< [in] Non-zero not to block or report anything.
+)
+{
+    int is_ready;
+
+    // The count is raised before the state is checked, and ll_syslog_target_close changes the state
+    // before checking the count, so that one of them always sees the other.
+    LL_ATOMIC_FETCH_ADD(&sys->users, 1);
+    is_ready = (LL_ATOMIC_LOAD_ACQUIRE(&sys->state) == STATE_READY);
+    if (is_ready)
+    {
+        send_message(sys, level, timestamp, message, length, emergency);
+    }
+    LL_ATOMIC_FETCH_SUB(&sys->users, 1);
+
+    return is_ready;
+}
+
+/// Send function of the system log target.
+void _ll_syslog_send
+(
+    struct ll_target    *target,
+    enum ll_level        level,
+    ll_timestamp_t       timestamp,
+    const char          *message,
+    size_t               length
+)
+{
+    struct ll_syslog_target *sys = (struct ll_syslog_target *) target;
+
+    assert(sys != NULL);
+    assert(sys->path != NULL);
+    assert(message != NULL);
+
+    // Set the socket up again if the target was closed before the message could be sent.
+    while (ready(sys))
+    {
+        if (send_if_ready(sys, level, timestamp, message, length, 0))
+        {
+            break;
+        }
+    }
+}
+
+/// Emergency function of the system log target.  Nothing is buffered, so only the message is sent.
+void _ll_syslog_emergency(struct ll_target *target, const char *message, size_t length)
+{
+    struct ll_syslog_target *sys = (struct ll_syslog_target *) target;
+
+    if (sys == NULL || message == NULL)
+    {
+        return;
+    }
+    send_if_ready(sys, LL_LEVEL_FATAL, 0, message, length, 1);
+}
+
+/// Close the socket of a system log target.
+void ll_syslog_target_close(struct ll_syslog_target *target)
+{
+    assert(target != NULL);
+
+    LOCK(target);
+    if (LL_ATOMIC_LOAD_RELAXED(&target->state) == STATE_READY)
+    {
+        // New messages wait on the lock to set the socket up again, so only wait for those already
+        // being sent.
+        LL_ATOMIC_STORE_RELEASE(&target->state, STATE_NONE);
+        LL_ATOMIC_FENCE();
+        while (LL_ATOMIC_LOAD_ACQUIRE(&target->users) != 0)
+        {
+            sched_yield();
+        }
+        close(target->fd);
+        target->fd = -1;
+    }
+    LL_ATOMIC_STORE_RELEASE(&target->state, STATE_NONE);
+    UNLOCK(target);
+}
+
+#endif /* end HAVE_SENDMSG */
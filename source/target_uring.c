@@ -0,0 +1,619 @@
+/**
+ * @file        target_uring.c
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       io_uring log file target implementation.
+ *
+ * The io_uring is driven with raw system calls, so that no support library is needed.  Each segment
+ * of the buffer is written with IORING_OP_WRITE_FIXED at an explicit file offset, so writes may
+ * complete in any order.  Only the thread holding the target lock touches the rings.
+ */
+#include "ll_target_uring.h"
+
+#include "common.h"
+#include "target_file.h"
+
+#if HAVE_WRITEV && HAVE_IO_URING
+#   include <assert.h>
+#   include <errno.h>
+#   include <fcntl.h>
+#   include <linux/io_uring.h>
+#   include <string.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <sys/syscall.h>
+#   include <sys/uio.h>
+#   include <unistd.h>
+
+/// Number of bytes written after each message: a newline in text mode, nothing for compact records.
+#   if LL_COMPACT
+#       define TRAILER_LENGTH 0
+#   else
+#       define TRAILER_LENGTH 1
+#   endif
+
+/// Report an error from the target.
+#   if LL_LOCATION
+#       define REPORT(err) post_error((err), NULL, 0)
+#   else
+#       define REPORT(err) post_error(err)
+#   endif
+
+/// Number of submission queue entries to request.  At most one per segment is ever outstanding.
+#   define RING_ENTRIES     8
+
+#   if LL_URING_SEGMENTS > RING_ENTRIES
+#       error "LL_URING_SEGMENTS must not exceed the number of submission queue entries"
+#   endif
+
+/// Set up states.
+#   define STATE_NONE       0   ///< The io_uring has not been set up yet.
+#   define STATE_RING       1   ///< Writes go through the io_uring.
+#   define STATE_FALLBACK   2   ///< io_uring is unavailable, so the target acts as a file target.
+
+/// Registration flags.
+#   define FIXED_FILE       0x1 ///< The file descriptor is registered.
+#   define FIXED_BUFFERS    0x2 ///< The buffer segments are registered.
+
+/**
+ * Access a 32-bit field of a ring mapping.
+ *
+ * @param   map     Ring mapping.
+ * @param   offset  Offset of the field, as reported by io_uring_setup.
+ */
+#   define RING_FIELD(map, offset) ((volatile uint32_t *) ((char *) (map) + (offset)))
+
+/// Size of each buffer segment.
+#   define SEGMENT_SIZE(ring) ((ring)->file.size / LL_URING_SEGMENTS)
+
+/// Start of a buffer segment.
+#   define SEGMENT(ring, index) ((ring)->file.buffer + (size_t) (index) * SEGMENT_SIZE(ring))
+
+/// Unmap the rings, after setup has failed part way.
+static void unmap_rings(struct ll_uring_target *ring)
+{
+    if (ring->sqes != NULL)
+    {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_map != NULL && ring->cq_map != ring->sq_map)
+    {
+        munmap(ring->cq_map, ring->cq_map_size);
+    }
+    if (ring->sq_map != NULL)
+    {
+        munmap(ring->sq_map, ring->sq_map_size);
+    }
+    ring->sqes      = NULL;
+    ring->cq_map    = NULL;
+    ring->sq_map    = NULL;
+}
+
+/// Unregister the file and buffer segments from the io_uring.
+static void unregister(struct ll_uring_target *ring)
+{
+    if (ring->flags & FIXED_BUFFERS)
+    {
+        syscall(__NR_io_uring_register, ring->ring_fd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+    }
+    if (ring->flags & FIXED_FILE)
+    {
+        syscall(__NR_io_uring_register, ring->ring_fd, IORING_UNREGISTER_FILES, NULL, 0);
+    }
+    ring->flags = 0;
+}
+
+/**
+ * Set up the io_uring and register the file and buffer segments with it.
+ *
+ * @return Non-zero if the io_uring is ready for use.
+ */
+static int setup(struct ll_uring_target *ring)
+{
+    struct io_uring_params  params;
+    struct iovec            segments[LL_URING_SEGMENTS];
+    struct stat             info;
+    void                   *map;
+    int                     flags;
+    unsigned int            i;
+
+    if (SEGMENT_SIZE(ring) == 0)
+    {
+        return 0;
+    }
+    // Writes are made at explicit offsets, starting from the end of the file, and O_APPEND would
+    // make Linux ignore the offsets.
+    flags = fcntl(ring->file.fd, F_GETFL);
+    if (flags == -1 || fstat(ring->file.fd, &info) != 0)
+    {
+        return 0;
+    }
+
+    memset(&params, 0, sizeof(params));
+    ring->ring_fd = (int) syscall(__NR_io_uring_setup, RING_ENTRIES, &params);
+    if (ring->ring_fd < 0)
+    {
+        return 0;
+    }
+
+    ring->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    ring->cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0 && ring->cq_map_size > ring->sq_map_size)
+    {
+        ring->sq_map_size = ring->cq_map_size;
+    }
+    map = mmap(NULL, ring->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+               ring->ring_fd, IORING_OFF_SQ_RING);
+    if (map == MAP_FAILED)
+    {
+        goto fail;
+    }
+    ring->sq_map = map;
+
+    if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0)
+    {
+        ring->cq_map = ring->sq_map;
+    }
+    else
+    {
+        map = mmap(NULL, ring->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   ring->ring_fd, IORING_OFF_CQ_RING);
+        if (map == MAP_FAILED)
+        {
+            goto fail;
+        }
+        ring->cq_map = map;
+    }
+
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    map = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+               ring->ring_fd, IORING_OFF_SQES);
+    if (map == MAP_FAILED)
+    {
+        goto fail;
+    }
+    ring->sqes = map;
+
+    ring->sq_fields[0] = params.sq_off.head;
+    ring->sq_fields[1] = params.sq_off.tail;
+    ring->sq_fields[2] = params.sq_off.ring_mask;
+    ring->sq_fields[3] = params.sq_off.array;
+    ring->cq_fields[0] = params.cq_off.head;
+    ring->cq_fields[1] = params.cq_off.tail;
+    ring->cq_fields[2] = params.cq_off.ring_mask;
+    ring->cq_fields[3] = params.cq_off.cqes;
+
+    // Registering the file and buffers saves the kernel looking them up for every write, but the
+    // io_uring works without, for instance if the buffers exceed the locked memory limit.
+    ring->flags = 0;
+    if (syscall(__NR_io_uring_register, ring->ring_fd, IORING_REGISTER_FILES, &ring->file.fd,
+                1) == 0)
+    {
+        ring->flags |= FIXED_FILE;
+    }
+    for (i = 0; i < LL_URING_SEGMENTS; ++i)
+    {
+        segments[i].iov_base    = SEGMENT(ring, i);
+        segments[i].iov_len     = SEGMENT_SIZE(ring);
+    }
+    if (syscall(__NR_io_uring_register, ring->ring_fd, IORING_REGISTER_BUFFERS, segments,
+                LL_URING_SEGMENTS) == 0)
+    {
+        ring->flags |= FIXED_BUFFERS;
+    }
+
+    if ((flags & O_APPEND) != 0 && fcntl(ring->file.fd, F_SETFL, flags & ~O_APPEND) != 0)
+    {
+        unregister(ring);
+        goto fail;
+    }
+    ring->offset    = (uint64_t) info.st_size;
+    ring->current   = 0;
+    ring->file.used = 0;
+    memset(ring->pending, 0, sizeof(ring->pending));
+    return 1;
+
+fail:
+    unmap_rings(ring);
+    close(ring->ring_fd);
+    ring->ring_fd = -1;
+    return 0;
+}
+
+/**
+ * Set up the target the first time it is used.  The target must be locked by the caller.
+ *
+ * @return Non-zero if writes go through the io_uring, or zero if the target acts as a file target.
+ */
+static int ready(struct ll_uring_target *ring)
+{
+    if (ring->state == STATE_NONE)
+    {
+        ring->state = setup(ring) ? STATE_RING : STATE_FALLBACK;
+    }
+    return ring->state == STATE_RING;
+}
+
+/// Write out data at a file offset synchronously, when a write through the io_uring fell short or
+/// could not be submitted.
+static void write_at(struct ll_uring_target *ring, const char *data, size_t length, uint64_t offset)
+{
+    ssize_t n;
+
+    while (length > 0)
+    {
+        n = pwrite(ring->file.fd, data, length, (off_t) offset);
+        if (n <= 0)
+        {
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            REPORT("Failed to write log file!");
+            return;
+        }
+        data    += n;
+        length  -= (size_t) n;
+        offset  += (uint64_t) n;
+    }
+}
+
+/// Collect the completions of finished writes.
+static void reap(struct ll_uring_target *ring)
+{
+    volatile uint32_t       *head = RING_FIELD(ring->cq_map, ring->cq_fields[0]);
+    volatile uint32_t       *tail = RING_FIELD(ring->cq_map, ring->cq_fields[1]);
+    uint32_t                 mask = *RING_FIELD(ring->cq_map, ring->cq_fields[2]);
+    struct io_uring_cqe     *cqes = (struct io_uring_cqe *) ((char *) ring->cq_map +
+                                                             ring->cq_fields[3]);
+    struct io_uring_cqe     *cqe;
+    uint32_t                 index = *head;
+    unsigned int             segment;
+
+    while (index != LL_ATOMIC_LOAD_ACQUIRE(tail))
+    {
+        cqe     = &cqes[index & mask];
+        segment = (unsigned int) cqe->user_data;
+        if (cqe->res < 0)
+        {
+            REPORT("Failed to write log file!");
+        }
+        else if ((size_t) cqe->res < ring->pending[segment])
+        {
+            write_at(ring,
+                     SEGMENT(ring, segment) + cqe->res,
+                     ring->pending[segment] - (size_t) cqe->res,
+                     ring->offsets[segment] + (uint64_t) cqe->res);
+        }
+        ring->pending[segment] = 0;
+        ++index;
+        LL_ATOMIC_STORE_RELEASE(head, index);
+    }
+}
+
+/// Wait until the write from a segment has completed.
+static void wait_for(struct ll_uring_target *ring, unsigned int segment)
+{
+    reap(ring);
+    while (ring->pending[segment] != 0)
+    {
+        if (syscall(__NR_io_uring_enter, ring->ring_fd, 0, 1, IORING_ENTER_GETEVENTS, NULL,
+                    0) < 0 && errno != EINTR)
+        {
+            REPORT("Failed to wait for log file write!");
+            ring->pending[segment] = 0;
+            return;
+        }
+        reap(ring);
+    }
+}
+
+/**
+ * Submit the current segment for writing, and move on to the next one, waiting for it to be free.
+ * The target must be locked by the caller.
+ */
+static void submit(struct ll_uring_target *ring)
+{
+    volatile uint32_t   *head   = RING_FIELD(ring->sq_map, ring->sq_fields[0]);
+    volatile uint32_t   *tail   = RING_FIELD(ring->sq_map, ring->sq_fields[1]);
+    uint32_t             mask   = *RING_FIELD(ring->sq_map, ring->sq_fields[2]);
+    volatile uint32_t   *array  = RING_FIELD(ring->sq_map, ring->sq_fields[3]);
+    uint32_t             index  = *tail;
+    unsigned int         segment = ring->current;
+    struct io_uring_sqe *sqe    = (struct io_uring_sqe *) ring->sqes + (index & mask);
+
+    if (ring->file.used == 0)
+    {
+        return;
+    }
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->off        = ring->offset;
+    sqe->addr       = (uint64_t) (uintptr_t) SEGMENT(ring, segment);
+    sqe->len        = (uint32_t) ring->file.used;
+    sqe->user_data  = segment;
+    if (ring->flags & FIXED_FILE)
+    {
+        sqe->flags  = IOSQE_FIXED_FILE;
+        sqe->fd     = 0;
+    }
+    else
+    {
+        sqe->fd     = ring->file.fd;
+    }
+    if (ring->flags & FIXED_BUFFERS)
+    {
+        sqe->opcode     = IORING_OP_WRITE_FIXED;
+        sqe->buf_index  = (uint16_t) segment;
+    }
+    else
+    {
+        sqe->opcode     = IORING_OP_WRITE;
+    }
+    array[index & mask] = index & mask;
+    LL_ATOMIC_STORE_RELEASE(tail, index + 1);
+
+    ring->pending[segment]  = ring->file.used;
+    ring->offsets[segment]  = ring->offset;
+    ring->offset           += ring->file.used;
+
+    if (syscall(__NR_io_uring_enter, ring->ring_fd, 1, 0, 0, NULL, 0) < 1 &&
+        LL_ATOMIC_LOAD_ACQUIRE(head) == index)
+    {
+        // The kernel did not take the entry, for instance for lack of memory (EAGAIN) or with the
+        // completion queue full (EBUSY), so no completion will come for it.  Withdraw it and write
+        // the segment out synchronously instead.
+        LL_ATOMIC_STORE_RELEASE(tail, index);
+        write_at(ring, SEGMENT(ring, segment), ring->pending[segment], ring->offsets[segment]);
+        ring->pending[segment] = 0;
+    }
+
+    ring->current   = (segment + 1) % LL_URING_SEGMENTS;
+    ring->file.used = 0;
+    if (ring->pending[ring->current] != 0)
+    {
+        wait_for(ring, ring->current);
+    }
+}
+
+/**
+ * Account for a message just placed in the current segment, and submit the segment if the message
+ * calls for it.  The target must be locked by the caller.
+ */
+static void append
+(
+    struct ll_uring_target  *ring,      ///< [in] io_uring target.
+    enum ll_level            level,     ///< [in] Message level.
+    ll_timestamp_t           timestamp, ///< [in] Message time stamp.
+    size_t                   length     ///< [in] Message length in bytes, excluding the trailer.
+)
+{
+    int due = file_due(&ring->file, level, timestamp, ring->file.used == 0);
+
+    ring->file.used += length + TRAILER_LENGTH;
+    if (due)
+    {
+        submit(ring);
+    }
+}
+
+/// Send function of the io_uring target.
+void _ll_uring_send
+(
+    struct ll_target    *target,
+    enum ll_level        level,
+    ll_timestamp_t       timestamp,
+    const char          *message,
+    size_t               length
+)
+{
+    struct ll_uring_target *ring = (struct ll_uring_target *) target;
+    unsigned int            i;
+
+    assert(ring != NULL);
+    assert(message != NULL);
+
+    LOCK(&ring->file);
+    if (!ready(ring))
+    {
+        file_append(&ring->file, level, timestamp, message, length);
+        UNLOCK(&ring->file);
+        return;
+    }
+
+    if (length + TRAILER_LENGTH > SEGMENT_SIZE(ring) - ring->file.used)
+    {
+        submit(ring);
+    }
+    if (length + TRAILER_LENGTH > SEGMENT_SIZE(ring))
+    {
+        // Too large for a segment, so write it out directly once everything before it is written.
+        for (i = 0; i < LL_URING_SEGMENTS; ++i)
+        {
+            wait_for(ring, i);
+        }
+        write_at(ring, message, length, ring->offset);
+        ring->offset += length;
+#   if !LL_COMPACT
+        write_at(ring, "\n", 1, ring->offset);
+        ring->offset += 1;
+#   endif
+    }
+    else
+    {
+        memcpy(SEGMENT(ring, ring->current) + ring->file.used, message, length);
+#   if !LL_COMPACT
+        SEGMENT(ring, ring->current)[ring->file.used + length] = '\n';
+#   endif
+        append(ring, level, timestamp, length);
+    }
+    UNLOCK(&ring->file);
+}
+
+/// Reserve function of the io_uring target.  The target stays locked until the commit.
+char *_ll_uring_reserve(struct ll_target *target, size_t size)
+{
+    struct ll_uring_target *ring = (struct ll_uring_target *) target;
+
+    assert(ring != NULL);
+
+    LOCK(&ring->file);
+    if (!ready(ring))
+    {
+        UNLOCK(&ring->file);
+        return _ll_file_reserve(target, size);
+    }
+    if (size > SEGMENT_SIZE(ring))
+    {
+        UNLOCK(&ring->file);
+        return NULL;
+    }
+    if (size > SEGMENT_SIZE(ring) - ring->file.used)
+    {
+        submit(ring);
+    }
+    return SEGMENT(ring, ring->current) + ring->file.used;
+}
+
+/// Commit function of the io_uring target.
+void _ll_uring_commit
+(
+    struct ll_target    *target,
+    enum ll_level        level,
+    ll_timestamp_t       timestamp,
+    char                *message,
+    size_t               length
+)
+{
+    struct ll_uring_target *ring = (struct ll_uring_target *) target;
+
+    assert(ring != NULL);
+
+    if (ring->state != STATE_RING)
+    {
+        _ll_file_commit(target, level, timestamp, message, length);
+        return;
+    }
+
+    assert(message == SEGMENT(ring, ring->current) + ring->file.used);
+    if (length > 0)
+    {
+#   if LL_COMPACT
+        LL_UNUSED(message);
+#   else
+        // The message terminator becomes the newline.
+        message[length] = '\n';
+#   endif
+        append(ring, level, timestamp, length);
+    }
+    UNLOCK(&ring->file);
+}
+
+/// Flush function of the io_uring target.
+void _ll_uring_flush(struct ll_target *target)
+{
+    struct ll_uring_target *ring = (struct ll_uring_target *) target;
+    unsigned int            i;
+
+    assert(ring != NULL);
+
+    LOCK(&ring->file);
+    if (ring->state == STATE_RING)
+    {
+        submit(ring);
+        for (i = 0; i < LL_URING_SEGMENTS; ++i)
+        {
+            wait_for(ring, i);
+        }
+    }
+    else
+    {
+        file_write_out(&ring->file);
+    }
+    UNLOCK(&ring->file);
+}
+
+/**
+ * Emergency function of the io_uring target.  The target is not locked.  Writes which may still be
+ * in flight are repeated synchronously, which is harmless as they are made at the same offsets.
+ */
+void _ll_uring_emergency(struct ll_target *target, const char *message, size_t length)
+{
+    struct ll_uring_target *ring = (struct ll_uring_target *) target;
+    unsigned int            i;
+
+    if (ring == NULL || ring->state != STATE_RING)
+    {
+        _ll_file_emergency(target, message, length);
+        return;
+    }
+
+    for (i = 0; i < LL_URING_SEGMENTS; ++i)
+    {
+        if (ring->pending[i] != 0)
+        {
+            emergency_pwrite(ring->file.fd, SEGMENT(ring, i), ring->pending[i], ring->offsets[i]);
+        }
+    }
+
+    if (message != NULL && length + TRAILER_LENGTH <= SEGMENT_SIZE(ring) - ring->file.used)
+    {
+        memcpy(SEGMENT(ring, ring->current) + ring->file.used, message, length);
+#   if !LL_COMPACT
+        SEGMENT(ring, ring->current)[ring->file.used + length] = '\n';
+#   endif
+        ring->file.used += length + TRAILER_LENGTH;
+        message = NULL;
+    }
+
+    emergency_pwrite(ring->file.fd, SEGMENT(ring, ring->current), ring->file.used, ring->offset);
+    ring->offset    += ring->file.used;
+    ring->file.used  = 0;
+    if (message != NULL)
+    {
+        emergency_pwrite(ring->file.fd, message, length, ring->offset);
+        ring->offset += length;
+#   if !LL_COMPACT
+        emergency_pwrite(ring->file.fd, "\n", 1, ring->offset);
+        ring->offset += 1;
+#   endif
+    }
+}
+
+/// Stop writing to the file of an io_uring target, and release the io_uring.
+void ll_uring_target_close(struct ll_uring_target *target)
+{
+    unsigned int i;
+
+    assert(target != NULL);
+
+    LOCK(&target->file);
+    if (target->state == STATE_RING)
+    {
+        submit(target);
+        for (i = 0; i < LL_URING_SEGMENTS; ++i)
+        {
+            wait_for(target, i);
+        }
+        unregister(target);
+        unmap_rings(target);
+        close(target->ring_fd);
+        target->ring_fd = -1;
+
+        // Leave the file positioned after the last message, for whoever writes to it next.
+        if (lseek(target->file.fd, (off_t) target->offset, SEEK_SET) < 0)
+        {
+            REPORT("Failed to seek log file!");
+        }
+        target->state = STATE_NONE;
+    }
+    else
+    {
+        file_write_out(&target->file);
+    }
+    UNLOCK(&target->file);
+}
+
+#endif /* end HAVE_WRITEV && HAVE_IO_URING */
@@ -0,0 +1,227 @@
+/**
+ * @file        timestamp.c
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       Time stamp formatting.
+ *
+ * Converting a time to a calendar date is relatively expensive, and with local time it may also
+ * take a process-wide lock inside the C library.  Since many messages are usually logged within the
+ * same second, the "YYYY-MM-DD HH:MM:SS" text for the most recent second is kept in a cache guarded
+ * by a sequence lock.  Readers never block: if the cache is being updated or holds a different
+ * second, the reader converts the time itself and tries to update the cache.
+ */
+#include "timestamp.h"
+
+#include "port.h"
+
+#include <assert.h>
+#include <string.h>
+
+#if LL_TIMESTAMP
+
+/// Length of the date and time of day portion of a time stamp.
+#   define SECONDS_LENGTH 19
+
+/// Sequence number of the cache.  Odd while the cache is being updated.
+static volatile uint32_t    sequence;
+/// Second which the cached text describes.
+static volatile time_t      cached_seconds = (time_t) -1;
+/// Cached date and time of day text.
+static volatile char        cached_text[SECONDS_LENGTH];
+
+/**
+ * Write a zero-padded decimal number.
+ */
+static void write_digits
+(
+    char            *buffer,    ///< [out] Buffer to write into.
+    unsigned long    value,     ///< [in]  Value to write.
+    int              width      ///< [in]  Number of digits to write.
+)
+{
+    while (width-- > 0)
+    {
+        buffer[width] = (char) ('0' + value % 10U);
+        value /= 10U;
+    }
+}
+
+/**
+ * Convert a time to "YYYY-MM-DD HH:MM:SS" text.
+ *
+ * @retval  NULL        Operation was successful.
+ * @retval  non-NULL    An error occured.  The returned value is a constant string describing the
+ *                      error.
+ */
+static const char *convert(char *buffer, time_t seconds)
+{
+    struct tm tm;
+
+    if (LL_CONVERT_TIME(seconds, &tm) < 0)
+    {
+        return "Time conversion overflow!";
+    }
+    if (tm.tm_year < -1900 || tm.tm_year > 9999 - 1900)
+    {
+        return "Time stamp year out of range!";
+    }
+
+    write_digits(buffer,      (unsigned long) tm.tm_year + 1900U, 4);
+    buffer[4] = '-';
+    write_digits(buffer + 5,  (unsigned long) tm.tm_mon + 1U,     2);
+    buffer[7] = '-';
+    write_digits(buffer + 8,  (unsigned long) tm.tm_mday,         2);
+    buffer[10] = ' ';
+    write_digits(buffer + 11, (unsigned long) tm.tm_hour,         2);
+    buffer[13] = ':';
+    write_digits(buffer + 14, (unsigned long) tm.tm_min,          2);
+    buffer[16] = ':';
+    write_digits(buffer + 17, (unsigned long) tm.tm_sec,          2);
+
+    return NULL;
+}
+
+/// Write the fractional seconds of a time stamp, with the decimal point.
+static void write_fraction(char *buffer, ll_timestamp_t timestamp)
+{
+    uint32_t nanoseconds = (uint32_t) (timestamp % 1000000000U);
+
+    buffer[0] = '.';
+#   if LL_TIMESTAMP_DIGITS == 3
+    write_digits(buffer + 1, nanoseconds / 1000000U, 3);
+#   elif LL_TIMESTAMP_DIGITS == 6
+    write_digits(buffer + 1, nanoseconds / 1000U, 6);
+#   else
+    write_digits(buffer + 1, nanoseconds, 9);
+#   endif
+}
+
+/// Write a formatted time stamp into a buffer.
+const char *format_timestamp(char *buffer, ll_timestamp_t timestamp)
+{
+    const char  *err;
+    time_t       seconds = (time_t) (timestamp / 1000000000U);
+    uint32_t     before;
+    int          i;
+    int          hit = 0;
+
+    assert(buffer != NULL);
+
+    // Try the cache first.
+    before = LL_ATOMIC_LOAD_ACQUIRE(&sequence);
+    if ((before & 1U) == 0 && cached_seconds == seconds)
+    {
+        for (i = 0; i < SECONDS_LENGTH; ++i)
+        {
+            buffer[i] = cached_text[i];
+        }
+        LL_ATOMIC_FENCE();
+        hit = (LL_ATOMIC_LOAD_RELAXED(&sequence) == before);
+    }
+
+    if (!hit)
+    {
+        err = convert(buffer, seconds);
+        if (err != NULL)
+        {
+            return err;
+        }
+
+        // Update the cache, unless another thread is already doing so.
+        if ((before & 1U) == 0 && LL_ATOMIC_CAS(&sequence, before, before + 1U))
+        {
+            cached_seconds = seconds;
+            for (i = 0; i < SECONDS_LENGTH; ++i)
+            {
+                cached_text[i] = buffer[i];
+            }
+            LL_ATOMIC_STORE_RELEASE(&sequence, before + 2U);
+        }
+    }
+
+    write_fraction(buffer + SECONDS_LENGTH, timestamp);
+
+    return NULL;
+}
+
+/**
+ * Convert a time to "YYYY-MM-DD HH:MM:SS" text as UTC, with arithmetic alone.
+ */
+static void convert_utc
+(
+    char        *buffer,    ///< [out] Buffer of at least SECONDS_LENGTH characters.
+    uint64_t     seconds    ///< [in]  Seconds since the Epoch.
+)
+{
+    uint64_t     days;
+    uint64_t     era;
+    uint64_t     year;
+    unsigned int day;
+    unsigned int month;
+
+    // Convert the day number to a civil date, with years starting in March.
+    days    = seconds / 86400U + 719468U;
+    era     = days / 146097U;
+    days   -= era * 146097U;
+    year    = (days - days / 1460U + days / 36524U - days / 146096U) / 365U;
+    days   -= 365U * year + year / 4U - year / 100U;
+    month   = (unsigned int) ((5U * days + 2U) / 153U);
+    day     = (unsigned int) (days - (153U * month + 2U) / 5U + 1U);
+    month   = (month < 10U) ? month + 3U : month - 9U;
+    year   += era * 400U + (month <= 2U);
+
+    write_digits(buffer,      (unsigned long) year,                       4);
+    buffer[4] = '-';
+    write_digits(buffer + 5,  month,                                      2);
+    buffer[7] = '-';
+    write_digits(buffer + 8,  day,                                        2);
+    buffer[10] = ' ';
+    write_digits(buffer + 11, (unsigned long) (seconds / 3600U % 24U),    2);
+    buffer[13] = ':';
+    write_digits(buffer + 14, (unsigned long) (seconds / 60U % 60U),      2);
+    buffer[16] = ':';
+    write_digits(buffer + 17, (unsigned long) (seconds % 60U),            2);
+}
+
+/// Write a formatted time stamp into a buffer, as is safe in a signal handler.
+void format_timestamp_safe(char *buffer, ll_timestamp_t timestamp)
+{
+    uint64_t     seconds = timestamp / 1000000000U;
+    uint32_t     before;
+    unsigned int i;
+    int          hit = 0;
+
+    assert(buffer != NULL);
+
+    before = LL_ATOMIC_LOAD_ACQUIRE(&sequence);
+    if ((before & 1U) == 0 && cached_seconds == (time_t) seconds)
+    {
+        for (i = 0; i < SECONDS_LENGTH; ++i)
+        {
+            buffer[i] = cached_text[i];
+        }
+        LL_ATOMIC_FENCE();
+        hit = (LL_ATOMIC_LOAD_RELAXED(&sequence) == before);
+    }
+
+    if (!hit)
+    {
+        convert_utc(buffer, seconds);
+    }
+    write_fraction(buffer + SECONDS_LENGTH, timestamp);
+}
+
+/// Write a time stamp as RFC 3339 text in UTC.
+void format_rfc3339(char *buffer, ll_timestamp_t timestamp)
+{
+    assert(buffer != NULL);
+
+    convert_utc(buffer, timestamp / 1000000000U);
+    buffer[10] = 'T';
+    write_fraction(buffer + SECONDS_LENGTH, timestamp);
+    buffer[TIMESTAMP_LENGTH] = 'Z';
+}
+
+#endif /* end LL_TIMESTAMP */
@@ -0,0 +1,70 @@
+/**
+ * @file        timestamp.h
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       Time stamp formatting.
+ */
+#ifndef TIMESTAMP_H_
+#define TIMESTAMP_H_
+
+#include "ll_internal.h"
+
+#include <stddef.h>
+
+#if LL_TIMESTAMP
+
+#   if LL_TIMESTAMP_DIGITS != 3 && LL_TIMESTAMP_DIGITS != 6 && LL_TIMESTAMP_DIGITS != 9
+#       error Time stamps must have 3, 6, or 9 fractional digits!
+#   endif
+
+/// Length of a formatted time stamp, "YYYY-MM-DD HH:MM:SS.fff", in characters.
+#   define TIMESTAMP_LENGTH (20 + LL_TIMESTAMP_DIGITS)
+
+/**
+ * Write a formatted time stamp into a buffer.  Exactly TIMESTAMP_LENGTH characters are written and
+ * no terminator is added.
+ *
+ * The date and time of day are converted at most once per second; other calls in the same second
+ * copy the cached text.  The cache may be used by any number of threads concurrently.
+ *
+ * @retval  NULL        Operation was successful and the time stamp was written to the buffer.
+ * @retval  non-NULL    An error occured.  The returned value is a constant string describing the
+ *                      error.
+ */
+const char *format_timestamp
+(
+    char            *buffer,    ///< [out] Buffer of at least TIMESTAMP_LENGTH characters.
+    ll_timestamp_t   timestamp  ///< [in]  Time stamp, in nanoseconds since the Epoch.
+);
+
+/**
+ * Write a formatted time stamp into a buffer without taking any lock or calling the C library, as
+ * is safe in a signal handler.  The cached text is used if it is for the same second; otherwise the
+ * time stamp is converted as UTC, whether or not local time is configured.  Exactly
+ * TIMESTAMP_LENGTH characters are written and no terminator is added.
+ */
+void format_timestamp_safe
+(
+    char            *buffer,    ///< [out] Buffer of at least TIMESTAMP_LENGTH characters.
+    ll_timestamp_t   timestamp  ///< [in]  Time stamp, in nanoseconds since the Epoch.
+);
+
+/// Length of an RFC 3339 time stamp, "YYYY-MM-DDTHH:MM:SS.fffZ", in characters.
+#   define RFC3339_LENGTH (TIMESTAMP_LENGTH + 1)
+
+/**
+ * Write a time stamp as RFC 3339 text in UTC, as used by syslog.  Exactly RFC3339_LENGTH characters
+ * are written and no terminator is added.  The cache is not used, so this is safe in a signal
+ * handler.
+ */
+void format_rfc3339
+(
+    char            *buffer,    ///< [out] Buffer of at least RFC3339_LENGTH characters.
+    ll_timestamp_t   timestamp  ///< [in]  Time stamp, in nanoseconds since the Epoch.
+);
+
+#endif /* end LL_TIMESTAMP */
+
+#endif /* end TIMESTAMP_H_ */
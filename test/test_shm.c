@@ -0,0 +1,297 @@
+/**
+ * @file        test_shm.c
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       Shared memory target test, with a local collector and forked workers.
+ *
+ * Checks that every message of every worker is collected in order, that a worker started before
+ * the collector attaches once it exists, that a worker which dies between reserving and committing
+ * a record is skipped while a stopped one is waited for, and that workers move to the ring of a
+ * restarted collector.
+ */
+#include "ll_target_shm.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/// Number of messages logged by each worker in each phase.
+#define COUNT 1000
+
+/// Number of workers which only log.
+#define WORKERS 4
+
+/// Worker which starts before the collector and outlives a collector restart.
+#define EARLY 0
+
+/// Worker which dies with a record reserved.
+#define DEAD 1
+
+/// Worker which is stopped with a record reserved.
+#define STOPPED 2
+
+/// First worker which only logs.
+#define FIRST 3
+
+/// Total number of workers.
+#define TOTAL (FIRST + WORKERS)
+
+/// Size of the ring data area.
+#define RING_SIZE (1 << 21)
+
+/// Longest time to wait for messages, in seconds.
+#define TIMEOUT 10
+
+/// Layout of the records of the shared memory target, for the workers which reserve one directly.
+struct record
+{
+    ll_timestamp_t   timestamp; ///< Message time stamp.
+    uint32_t         level;     ///< Message level.
+    uint32_t         pid;       ///< Process which added the message.
+};
+
+/// Name of the shared memory object.
+static char Name[64];
+
+/// Next message number expected from each worker.
+static int Expected[TOTAL];
+
+/// Set when a message arrives out of order.
+static int Failed;
+
+/// Send function of the target counting the collected messages.
+static void count_send
+(
+    struct ll_target    *target,
+    enum ll_level        level,
+    ll_timestamp_t       timestamp,
+    const char          *message,
+    size_t               length
+)
+{
+    const char  *text = strstr(message, "worker ");
+    int          worker;
+    int          number;
+
+    (void) target;
+    (void) level;
+    (void) timestamp;
+    (void) length;
+
+    if (text == NULL || sscanf(text, "worker %d message %d", &worker, &number) != 2 ||
+        worker < 0 || worker >= TOTAL || number != Expected[worker])
+    {
+        fprintf(stderr, "Unexpected message: %s\n", message);
+        Failed = 1;
+        return;
+    }
+    ++Expected[worker];
+}
+
+/// Target counting the collected messages.
+static struct ll_target Counter = LL_TARGET_INIT(NULL, &count_send);
+
+/// Shared memory target of the workers.
+static struct ll_shm_target Shm = LL_SHM_TARGET_INIT(NULL, Name);
+
+/// Log of the workers.
+static struct ll_log Log = LL_LOG_INIT("test", NULL, LL_LEVEL_DEBUG, NULL, &Shm.target);
+
+/// Log messages from a worker.
+static void log_messages(int worker, int first, int count)
+{
+    int i;
+
+    for (i = first; i < first + count; ++i)
+    {
+        LL_LOG(&Log, LL_LEVEL_INFO, "worker %d message %d", worker, i);
+    }
+}
+
+/// Reserve a record as a worker does, without committing it.
+static struct record *reserve(void)
+{
+    struct record *record = ll_ring_reserve(&Shm.shm->ring, sizeof(*record) + 64);
+
+    if (record == NULL)
+    {
+        _exit(EXIT_FAILURE);
+    }
+    record->pid = (uint32_t) getpid();
+    return record;
+}
+
+/// Collect messages until a worker has sent a given number, or the time out expires.
+static int collect_until(struct ll_shm_collector *collector, int worker, int count)
+{
+    time_t limit = time(NULL) + TIMEOUT;
+
+    while (Expected[worker] < count)
+    {
+        if (ll_shm_collect(collector, &Counter, COUNT) == 0)
+        {
+            if (time(NULL) > limit)
+            {
+                fprintf(stderr, "Timed out waiting for worker %d: %d of %d messages\n", worker,
+                        Expected[worker], count);
+                return -1;
+            }
+            usleep(1000);
+        }
+    }
+    return 0;
+}
+
+/// Fork a worker process.
+static pid_t start(void)
+{
+    pid_t pid = fork();
+
+    if (pid < 0)
+    {
+        perror("fork");
+        exit(EXIT_FAILURE);
+    }
+    return pid;
+}
+
+/// Test entry point.
+int main(void)
+{
+    struct ll_shm_collector  collector;
+    struct record           *record;
+    time_t                   limit;
+    pid_t                    early;
+    pid_t                    stopped;
+    pid_t                    pid;
+    int                      go[2];
+    int                      status;
+    int                      i;
+    char                     byte = 0;
+
+    snprintf(Name, sizeof(Name), "/ll-test-shm-%ld", (long) getpid());
+    if (pipe(go) != 0)
+    {
+        perror("pipe");
+        return EXIT_FAILURE;
+    }
+
+    // The early worker keeps trying to attach until the collector exists.
+    early = start();
+    if (early == 0)
+    {
+        limit = time(NULL) + TIMEOUT;
+        while (ll_shm_target_attach(&Shm) != 0)
+        {
+            if (time(NULL) > limit)
+            {
+                _exit(EXIT_FAILURE);
+            }
+            usleep(1000);
+        }
+        log_messages(EARLY, 0, COUNT);
+        if (read(go[0], &byte, 1) != 1)
+        {
+            _exit(EXIT_FAILURE);
+        }
+        log_messages(EARLY, COUNT, COUNT);
+        _exit(EXIT_SUCCESS);
+    }
+    usleep(50000);
+
+    if (ll_shm_collector_open(&collector, Name, RING_SIZE) != 0)
+    {
+        fprintf(stderr, "Failed to open the collector\n");
+        return EXIT_FAILURE;
+    }
+
+    // A worker which dies with a record reserved must not hold up the others for good.
+    pid = start();
+    if (pid == 0)
+    {
+        log_messages(DEAD, 0, 1);
+        reserve();
+        _exit(EXIT_SUCCESS);
+    }
+    waitpid(pid, &status, 0);
+
+    // A worker which is only stopped must be waited for.
+    stopped = start();
+    if (stopped == 0)
+    {
+        log_messages(STOPPED, 0, 1);
+        record = reserve();
+        raise(SIGSTOP);
+        record->timestamp   = 0;
+        record->level       = LL_LEVEL_INFO;
+        i = snprintf((char *) (record + 1), 64, "worker %d message 1", STOPPED);
+        ll_ring_commit(&Shm.shm->ring, record, sizeof(*record) + (size_t) i + 1);
+        _exit(EXIT_SUCCESS);
+    }
+    waitpid(stopped, &status, WUNTRACED);
+
+    for (i = 0; i < WORKERS; ++i)
+    {
+        if (start() == 0)
+        {
+            log_messages(FIRST + i, 0, COUNT);
+            _exit(EXIT_SUCCESS);
+        }
+    }
+
+    // Everything up to the stopped worker's record arrives, and then nothing until it carries on.
+    if (collect_until(&collector, DEAD, 1) != 0 || collect_until(&collector, STOPPED, 1) != 0)
+    {
+        return EXIT_FAILURE;
+    }
+    sleep(1);
+    ll_shm_collect(&collector, &Counter, COUNT);
+    if (Expected[STOPPED] != 1)
+    {
+        fprintf(stderr, "The record of the stopped worker was skipped\n");
+        return EXIT_FAILURE;
+    }
+    kill(stopped, SIGCONT);
+
+    for (i = FIRST; i < TOTAL; ++i)
+    {
+        if (collect_until(&collector, i, COUNT) != 0)
+        {
+            return EXIT_FAILURE;
+        }
+    }
+    if (collect_until(&collector, STOPPED, 2) != 0 || collect_until(&collector, EARLY, COUNT) != 0)
+    {
+        return EXIT_FAILURE;
+    }
+
+    // After a restart of the collector, the early worker moves to the new ring.
+    ll_shm_collector_close(&collector);
+    if (ll_shm_collector_open(&collector, Name, RING_SIZE) != 0)
+    {
+        fprintf(stderr, "Failed to reopen the collector\n");
+        return EXIT_FAILURE;
+    }
+    if (write(go[1], &byte, 1) != 1 || collect_until(&collector, EARLY, 2 * COUNT) != 0)
+    {
+        return EXIT_FAILURE;
+    }
+
+    while ((pid = wait(&status)) > 0)
+    {
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+        {
+            fprintf(stderr, "Worker %ld failed\n", (long) pid);
+            Failed = 1;
+        }
+    }
+    ll_shm_collector_close(&collector);
+
+    return Failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
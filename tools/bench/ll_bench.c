@@ -0,0 +1,114 @@
+/**
+ * @file        ll_bench.c
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       Benchmark of the cost of disabled log statements.
+ *
+ * Times a loop of log statements whose level is above the threshold of the log, and prints the
+ * time per statement less that of the same loop without a log statement.  The log is read through
+ * a volatile pointer, so that the level check cannot be hoisted out of the loop.
+ *
+ * Build with CMAKE_BUILD_TYPE=Release for meaningful figures.
+ *
+ * Usage: ll_bench [ITERATIONS]
+ */
+#include "ll_log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/// Default number of statements timed in each case.
+#define ITERATIONS 100000000UL
+
+/// Root log, with a threshold below the benchmarked level.
+static struct ll_log Root = LL_LOG_INIT("root", NULL, LL_LEVEL_INFO, NULL, NULL);
+
+/// Child of the root log inheriting its threshold.
+static struct ll_log Child = LL_LOG_INIT("child", NULL, LL_LEVEL_INHERIT, &Root,
+                                         LL_INHERIT_TARGET);
+
+/// Grandchild of the root log inheriting its threshold.
+static struct ll_log Grandchild = LL_LOG_INIT("grandchild", NULL, LL_LEVEL_INHERIT, &Child,
+                                              LL_INHERIT_TARGET);
+
+/// Log three levels deep inheriting the threshold of the root log.
+static struct ll_log Leaf = LL_LOG_INIT("leaf", NULL, LL_LEVEL_INHERIT, &Grandchild,
+                                        LL_INHERIT_TARGET);
+
+/// Log used by the timed loop.
+static struct ll_log *volatile Current;
+
+/// Positional parameter of the benchmarked statements, which should never be read.
+static volatile unsigned long Argument;
+
+/// Read the monotonic clock, in nanoseconds.
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+/// Time a loop of statements which only read the log pointer, in nanoseconds per iteration.
+static double time_empty(unsigned long iterations)
+{
+    double          start = now();
+    unsigned long   i;
+
+    for (i = 0; i < iterations; ++i)
+    {
+        (void) Current;
+    }
+    return (now() - start) / (double) iterations;
+}
+
+/// Time a loop of disabled log statements, in nanoseconds per statement.
+static double time_disabled(unsigned long iterations)
+{
+    double          start = now();
+    unsigned long   i;
+
+    for (i = 0; i < iterations; ++i)
+    {
+        LL_LOG(Current, LL_LEVEL_DEBUG, "disabled %lu", Argument);
+    }
+    return (now() - start) / (double) iterations;
+}
+
+/// Time disabled log statements on a log, and print the result.
+static void run(const char *name, struct ll_log *log, unsigned long iterations, double baseline)
+{
+    double cost;
+
+    Current = log;
+    time_disabled(iterations / 10);
+    cost = time_disabled(iterations);
+    printf("%-32s %8.3f ns\n", name, cost - baseline);
+}
+
+/// Benchmark entry point.
+int main(int argc, char **argv)
+{
+    unsigned long   iterations = ITERATIONS;
+    double          baseline;
+
+    if (argc > 2 || (argc == 2 && (iterations = strtoul(argv[1], NULL, 0)) == 0))
+    {
+        fprintf(stderr, "Usage: %s [ITERATIONS]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    Current = &Root;
+    time_empty(iterations / 10);
+    baseline = time_empty(iterations);
+    printf("%-32s %8.3f ns\n", "loop overhead", baseline);
+
+    run("disabled LL_LOG, root log", &Root, iterations, baseline);
+    run("disabled LL_LOG, inherited x3", &Leaf, iterations, baseline);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,106 @@
+/**
+ * @file        ll_collect.c
+ * @copyright   2021 Andrew MacIsaac
+ * @remark
+ *      SPDX-License-Identifier: BSD-2-Clause
+ *
+ * @brief       Shared memory log collector.
+ *
+ * Creates the shared memory ring for processes logging through shared memory targets, and appends
+ * their messages to a file until interrupted.  Must be built with the same loglib configuration as
+ * the processes it serves.
+ *
+ * Usage: ll_collect NAME RING_SIZE FILE
+ */
+#include "ll_target_file.h"
+#include "ll_target_shm.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+/// Most messages to pass on before checking for a stop request.
+#define BATCH 1024
+
+/// Longest time to sleep while the ring is empty, in nanoseconds.
+#define MAX_SLEEP 10000000L
+
+/// Set when the collector has been asked to stop.
+static volatile sig_atomic_t Stop;
+
+/// Buffer for the file target.
+static char FileBuffer[1 << 20];
+
+/// Target the messages are written to.
+static struct ll_file_target FileTarget = LL_FILE_TARGET_INIT(NULL, -1, FileBuffer,
+                                                              sizeof(FileBuffer),
+                                                              LL_FILE_NO_DELAY, LL_LEVEL_FATAL);
+
+/// Signal handler requesting a stop.
+static void request_stop(int sig)
+{
+    (void) sig;
+    Stop = 1;
+}
+
+/// Collector entry point.
+int main(int argc, char **argv)
+{
+    struct ll_shm_collector  collector;
+    struct timespec          pause = { 0, 0 };
+    unsigned long            size;
+
+    if (argc != 4)
+    {
+        fprintf(stderr, "Usage: %s NAME RING_SIZE FILE\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    size = strtoul(argv[2], NULL, 0);
+    FileTarget.fd = open(argv[3], O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (FileTarget.fd < 0)
+    {
+        perror(argv[3]);
+        return EXIT_FAILURE;
+    }
+    if (ll_shm_collector_open(&collector, argv[1], (size_t) size) != 0)
+    {
+        fprintf(stderr, "%s: cannot create a ring of %lu bytes\n", argv[1], size);
+        return EXIT_FAILURE;
+    }
+
+    signal(SIGINT, &request_stop);
+    signal(SIGTERM, &request_stop);
+
+    // Poll the ring, backing off while it is idle and writing out whatever has been collected.
+    while (!Stop)
+    {
+        if (ll_shm_collect(&collector, &FileTarget.target, BATCH) > 0)
+        {
+            pause.tv_nsec = 0;
+            continue;
+        }
+        if (pause.tv_nsec == 0)
+        {
+            ll_target_flush(&FileTarget.target);
+            pause.tv_nsec = 100000L;
+        }
+        else if (pause.tv_nsec < MAX_SLEEP)
+        {
+            pause.tv_nsec *= 2;
+        }
+        nanosleep(&pause, NULL);
+    }
+
+    while (ll_shm_collect(&collector, &FileTarget.target, BATCH) > 0)
+    {
+    }
+    ll_target_flush(&FileTarget.target);
+    ll_shm_collector_close(&collector);
+    close(FileTarget.fd);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,301 @@
+#!/usr/bin/env python3
+#
+# @file        ll_extract.py
+# @copyright   2021 Andrew MacIsaac
+# @remark
+#      SPDX-License-Identifier: BSD-2-Clause
+#
+# @brief       Log extractor tool for compact (LL_COMPACT) log messages.
+#
+# The "dictionary" command scans C sources for LL_LOG and LL_LOGV statements and writes a JSON
+# dictionary mapping each format string hash to the format string and the locations it is used at.
+# The "decode" command reads a stream of compact binary records, as written out by a log target, and
+# uses the dictionary to rebuild the text of each message.
+#
+# Example:
+#   ll_extract.py dictionary -o dict.json src/*.c
+#   ll_extract.py decode -d dict.json log.bin
+#
+import argparse
+import datetime
+import json
+import math
+import re
+import struct
+import sys
+
+# Default level names, matching _ll_log_level_name.
+LEVEL_NAMES = ['FATAL', 'ERROR', 'Warn', 'Info', 'debug', 'trace']
+
+# Hash multiplier, matching ll_hash.h.
+HASH_K = 16777619
+
+# Longest format string that can be hashed, matching LL_HASH_MAX_LENGTH in ll_hash.h.
+HASH_MAX_LENGTH = 256
+
+# Compact record header: length, level, flags, hash, timestamp.
+HEADER = struct.Struct('HBBIQ')
+
+# Smallest page size a memory mapped target may have padded the log out to.
+PAGE_SIZE = 4096
+
+# Record flag indicating big-endian byte order.
+FLAG_BIG_ENDIAN = 0x01
+
+# Log statement macros whose third argument is a format string.
+LOG_MACRO = re.compile(r'\b(LL_LOG|LL_LOGV)\s*\(')
+
+# A single printf conversion specification.
+SPEC = re.compile(r'%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d*))?'
+                  r'(hh|h|ll|l|j|z|t|L)?([diouxXcfFeEgGaAspn%])')
+
+# C escape sequences.
+ESCAPES = {'n': 10, 't': 9, 'r': 13, 'a': 7, 'b': 8, 'f': 12, 'v': 11, '\\': 92, "'": 39,
+           '"': 34, '?': 63}
+
+
+def ll_hash(data):
+    """Compute the LL_HASH value of a format string, given as bytes."""
+    h = len(data)
+    for i, byte in enumerate(data):
+        h += byte * pow(HASH_K, i + 1, 1 << 32)
+    return h & 0xFFFFFFFF
+
+
+def unescape(body):
+    """Convert the body of a C string literal into bytes."""
+    out = bytearray()
+    i = 0
+    while i < len(body):
+        c = body[i]
+        if c != '\\':
+            out += c.encode('utf-8')
+            i += 1
+            continue
+        i += 1
+        c = body[i]
+        if c in ESCAPES:
+            out.append(ESCAPES[c])
+            i += 1
+        elif c == 'x':
+            m = re.match(r'[0-9a-fA-F]+', body[i + 1:])
+            out.append(int(m.group(0), 16) & 0xFF)
+            i += 1 + len(m.group(0))
+        elif c in '01234567':
+            m = re.match(r'[0-7]{1,3}', body[i:])
+            out.append(int(m.group(0), 8) & 0xFF)
+            i += len(m.group(0))
+        else:
+            out += c.encode('utf-8')
+            i += 1
+    return bytes(out)
+
+
+def split_arguments(text, start):
+    """Split the macro arguments starting after the '(' at text[start], at top level commas."""
+    args = []
+    depth = 0
+    current = start
+    i = start
+    while i < len(text):
+        c = text[i]
+        if c in '"\'':
+            i += 1
+            while text[i] != c:
+                i += 2 if text[i] == '\\' else 1
+        elif text.startswith('/*', i):
+            i = text.index('*/', i) + 1
+        elif text.startswith('//', i):
+            i = text.index('\n', i)
+        elif c in '([{':
+            depth += 1
+        elif c in ')]}':
+            if depth == 0:
+                args.append(text[current:i])
+                return args
+            depth -= 1
+        elif c == ',' and depth == 0:
+            args.append(text[current:i])
+            current = i + 1
+        i += 1
+    return None
+
+
+def parse_literal(expression):
+    """Get the bytes of an expression consisting only of (possibly parenthesized, concatenated)
+    string literals, or None if it is anything else."""
+    expression = expression.strip()
+    while expression.startswith('(') and expression.endswith(')'):
+        expression = expression[1:-1].strip()
+    parts = re.findall(r'"((?:[^"\\]|\\.)*)"', expression)
+    if not parts or re.sub(r'"((?:[^"\\]|\\.)*)"', '', expression).strip():
+        return None
+    return b''.join(unescape(p) for p in parts)
+
+
+def build_dictionary(paths):
+    """Scan source files for log statements and build the hash dictionary."""
+    dictionary = {}
+    for path in paths:
+        with open(path, encoding='utf-8', errors='replace') as f:
+            text = f.read()
+        for match in LOG_MACRO.finditer(text):
+            line = text.count('\n', 0, match.start()) + 1
+            args = split_arguments(text, match.end())
+            if args is None or len(args) < 3:
+                continue
+            fmt = parse_literal(args[2])
+            if fmt is None:
+                print('%s:%d: format is not a string literal, skipped' % (path, line),
+                      file=sys.stderr)
+                continue
+            if len(fmt) > HASH_MAX_LENGTH:
+                print('%s:%d: format is too long to be hashed, skipped' % (path, line),
+                      file=sys.stderr)
+                continue
+            key = '%08x' % ll_hash(fmt)
+            entry = dictionary.setdefault(key, {'format': fmt.decode('utf-8', 'replace'),
+                                                'locations': []})
+            if entry['format'] != fmt.decode('utf-8', 'replace'):
+                print('%s:%d: hash collision with "%s"' % (path, line, entry['format']),
+                      file=sys.stderr)
+                continue
+            entry['locations'].append('%s:%d' % (path, line))
+    return dictionary
+
+
+def render(fmt, payload, order, sizes):
+    """Rebuild message text from a format string and the raw argument bytes of a record."""
+    offset = 0
+
+    def take(code, size):
+        nonlocal offset
+        value = struct.unpack_from(order + code, payload, offset)[0]
+        offset += size
+        return value
+
+    def integer(modifier, signed):
+        size = sizes.get(modifier, 4)
+        code = {1: 'b', 2: 'h', 4: 'i', 8: 'q'}[size]
+        return take(code if signed else code.upper(), size)
+
+    def convert(m):
+        nonlocal offset
+        flags, width, precision, modifier, conversion = m.groups()
+        if conversion == '%':
+            return '%'
+        if width == '*':
+            width = str(take('i', 4))
+        if precision == '*':
+            precision = str(take('i', 4))
+        spec = '%' + flags + (width or '') + ('.' + precision if precision is not None else '')
+        if conversion in 'di':
+            return (spec + 'd') % integer(modifier or '', True)
+        if conversion in 'ouxX':
+            return (spec + conversion) % integer(modifier or '', False)
+        if conversion == 'c':
+            return (spec + 'c') % chr(integer('', True) & 0xFF)
+        if conversion in 'fFeEgGaA':
+            if modifier == 'L' and sizes['L'] > 8:
+                # x87 extended precision, padded out to sizeof(long double).
+                mantissa, exponent = struct.unpack_from(order + 'QH', payload, offset)
+                offset += sizes['L']
+                value = math.ldexp(mantissa, (exponent & 0x7FFF) - 16383 - 63)
+                value = -value if exponent & 0x8000 else value
+            else:
+                value = take('d', 8)
+            if conversion in 'aA':
+                text = value.hex()
+                return text.upper() if conversion == 'A' else text
+            return (spec + conversion) % value
+        if conversion == 's':
+            end = payload.index(b'\0', offset)
+            text = payload[offset:end].decode('utf-8', 'replace')
+            offset = end + 1
+            return (spec + 's') % text
+        if conversion == 'p':
+            return '0x%x' % integer('p', False)
+        return ''
+
+    return SPEC.sub(convert, fmt)
+
+
+def decode(dictionary, stream, out, sizes, localtime, digits):
+    """Decode a stream of compact records into text lines."""
+    data = stream.read()
+    offset = 0
+    while offset + HEADER.size <= len(data):
+        order = '>' if data[offset + 3] & FLAG_BIG_ENDIAN else '<'
+        length, level, _, key, timestamp = struct.unpack_from(order + 'HBBIQ', data, offset)
+        if length == 0:
+            # Zero padding left by a memory mapped target, which runs to a page boundary.
+            offset = (offset // PAGE_SIZE + 1) * PAGE_SIZE
+            continue
+        if length < HEADER.size:
+            print('Corrupt record at offset %d' % offset, file=sys.stderr)
+            return 1
+        payload = data[offset + HEADER.size:offset + length]
+        offset += length
+
+        stamp = ''
+        if timestamp != 0:
+            seconds = timestamp // 1000000000
+            when = (datetime.datetime.fromtimestamp(seconds) if localtime else
+                    datetime.datetime.utcfromtimestamp(seconds))
+            fraction = timestamp % 1000000000 // 10 ** (9 - digits)
+            stamp = '%s.%0*d ' % (when.strftime('%Y-%m-%d %H:%M:%S'), digits, fraction)
+        name = LEVEL_NAMES[level] if level < len(LEVEL_NAMES) else str(level)
+
+        entry = dictionary.get('%08x' % key)
+        if entry is None:
+            text = '<unknown format %08x>' % key
+            location = ''
+        else:
+            text = render(entry['format'], payload, order, sizes)
+            location = entry['locations'][0] + ' ' if len(entry['locations']) == 1 else ''
+        out.write('%s%5s %s%s\n' % (stamp, name, location, text))
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Log extractor tool for compact log messages.')
+    commands = parser.add_subparsers(dest='command', required=True)
+
+    dictionary = commands.add_parser('dictionary', help='build a format string dictionary')
+    dictionary.add_argument('-o', '--output', default='-', help='dictionary file to write')
+    dictionary.add_argument('sources', nargs='+', help='C source files to scan')
+
+    decoder = commands.add_parser('decode', help='decode compact log records')
+    decoder.add_argument('-d', '--dictionary', required=True, help='dictionary file to read')
+    decoder.add_argument('--sizeof-long', type=int, default=8, help='target sizeof(long)')
+    decoder.add_argument('--sizeof-pointer', type=int, default=8, help='target sizeof(void *)')
+    decoder.add_argument('--sizeof-long-double', type=int, default=16,
+                         help='target sizeof(long double)')
+    decoder.add_argument('--localtime', action='store_true', help='display local time stamps')
+    decoder.add_argument('--digits', type=int, choices=[3, 6, 9], default=3,
+                         help='number of fractional second digits to display')
+    decoder.add_argument('log', nargs='?', default='-', help='binary log file to decode')
+
+    args = parser.parse_args()
+    if args.command == 'dictionary':
+        result = json.dumps(build_dictionary(args.sources), indent=2, sort_keys=True)
+        if args.output == '-':
+            print(result)
+        else:
+            with open(args.output, 'w') as f:
+                f.write(result + '\n')
+        return 0
+
+    with open(args.dictionary) as f:
+        dictionary = json.load(f)
+    sizes = {'': 4, 'hh': 4, 'h': 4, 'l': args.sizeof_long, 'll': 8, 'j': 8,
+             'z': args.sizeof_pointer, 't': args.sizeof_pointer, 'p': args.sizeof_pointer,
+             'L': args.sizeof_long_double}
+    if args.log == '-':
+        return decode(dictionary, sys.stdin.buffer, sys.stdout, sizes, args.localtime, args.digits)
+    with open(args.log, 'rb') as f:
+        return decode(dictionary, f, sys.stdout, sizes, args.localtime, args.digits)
+
+
+if __name__ == '__main__':
+    sys.exit(main())